@@ -0,0 +1,56 @@
+/**
+ * @file bench_binary.cpp
+ * @brief 文本日志与二进制日志的对比：同步日志器写入文件时每条日志的字节数与耗时
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/Log.h"
+
+namespace {
+
+	const size_t total = 1000000;
+	const char* text_path = "./bench_binary_tmp/text.log";
+	const char* binary_path = "./bench_binary_tmp/binary.zlog";
+
+	void Run(const char* name, const char* path, bool binary) {
+		unlink(path);
+		auto start = std::chrono::steady_clock::now();
+		{
+			zch::LocalLoggerBuilder builder;
+			builder.BuildName("bench_binary");
+			builder.BuildClock(zch::ClockType::REALTIME);
+			if (binary) {
+				builder.BuildBinaryFormatter();
+				builder.AddLogSink<zch::BinaryFileSink>(path, 64 * 1024);
+			} else {
+				builder.BuildFormatter("[%d{%Y-%m-%d %H:%M:%S.%N}][%c][%t:%i][%p][%f:%l]%m%n");
+				builder.AddLogSink<zch::FdSink>(path, false, 64 * 1024);
+			}
+			zch::Logger::ptr logger = builder.Build();
+			for (size_t i = 0; i < total; ++i) {
+				logger->Info("request %zu done, user=%s latency=%.2fms", i, "alice", 1.25);
+			}
+		}
+		std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+		struct stat st;
+		stat(path, &st);
+		printf("%-10s %14.1f %14.1f\n", name, static_cast<double>(st.st_size) / total, cost.count() * 1e9 / total);
+		unlink(path);
+	}
+}
+
+int main() {
+	mkdir("./bench_binary_tmp", 0755);
+	printf("%-10s %14s %14s\n", "format", "bytes/line", "ns/line");
+	Run("text", text_path, false);
+	Run("binary", binary_path, true);
+	rmdir("./bench_binary_tmp");
+	return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file bench_clock.cpp
+ * @brief 各个时钟源取得一次时间戳的开销
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include "../include/Clock.h"
+
+namespace {
+
+	const size_t iterations = 10000000;
+
+	template<class F>
+	double Run(F now) {
+		long sum = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			sum += now();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (sum == 0) {
+			fprintf(stderr, "unexpected\n");
+		}
+		return cost.count() / iterations;
+	}
+
+	long NowBy(zch::ClockType type) {
+		time_t sec;
+		long nsec;
+		zch::Clock::Now(type, sec, nsec);
+		return static_cast<long>(sec) + nsec;
+	}
+}
+
+int main() {
+	// 提前完成时间戳计数器的首次校准
+	bool tsc = zch::TscClock::GetInstance().Available();
+
+	printf("%-24s %8.1f ns/call\n", "time(nullptr)", Run([]() { return static_cast<long>(time(nullptr)); }));
+	printf("%-24s %8.1f ns/call\n", "CLOCK_REALTIME_COARSE", Run([]() { return NowBy(zch::ClockType::REALTIME_COARSE); }));
+	printf("%-24s %8.1f ns/call\n", "CLOCK_REALTIME", Run([]() { return NowBy(zch::ClockType::REALTIME); }));
+	printf("%-24s %8.1f ns/call%s\n", "TSC", Run([]() { return NowBy(zch::ClockType::TSC); }),
+			tsc ? "" : " (不可用，退化为 CLOCK_REALTIME)");
+
+	// 时间戳计数器与墙上时间的偏差
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	int64_t wall = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	int64_t tsc_ns = zch::TscClock::GetInstance().Now();
+	printf("TSC - CLOCK_REALTIME: %lld ns\n", static_cast<long long>(tsc_ns - wall));
+	return 0;
+}
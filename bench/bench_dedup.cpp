@@ -0,0 +1,100 @@
+/**
+ * @file bench_dedup.cpp
+ * @brief 日志风暴：多个线程在重试循环中不断输出同一条错误日志，对比不合并与按调用点合并重复日志时
+ *        每次调用的耗时以及到达落地方向的日志条数，并校验输出的日志与汇总中的条数之和等于调用次数
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/Log.h"
+
+namespace {
+
+	// 统计日志条数以及汇总中被合并的条数
+	class CountSink : public zch::LogSink {
+	public:
+		void log(const char* data, size_t len) override {
+			const char* end = data + len;
+			while (data < end) {
+				const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+				if (nl == nullptr) {
+					break;
+				}
+				const char* hit = static_cast<const char*>(memmem(data, nl - data, "repeated ", 9));
+				if (hit != nullptr) {
+					_summaries += 1;
+					_repeated += strtoull(hit + 9, nullptr, 10);
+				} else {
+					_lines += 1;
+				}
+				data = nl + 1;
+			}
+		}
+
+		uint64_t _lines = 0;
+		uint64_t _summaries = 0;
+		uint64_t _repeated = 0;
+	};
+
+	const size_t per_thread = 1000000;
+
+	bool Run(const char* name, size_t threads, std::chrono::milliseconds window) {
+		auto sink = std::make_shared<CountSink>();
+		double cost_ns = 0;
+		{
+			zch::LocalLoggerBuilder builder;
+			builder.BuildName(name);
+			builder.BuildType(zch::LoggerType::Async_Logger);
+			builder.BuildFormatter("[%d{%H:%M:%S}][%p][%f:%l]%m%n");
+			builder.BuildOverflowPolicy(zch::OverflowPolicy::BLOCK);
+			builder.BuildDedup(window);
+			builder.AddLogSink(sink, nullptr);
+			zch::Logger::ptr logger = builder.Build();
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; ++t) {
+				workers.emplace_back([&logger, t] {
+					for (size_t i = 0; i < per_thread; ++i) {
+						logger->Error("connect to %s failed: %s (attempt %zu)", "db-primary:5432", "connection refused", i);
+					}
+				});
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+			cost_ns = cost.count() / (threads * per_thread);
+		}
+		printf("%-16s %8zu %12.1f %12llu %12llu\n", name, threads, cost_ns,
+				static_cast<unsigned long long>(sink->_lines), static_cast<unsigned long long>(sink->_summaries));
+		if (sink->_lines + sink->_repeated != threads * per_thread) {
+			fprintf(stderr, "条数不一致: %llu + %llu != %zu\n", static_cast<unsigned long long>(sink->_lines),
+					static_cast<unsigned long long>(sink->_repeated), threads * per_thread);
+			return false;
+		}
+		return true;
+	}
+}
+
+int main() {
+	printf("%-16s %8s %12s %12s %12s\n", "mode", "threads", "ns/call", "lines", "summaries");
+	const size_t counts[] = { 1, 4 };
+	for (size_t threads : counts) {
+		if (!Run("no-dedup", threads, std::chrono::milliseconds::zero())
+			|| !Run("dedup(10ms)", threads, std::chrono::milliseconds(10))
+			|| !Run("dedup(100ms)", threads, std::chrono::milliseconds(100))) {
+			return 1;
+		}
+	}
+	return 0;
+}
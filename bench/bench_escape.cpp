@@ -0,0 +1,187 @@
+/**
+ * @file bench_escape.cpp
+ * @brief %m{escape} 的有效载荷转义：逐字节、SSE2、AVX2 三种扫描实现在不同载荷上的耗时，
+ *        并校验三者输出一致；以及 Formatter 中 %m 与 %m{escape} 的对比
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../include/Escape.h"
+#include "../include/StaticFormatter.hpp"
+
+namespace {
+
+	const size_t iterations = 2000000;
+
+	constexpr char kEscapePattern[] = "[%d{%H:%M:%S}][%p][%f:%l]%m{escape}%n";
+
+	struct Payload {
+		const char* _name;
+		std::string _data;
+	};
+
+	std::vector<Payload> Payloads() {
+		std::vector<Payload> payloads;
+		payloads.push_back({ "short ascii", "request done user_id=1000 latency_us=12.5 path=/api/v1/users" });
+		payloads.push_back({ "long ascii",
+			"GET /api/v1/users/1000/orders?page=3&size=50&sort=created_at HTTP/1.1 200 1532 12.5ms "
+			"remote=10.0.3.17:51234 ua=Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+			"Chrome/120.0 Safari/537.36 referer=https://example.com/dashboard/orders trace=4bf92f3577b34da6a3ce929d0e0e4736" });
+		payloads.push_back({ "json body", "body={\"user\":\"alice\",\"roles\":[\"admin\",\"dev\"],\"quota\":1024}" });
+		payloads.push_back({ "stack trace",
+			"unhandled exception: std::runtime_error: connection reset\n"
+			"\t#0 zch::RpcClient::Call(std::string const&) at rpc.cpp:218\n"
+			"\t#1 zch::OrderService::Submit(zch::Order const&) at order.cpp:96\n"
+			"\t#2 main at main.cpp:42\n" });
+		payloads.push_back({ "utf-8 text", "用户 alice 登录成功，来自 上海 的 10.0.3.17，耗时 12.5ms，会话已建立" });
+		payloads.push_back({ "invalid utf-8", std::string("upload name=report") + "\xff\xfe" + ".pdf size=1532 crc=\xc3\x28 ok" });
+		return payloads;
+	}
+
+	// 返回每条载荷的平均耗时(纳秒)
+	double Run(const std::vector<const std::string*>& mix, bool escape) {
+		std::string out;
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			const std::string& payload = *mix[i % mix.size()];
+			out.clear();
+			if (escape) {
+				zch::Escaper::Append(out, payload.data(), payload.size());
+			} else {
+				out.append(payload);
+			}
+			bytes += out.size();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (bytes == 0) {
+			fprintf(stderr, "empty output\n");
+		}
+		return cost.count() / iterations;
+	}
+
+	double RunFormatter(zch::Formatter& formatter, const std::vector<const std::string*>& mix) {
+		const zch::CallSite site("main.cpp", 42, zch::LogLevel::Level::INFO, "%s");
+		const std::string root("root");
+		std::vector<zch::LogMsg> msgs;
+		for (auto payload : mix) {
+			msgs.push_back(zch::LogMsg(&site, &root, *payload));
+		}
+		std::string out;
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			out.clear();
+			formatter.Format(out, msgs[i % msgs.size()]);
+			bytes += out.size();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (bytes == 0) {
+			fprintf(stderr, "empty output\n");
+		}
+		return cost.count() / iterations;
+	}
+
+	std::string Escape(const std::string& payload) {
+		std::string out;
+		zch::Escaper::Append(out, payload.data(), payload.size());
+		return out;
+	}
+}
+
+int main() {
+	const zch::Escaper::Kernel kernels[] = { zch::Escaper::Kernel::SCALAR, zch::Escaper::Kernel::SSE2, zch::Escaper::Kernel::AVX2 };
+	const zch::Escaper::Kernel detected = zch::Escaper::Active();
+	std::vector<Payload> payloads = Payloads();
+
+	// 各实现的输出必须一致，并且与预期相同
+	if (Escape("a\"b\\c\nd\re\tf\x01g\x7f") != "a\\\"b\\\\c\\nd\\re\\tf\\u0001g\\u007f"
+		|| Escape("\xe4\xb8\xad\xed\xa0\x80\xc0\xaf") != "\xe4\xb8\xad\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd") {
+		fprintf(stderr, "转义结果不正确\n");
+		return 1;
+	}
+	for (auto& payload : payloads) {
+		// 逐个截断长度，覆盖向量扫描的尾部处理
+		for (size_t len = 0; len <= payload._data.size(); ++len) {
+			std::string expect;
+			for (auto kernel : kernels) {
+				if (!zch::Escaper::Select(kernel)) {
+					continue;
+				}
+				std::string out;
+				zch::Escaper::Append(out, payload._data.data(), len);
+				if (expect.empty()) {
+					expect = out;
+				} else if (out != expect) {
+					fprintf(stderr, "%s 输出不一致: %s\n", zch::Escaper::ToCString(kernel), payload._name);
+					return 1;
+				}
+			}
+		}
+	}
+
+	// StaticFormatter 同样支持 %m{escape}
+	zch::Formatter runtime(kEscapePattern);
+	zch::StaticFormatter<kEscapePattern> fixed;
+	const zch::CallSite site("main.cpp", 42, zch::LogLevel::Level::INFO, "%s");
+	for (auto& payload : payloads) {
+		zch::LogMsg msg(&site, nullptr, payload._data);
+		if (runtime.Format(msg) != fixed.Format(msg) || runtime.Format(msg).find('\n') != runtime.Format(msg).size() - 1) {
+			fprintf(stderr, "StaticFormatter 输出不一致: %s\n", payload._name);
+			return 1;
+		}
+	}
+
+	printf("detected kernel: %s\n", zch::Escaper::ToCString(detected));
+	printf("%16s %8s %12s", "payload", "bytes", "append");
+	for (auto kernel : kernels) {
+		printf(" %12s", zch::Escaper::ToCString(kernel));
+	}
+	printf("  (ns/line)\n");
+	for (auto& payload : payloads) {
+		std::vector<const std::string*> mix(1, &payload._data);
+		printf("%16s %8zu %12.1f", payload._name, payload._data.size(), Run(mix, false));
+		for (auto kernel : kernels) {
+			if (zch::Escaper::Select(kernel)) {
+				printf(" %12.1f", Run(mix, true));
+			} else {
+				printf(" %12s", "-");
+			}
+		}
+		printf("\n");
+	}
+
+	// 接近线上的比例：大部分是普通的 ASCII 消息，少量带引号、多行或者中文
+	std::vector<const std::string*> mix;
+	for (int i = 0; i < 14; ++i) {
+		mix.push_back(&payloads[i % 2]._data);
+	}
+	mix.push_back(&payloads[2]._data);
+	mix.push_back(&payloads[2]._data);
+	mix.push_back(&payloads[3]._data);
+	mix.push_back(&payloads[4]._data);
+	mix.push_back(&payloads[4]._data);
+	mix.push_back(&payloads[5]._data);
+	printf("%16s %8s %12.1f", "mixed", "-", Run(mix, false));
+	for (auto kernel : kernels) {
+		if (zch::Escaper::Select(kernel)) {
+			printf(" %12.1f", Run(mix, true));
+		} else {
+			printf(" %12s", "-");
+		}
+	}
+	printf("\n");
+
+	zch::Escaper::Select(detected);
+	zch::Formatter plain("[%d{%H:%M:%S}][%p][%f:%l]%m%n");
+	zch::Formatter escaped(kEscapePattern);
+	printf("formatter on mixed payloads:\n");
+	printf("%32s %12.1f ns/line\n", "%m", RunFormatter(plain, mix));
+	printf("%32s %12.1f ns/line\n", "%m{escape}", RunFormatter(escaped, mix));
+	return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file bench_formatter.cpp
+ * @brief 运行期解析的 Formatter 与编译期特化的 StaticFormatter 的性能对比，并校验两者输出一致；
+ *        以及结构化字段直接序列化(logfmt / JSON)与先用 snprintf 拼出消息再格式化的对比
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../include/StaticFormatter.hpp"
+
+namespace {
+
+	constexpr char kPattern[] = "[%d{%H:%M:%S}][%p][%f:%l]%m%n";
+	constexpr char kFullPattern[] = "%d{%Y-%m-%d %T}%T[%t:%i]%T[%p]%T[%c]%T%f:%F:%l%T%m 100%%%n";
+	constexpr char kSubSecPattern[] = "[%d{%H:%M:%S.%L|%f|%N %%}][%p]%m%n";
+
+	const zch::CallSite site_info("../src/main.cpp", 42, zch::LogLevel::Level::INFO, "%s");
+	const zch::CallSite site_error("a.cpp", 0, zch::LogLevel::Level::ERROR, "%s");
+	const zch::CallSite site_debug("/very/long/path/to/some/source/file.cpp", 123456789, zch::LogLevel::Level::DEBUG, "%s");
+	const std::string root("root");
+	const std::string rpc("rpc");
+	const std::string empty;
+
+	const size_t iterations = 2000000;
+
+	template<const char* Pattern>
+	bool Check(const std::vector<zch::LogMsg>& msgs) {
+		zch::Formatter runtime(Pattern);
+		zch::Formatter cached_offset(Pattern, true);
+		zch::StaticFormatter<Pattern> fixed;
+		for (auto& msg : msgs) {
+			if (runtime.Format(msg) != cached_offset.Format(msg)) {
+				fprintf(stderr, "缓存 UTC 偏移后输出不一致:\n%s%s", runtime.Format(msg).c_str(), cached_offset.Format(msg).c_str());
+				return false;
+			}
+			if (runtime.Format(msg) != fixed.Format(msg)) {
+				fprintf(stderr, "输出不一致:\n%s%s", runtime.Format(msg).c_str(), fixed.Format(msg).c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 返回每条日志的平均耗时(纳秒)，时间戳每 step 条日志前进一秒
+	double Run(zch::Formatter& formatter, zch::LogMsg msg, size_t step) {
+		std::string out;
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			if (i % step == 0) {
+				++msg._ctime;
+			}
+			out.clear();
+			formatter.Format(out, msg);
+			bytes += out.size();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (bytes == 0) {
+			fprintf(stderr, "empty output\n");
+		}
+		return cost.count() / iterations;
+	}
+
+	// 结构化日志：每条日志都要序列化字段，返回每条日志的平均耗时(纳秒)
+	double RunFields(zch::Formatter& formatter, zch::LogMsg msg, size_t user_id, double latency, const char* path) {
+		std::string out;
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			const zch::Field fields[] = { { "user_id", user_id + i }, { "latency_us", latency }, { "path", path } };
+			msg._fields = fields;
+			msg._nfields = 3;
+			out.clear();
+			formatter.Format(out, msg);
+			bytes += out.size();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (bytes == 0) {
+			fprintf(stderr, "empty output\n");
+		}
+		return cost.count() / iterations;
+	}
+
+	// 同样的内容先通过 snprintf 形成有效载荷再格式化 (日志器的 printf 风格接口)
+	double RunPrintf(zch::Formatter& formatter, zch::LogMsg msg, size_t user_id, double latency, const char* path) {
+		std::string out;
+		char buf[256];
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			int n = snprintf(buf, sizeof(buf), "request done user_id=%zu latency_us=%g path=%s", user_id + i, latency, path);
+			msg._payload.assign(buf, n);
+			out.clear();
+			formatter.Format(out, msg);
+			bytes += out.size();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		if (bytes == 0) {
+			fprintf(stderr, "empty output\n");
+		}
+		return cost.count() / iterations;
+	}
+}
+
+int main() {
+	std::vector<zch::LogMsg> msgs;
+	msgs.push_back(zch::LogMsg(&site_info, &root, "hello world"));
+	msgs.push_back(zch::LogMsg(&site_error, &rpc, ""));
+	msgs.push_back(zch::LogMsg(&site_debug, &empty, std::string(300, 'x')));
+	msgs[0]._nsec = 123456789;
+	msgs[1]._ctime = 0;
+	msgs[2]._ctime = 1700000000;
+	msgs[2]._nsec = 999999999;
+
+	if (!Check<kPattern>(msgs) || !Check<kFullPattern>(msgs) || !Check<kSubSecPattern>(msgs)) {
+		return 1;
+	}
+
+	zch::Formatter runtime(kPattern);
+	zch::Formatter cached_offset(kPattern, true);
+	zch::StaticFormatter<kPattern> fixed;
+	printf("pattern: %s\n", kPattern);
+	// step 为 1 时每条日志的秒数都不同，时间缓存总是失效
+	const size_t steps[] = { 1, 1000 };
+	for (size_t step : steps) {
+		printf("lines per second: %zu\n", step);
+		printf("%32s %12.1f ns/line\n", "Formatter", Run(runtime, msgs[0], step));
+		printf("%32s %12.1f ns/line\n", "Formatter(cache_utc_offset)", Run(cached_offset, msgs[0], step));
+		printf("%32s %12.1f ns/line\n", "StaticFormatter", Run(fixed, msgs[0], step));
+	}
+
+	zch::LogMsg msg(&site_info, &root, "request done");
+	zch::LogfmtFormatter logfmt;
+	zch::JsonFormatter json;
+	printf("structured fields (user_id, latency_us, path):\n");
+	printf("%32s %12.1f ns/line\n", "snprintf + Formatter", RunPrintf(runtime, msg, 1000, 12.5, "/api/v1/users"));
+	printf("%32s %12.1f ns/line\n", "Formatter(%m with fields)", RunFields(runtime, msg, 1000, 12.5, "/api/v1/users"));
+	printf("%32s %12.1f ns/line\n", "LogfmtFormatter", RunFields(logfmt, msg, 1000, 12.5, "/api/v1/users"));
+	printf("%32s %12.1f ns/line\n", "JsonFormatter", RunFields(json, msg, 1000, 12.5, "/api/v1/users"));
+	return 0;
+}
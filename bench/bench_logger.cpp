@@ -0,0 +1,139 @@
+/**
+ * @file bench_logger.cpp
+ * @brief 日志器调用线程的开销：每条日志的耗时以及堆分配次数；
+ *        以及落地方向单独指定格式化器时(文本 + JSON)与两个日志器分别格式化的对比；
+ *        被等级过滤的日志通过成员函数调用与通过 ZCH_LOG_* 宏调用的开销
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../include/Log.h"
+
+namespace {
+
+	// 统计 operator new 的调用次数
+	std::atomic<size_t> g_allocs(0);
+
+	// 丢弃所有数据的落地方向，只测量日志器本身的开销
+	class NullSink : public zch::LogSink {
+	public:
+		void log(const char* data, size_t len) override { _bytes += len; }
+		size_t _bytes = 0;
+	};
+
+	const size_t iterations = 1000000;
+
+	void Run(const char* name, zch::LoggerBuilder& builder) {
+		builder.BuildName(name);
+		builder.AddLogSink<NullSink>();
+		zch::Logger::ptr logger = builder.Build();
+
+		// 预热，使线程局部暂存区达到稳态
+		for (int i = 0; i < 1000; ++i) {
+			logger->Info("warm up %d %s %.2f", i, "payload", 3.14);
+		}
+
+		size_t allocs = g_allocs;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			logger->Info("request %zu done, user=%s latency=%.2fms", i, "alice", 1.25);
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		allocs = g_allocs - allocs;
+		printf("%-24s %10.1f ns/call %10.3f allocs/call\n", name, cost.count() / iterations,
+				static_cast<double>(allocs) / iterations);
+	}
+}
+
+namespace {
+
+	// 参数中需要计算的部分，日志被过滤时宏不会求值
+	std::string Describe(size_t i) {
+		return "user-" + std::to_string(i);
+	}
+
+	void RunDisabled() {
+		zch::LocalLoggerBuilder builder;
+		builder.BuildName("disabled");
+		builder.BuildLevel(zch::LogLevel::Level::WARN);
+		builder.AddLogSink<NullSink>();
+		zch::Logger::ptr logger = builder.Build();
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			logger->Debug("request %zu done, user=%s", i, Describe(i).c_str());
+		}
+		std::chrono::duration<double, std::nano> method = std::chrono::steady_clock::now() - start;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; ++i) {
+			ZCH_LOG_DEBUG(logger, "request %zu done, user=%s", i, Describe(i).c_str());
+		}
+		std::chrono::duration<double, std::nano> macro = std::chrono::steady_clock::now() - start;
+		printf("%-24s %10.1f ns/call\n", "disabled(method)", method.count() / iterations);
+		printf("%-24s %10.1f ns/call\n", "disabled(ZCH_LOG_DEBUG)", macro.count() / iterations);
+	}
+}
+
+void* operator new(size_t size) {
+	++g_allocs;
+	void* p = malloc(size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+int main() {
+	{
+		zch::LocalLoggerBuilder builder;
+		Run("sync", builder);
+	}
+	{
+		zch::LocalLoggerBuilder builder;
+		builder.BuildJsonFormatter();
+		Run("sync-json", builder);
+	}
+	{
+		// 同一个日志器中文本与 JSON 两个落地方向，每条日志按每个格式化器各渲染一次
+		zch::LocalLoggerBuilder builder;
+		builder.AddLogSink(zch::SinkFactory::create<NullSink>(), std::make_shared<zch::JsonFormatter>(), zch::LogLevel::Level::INFO);
+		Run("sync-text+json", builder);
+	}
+	{
+		// JSON 落地方向只接收 WARN 及以上的日志，INFO 日志只渲染文本
+		zch::LocalLoggerBuilder builder;
+		builder.AddLogSink(zch::SinkFactory::create<NullSink>(), std::make_shared<zch::JsonFormatter>(), zch::LogLevel::Level::WARN);
+		Run("sync-text+json(WARN)", builder);
+	}
+	{
+		zch::LocalLoggerBuilder builder;
+		builder.BuildType(zch::LoggerType::Async_Logger);
+		builder.BuildEnableUnSafe();
+		Run("async", builder);
+	}
+	{
+		zch::LocalLoggerBuilder builder;
+		builder.BuildType(zch::LoggerType::Async_Logger);
+		builder.BuildEnableLockFree();
+		Run("async-lockfree", builder);
+	}
+	{
+		zch::LocalLoggerBuilder builder;
+		builder.BuildType(zch::LoggerType::Async_Logger);
+		builder.BuildEnableLockFree();
+		builder.BuildEnableDeferred();
+		Run("async-lockfree-deferred", builder);
+	}
+	RunDisabled();
+	return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file bench_lopper.cpp
+ * @brief 异步工作器的多线程扩展性测试：对比双缓冲区交换与每线程无锁环形缓冲区
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../include/AsynLopper.h"
+
+namespace {
+
+	const size_t total_msgs = 2000000;
+	const char msg[] = "[12:00:00][INFO][../src/bench_lopper.cpp:42]benchmark payload for lopper scaling\n";
+
+	// 返回每秒写入的消息数
+	double Run(zch::ASYNCTYPE type, size_t threads) {
+		size_t per_thread = total_msgs / threads;
+		size_t consumed = 0;
+		auto start = std::chrono::steady_clock::now();
+		{
+			zch::AsynLopper lopper([&](zch::Buffer& buf) { consumed += buf.ReadableSize(); }, type);
+			std::vector<std::thread> workers;
+			for (size_t i = 0; i < threads; ++i) {
+				workers.emplace_back([&]() {
+					for (size_t j = 0; j < per_thread; ++j) {
+						lopper.Push(msg, sizeof(msg) - 1);
+					}
+				});
+			}
+			for (auto& t : workers) {
+				t.join();
+			}
+			// 析构时等待所有数据处理完毕
+		}
+		std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+		if (consumed != per_thread * threads * (sizeof(msg) - 1)) {
+			fprintf(stderr, "数据丢失: %zu\n", consumed);
+		}
+		return per_thread * threads / cost.count();
+	}
+}
+
+int main() {
+	printf("%8s %16s %16s %16s\n", "threads", "safe(msg/s)", "unsafe(msg/s)", "lockfree(msg/s)");
+	for (size_t threads = 1; threads <= 64; threads *= 2) {
+		double safe = Run(zch::ASYNCTYPE::ASYNC_SAFE, threads);
+		double unsafe = Run(zch::ASYNCTYPE::ASYNC_UN_SAFE, threads);
+		double lock_free = Run(zch::ASYNCTYPE::ASYNC_LOCK_FREE, threads);
+		printf("%8zu %16.0f %16.0f %16.0f\n", threads, safe, unsafe, lock_free);
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file bench_registry.cpp
+ * @brief 日志器查找的开销：1 ~ 64 个读者线程不断查找日志器，同时一个写者线程不断注册新的日志器，
+ *        对比加锁的 std::unordered_map 与 LogManager 的无锁查找
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/Log.h"
+
+namespace {
+
+	// 原有的实现：每次查找都加锁
+	class MutexRegistry {
+	public:
+		void AddLogger(const zch::Logger::ptr& logger) {
+			std::unique_lock<std::mutex> ulk(_mtx);
+			_loggers.insert(std::make_pair(logger->GetLoggerName(), logger));
+		}
+
+		zch::Logger::ptr GetLogger(const std::string& name) {
+			std::unique_lock<std::mutex> ulk(_mtx);
+			auto it = _loggers.find(name);
+			return it != _loggers.end() ? it->second : nullptr;
+		}
+
+	private:
+		std::mutex _mtx;
+		std::unordered_map<std::string, zch::Logger::ptr> _loggers;
+	};
+
+	class NullSink : public zch::LogSink {
+	public:
+		void log(const char* data, size_t len) override {}
+	};
+
+	const size_t kPreset = 64;
+	const size_t kLookups = 200000;
+	const size_t kMaxWrites = 2000;
+
+	zch::Logger::ptr MakeLogger(const std::string& name) {
+		zch::LocalLoggerBuilder builder;
+		builder.BuildName(name);
+		builder.AddLogSink<NullSink>();
+		return builder.Build();
+	}
+
+	// 返回每次查找的平均耗时(纳秒，按全部读者线程的总查找次数计算)以及写者注册的日志器个数
+	template<class Registry>
+	double Run(Registry& registry, const std::vector<std::string>& names, size_t readers, const std::string& prefix, size_t& writes) {
+		std::atomic<size_t> running(readers);
+		std::atomic<size_t> found(0);
+		// 写者在读者运行期间不断注册新的日志器
+		std::thread writer([&] {
+			size_t i = 0;
+			while (running.load() > 0 && i < kMaxWrites) {
+				registry.AddLogger(MakeLogger(prefix + std::to_string(i++)));
+			}
+			writes = i;
+		});
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < readers; ++t) {
+			threads.emplace_back([&, t] {
+				size_t hits = 0;
+				for (size_t i = 0; i < kLookups; ++i) {
+					if (registry.GetLogger(names[(i + t) % names.size()]) != nullptr) {
+						++hits;
+					}
+				}
+				found += hits;
+				--running;
+			});
+		}
+		for (auto& th : threads) {
+			th.join();
+		}
+		std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+		writer.join();
+		if (found != readers * kLookups) {
+			fprintf(stderr, "查找失败: %zu/%zu\n", found.load(), readers * kLookups);
+		}
+		return cost.count() / (readers * kLookups);
+	}
+}
+
+int main() {
+	MutexRegistry locked;
+	zch::LogManager& manager = zch::LogManager::GetInstance();
+	std::vector<std::string> names;
+	for (size_t i = 0; i < kPreset; ++i) {
+		names.push_back("rpc." + std::to_string(i));
+		zch::Logger::ptr logger = MakeLogger(names.back());
+		locked.AddLogger(logger);
+		manager.AddLogger(logger);
+	}
+
+	printf("%8s %20s %20s %10s\n", "readers", "mutex (ns/lookup)", "LogManager", "registered");
+	const size_t counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+	for (size_t readers : counts) {
+		size_t locked_writes = 0, manager_writes = 0;
+		std::string prefix = "w" + std::to_string(readers) + ".";
+		double locked_ns = Run(locked, names, readers, prefix, locked_writes);
+		double manager_ns = Run(manager, names, readers, prefix, manager_writes);
+		printf("%8zu %20.1f %20.1f %10zu\n", readers, locked_ns, manager_ns, manager_writes);
+	}
+
+	// 缓存 GetLogger 返回的引用后不再需要查找
+	const zch::Logger::ptr& cached = zch::GetLogger("rpc.0");
+	if (cached.get() != manager.GetLogger("rpc.0").get() || zch::GetLogger("no-such-logger") != nullptr) {
+		fprintf(stderr, "查找结果不正确\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file bench_sampling.cpp
+ * @brief 高频调用点的采样：对比全部输出、日志器级别的采样(每 N 条 / 按概率)与采样宏的每次调用耗时，
+ *        并校验按 sample_rate 还原出的条数与调用次数一致 (每 N 条采样误差不超过 N，按概率采样在 5 倍标准差内)
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/Log.h"
+
+namespace {
+
+	// 统计日志条数以及按 sample_rate 还原出的条数
+	class CountSink : public zch::LogSink {
+	public:
+		void log(const char* data, size_t len) override {
+			const char* end = data + len;
+			while (data < end) {
+				const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+				if (nl == nullptr) {
+					break;
+				}
+				const char* hit = static_cast<const char*>(memmem(data, nl - data, "sample_rate=", 12));
+				_lines += 1;
+				_scaled += hit != nullptr ? strtod(hit + 12, nullptr) : 1.0;
+				data = nl + 1;
+			}
+		}
+
+		uint64_t _lines = 0;
+		double _scaled = 0;
+	};
+
+	enum class Mode { ALL, EVERY_N, PROBABILITY, MACRO_EVERY_N, MACRO_SAMPLED };
+
+	const size_t per_thread = 2000000;
+	const uint64_t every_n = 1000;
+	const double probability = 0.001;
+
+	void Call(const zch::Logger::ptr& logger, Mode mode, size_t i) {
+		switch (mode) {
+			case Mode::MACRO_EVERY_N:
+				ZCH_LOG_DEBUG_EVERY_N(logger, every_n, "recv %zu bytes from %s:%d", i, "10.0.3.17", 51234);
+				break;
+			case Mode::MACRO_SAMPLED:
+				ZCH_LOG_DEBUG_SAMPLED(logger, probability, "recv %zu bytes from %s:%d", i, "10.0.3.17", 51234);
+				break;
+			default:
+				ZCH_LOG_DEBUG(logger, "recv %zu bytes from %s:%d", i, "10.0.3.17", 51234);
+				break;
+		}
+	}
+
+	bool Run(const char* name, Mode mode, size_t threads) {
+		auto sink = std::make_shared<CountSink>();
+		double cost_ns = 0;
+		{
+			zch::LocalLoggerBuilder builder;
+			builder.BuildName(name);
+			builder.BuildType(zch::LoggerType::Async_Logger);
+			builder.BuildFormatter("[%d{%H:%M:%S}][%p][%f:%l]%m%n");
+			builder.BuildOverflowPolicy(zch::OverflowPolicy::BLOCK);
+			if (mode == Mode::EVERY_N) {
+				builder.BuildSampleEveryN(every_n, zch::LogLevel::Level::DEBUG);
+			} else if (mode == Mode::PROBABILITY) {
+				builder.BuildSampleProbability(probability, zch::LogLevel::Level::DEBUG);
+			}
+			builder.AddLogSink(sink, nullptr);
+			zch::Logger::ptr logger = builder.Build();
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; ++t) {
+				workers.emplace_back([&logger, mode] {
+					for (size_t i = 0; i < per_thread; ++i) {
+						Call(logger, mode, i);
+					}
+				});
+			}
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			std::chrono::duration<double, std::nano> cost = std::chrono::steady_clock::now() - start;
+			cost_ns = cost.count() / (threads * per_thread);
+		}
+
+		const double total = static_cast<double>(threads * per_thread);
+		printf("%-16s %8zu %12.1f %12llu %14.0f\n", name, threads, cost_ns,
+				static_cast<unsigned long long>(sink->_lines), sink->_scaled);
+		double tolerance = 0;
+		if (mode == Mode::EVERY_N || mode == Mode::MACRO_EVERY_N) {
+			tolerance = static_cast<double>(every_n);
+		} else if (mode != Mode::ALL) {
+			tolerance = 5 * std::sqrt(total * (1 - probability) / probability);
+		}
+		if (std::fabs(sink->_scaled - total) > tolerance) {
+			fprintf(stderr, "%s: 还原的条数 %.0f 与调用次数 %.0f 相差过大\n", name, sink->_scaled, total);
+			return false;
+		}
+		return true;
+	}
+}
+
+int main() {
+	printf("%-16s %8s %12s %12s %14s\n", "mode", "threads", "ns/call", "lines", "scaled count");
+	const size_t counts[] = { 1, 4 };
+	for (size_t threads : counts) {
+		if (!Run("all", Mode::ALL, threads)
+			|| !Run("every-n(1000)", Mode::EVERY_N, threads)
+			|| !Run("p(0.001)", Mode::PROBABILITY, threads)
+			|| !Run("macro every-n", Mode::MACRO_EVERY_N, threads)
+			|| !Run("macro sampled", Mode::MACRO_SAMPLED, threads)) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file bench_shard.cpp
+ * @brief 分片异步日志器的吞吐量：多个生产者线程同时写入，统计从开始写入到全部落地的总吞吐
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "../include/Log.h"
+
+namespace {
+
+	// 落地的日志条数
+	std::atomic<size_t> g_lines(0);
+
+	// 丢弃所有数据的落地方向，只测量日志器本身的吞吐
+	class NullSink : public zch::LogSink {
+	public:
+		void log(const char* data, size_t len) override { g_lines += std::count(data, data + len, '\n'); }
+	};
+
+	const size_t producers = 8;
+	const size_t per_thread = 200000;
+
+	// 返回每秒落地的日志条数
+	double Run(size_t shards, bool deferred) {
+		zch::LocalLoggerBuilder builder;
+		builder.BuildName("shard");
+		builder.BuildType(zch::LoggerType::Async_Logger);
+		builder.BuildEnableLockFree();
+		if (deferred) {
+			builder.BuildEnableDeferred();
+		}
+		builder.BuildShards(shards);
+		builder.BuildFormatter("[%d{%H:%M:%S.%L}][%t][%p][%F:%l]%m%n");
+		builder.AddLogSink<NullSink>();
+		zch::Logger::ptr logger = builder.Build();
+
+		g_lines = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < producers; ++i) {
+			workers.emplace_back([&]() {
+				for (size_t j = 0; j < per_thread; ++j) {
+					logger->Info("request %zu done, user=%s latency=%.2fms", j, "alice", 1.25);
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		// 析构日志器会等待所有分片的数据落地完毕
+		logger.reset();
+		std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+		if (g_lines != producers * per_thread) {
+			fprintf(stderr, "shards=%zu: %zu of %zu lines reached the sink\n", shards, g_lines.load(), producers * per_thread);
+		}
+		return producers * per_thread / cost.count();
+	}
+}
+
+int main() {
+	printf("producers: %zu, hardware threads: %u\n", producers, std::thread::hardware_concurrency());
+	printf("%8s %20s %20s\n", "shards", "lockfree(msg/s)", "deferred(msg/s)");
+	for (size_t shards = 1; shards <= 8; shards *= 2) {
+		double eager = Run(shards, false);
+		double deferred = Run(shards, true);
+		printf("%8zu %20.0f %20.0f\n", shards, eager, deferred);
+	}
+	return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file bench_sink.cpp
+ * @brief 文件落地方向的对比：每 MB 数据的写系统调用次数以及吞吐量
+ *        (系统调用次数取自 /proc/self/io 中的 syscw)，以及按大小滚动时的滚动耗时
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+#include "../include/LogSink.h"
+
+namespace {
+
+	const size_t total_bytes = 128 * 1024 * 1024;
+	const char* path = "./bench_sink_tmp/sink.log";
+
+	// 当前进程累计的写系统调用次数
+	size_t WriteSyscalls() {
+		std::ifstream ifs("/proc/self/io");
+		std::string key;
+		size_t value = 0;
+		while (ifs >> key >> value) {
+			if (key == "syscw:") {
+				return value;
+			}
+		}
+		return 0;
+	}
+
+	// chunk 为每次调用 log 的数据长度：同步日志器每次写入一行，异步日志器每次写入一批
+	void Run(const char* name, size_t chunk, const std::function<zch::LogSink::ptr()>& create) {
+		unlink(path);
+		std::string data(chunk, 'x');
+		data.back() = '\n';
+		size_t calls = total_bytes / chunk;
+
+		size_t syscalls = WriteSyscalls();
+		auto start = std::chrono::steady_clock::now();
+		{
+			zch::LogSink::ptr sink = create();
+			for (size_t i = 0; i < calls; ++i) {
+				sink->log(data.data(), data.size());
+			}
+		}
+		std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+		syscalls = WriteSyscalls() - syscalls;
+		double mb = static_cast<double>(calls * chunk) / (1024 * 1024);
+		printf("%-28s %8zu %14.1f %12.0f\n", name, chunk, syscalls / mb, mb / cost.count());
+		unlink(path);
+	}
+
+	// 按大小滚动：统计写日志的线程上每次滚动的耗时
+	void RunRoll(size_t chunk, size_t file_size) {
+		std::string data(chunk, 'x');
+		data.back() = '\n';
+		size_t calls = total_bytes / chunk;
+		zch::RollBySizeSink::RollStats stats;
+		{
+			zch::RollBySizeSink sink("./bench_sink_tmp/roll", file_size);
+			for (size_t i = 0; i < calls; ++i) {
+				sink.log(data.data(), data.size());
+			}
+			stats = sink.Stats();
+		}
+		printf("%-28s %8zu %8zu %8zu %12.1f %12.1f\n", "RollBySizeSink(4MB)", chunk, static_cast<size_t>(stats._rolls)
+			, static_cast<size_t>(stats._stalls), stats._rolls ? stats._total_ns / 1000.0 / stats._rolls : 0.0, stats._max_ns / 1000.0);
+
+		// 删除滚动生成的文件
+		DIR* dp = opendir("./bench_sink_tmp");
+		if (dp != nullptr) {
+			while (struct dirent* entry = readdir(dp)) {
+				if (strncmp(entry->d_name, "roll-", 5) == 0) {
+					unlink((std::string("./bench_sink_tmp/") + entry->d_name).c_str());
+				}
+			}
+			closedir(dp);
+		}
+	}
+}
+
+int main() {
+	printf("%-28s %8s %14s %12s\n", "sink", "chunk", "syscalls/MB", "MB/s");
+	size_t chunks[] = { 128, 1024 * 1024 };
+	for (size_t chunk : chunks) {
+		Run("FileSink", chunk, []() { return zch::SinkFactory::create<zch::FileSink>(path); });
+		Run("FdSink", chunk, []() { return zch::SinkFactory::create<zch::FdSink>(path); });
+		Run("FdSink(batch=64KB)", chunk, []() { return zch::SinkFactory::create<zch::FdSink>(path, false, 64 * 1024); });
+		// 不暂存时 O_DIRECT 每次调用都要写入并截断文件，只适合异步日志器的批量写入
+		if (chunk >= 64 * 1024) {
+			Run("FdSink(O_DIRECT)", chunk, []() { return zch::SinkFactory::create<zch::FdSink>(path, true); });
+		}
+		Run("UringSink", chunk, []() { return zch::SinkFactory::create<zch::UringSink>(path); });
+		Run("MmapSink", chunk, []() { return zch::SinkFactory::create<zch::MmapSink>(path); });
+		Run("FdSink(O_DIRECT,batch=1MB)", chunk, []() { return zch::SinkFactory::create<zch::FdSink>(path, true, 1024 * 1024); });
+	}
+	printf("\n%-28s %8s %8s %8s %12s %12s\n", "sink", "chunk", "rolls", "stalls", "avg(us)", "max(us)");
+	RunRoll(128, 4 * 1024 * 1024);
+	printf("(UringSink 的写入由内核完成，不计入本进程的 syscw，每次 log 对应一次 io_uring_enter；MmapSink 直接写入映射区，没有写系统调用)\n");
+	rmdir("./bench_sink_tmp");
+	return 0;
+}
@@ -12,72 +12,248 @@
 #include <condition_variable>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "Buffer.hpp"
+#include "RingBuffer.hpp"
+#include "LogLevel.hpp"
+#include "Crash.h"
 
 namespace zch {
 
     enum class ASYNCTYPE {
         ASYNC_SAFE,
-        ASYNC_UN_SAFE
+        ASYNC_UN_SAFE,
+        // 每个生产者线程拥有独立的无锁环形缓冲区，异步线程按时间戳归并后再落地
+        ASYNC_LOCK_FREE
+    };
+
+    // 待处理数据达到上限时的处理策略
+    enum class OverflowPolicy {
+        // 阻塞等待异步线程腾出空间，超过等待时长后丢弃
+        BLOCK,
+        // 丢弃新写入的消息
+        DROP_NEWEST,
+        // 丢弃最早写入且尚未处理的消息 (无锁模式下生产者不能移动读位置，按 DROP_NEWEST 处理)
+        DROP_OLDEST,
+        // 丢弃低于指定等级的消息，其余消息按 BLOCK 处理
+        DROP_BELOW_LEVEL
+    };
+
+    struct OverflowOptions {
+        // 处理策略
+        OverflowPolicy _policy;
+        // 待处理数据的上限(字节)，生产者缓冲区与消费者缓冲区各自不超过该值；
+        // 0 表示使用工作模式的默认值：ASYNC_UN_SAFE 不设上限，其余模式为 default_buffer_size
+        // (无锁模式下每个线程的环形缓冲区大小固定，上限只约束每个线程尚未处理的超长消息占用的内存)
+        size_t _max_bytes;
+        // BLOCK 的最长等待时长，milliseconds::max() 表示一直等待
+        std::chrono::milliseconds _timeout;
+        // DROP_BELOW_LEVEL 的等级阈值
+        LogLevel::Level _level;
+
+        OverflowOptions(OverflowPolicy policy = OverflowPolicy::BLOCK
+                        , size_t max_bytes = 0
+                        , std::chrono::milliseconds timeout = std::chrono::milliseconds::max()
+                        , LogLevel::Level level = LogLevel::Level::WARN)
+                        : _policy(policy)
+                        , _max_bytes(max_bytes)
+                        , _timeout(timeout)
+                        , _level(level) {}
     };
 
     class AsynLopper {
     public:
         using cb_t = std::function<void(zch::Buffer&)>;
+        // 丢弃统计的回调，参数为上次回调以来丢弃的消息条数
+        using drop_cb_t = std::function<void(uint64_t)>;
+        // 空闲回调：异步线程处理完所有待处理的数据、即将等待新数据时调用
+        using idle_cb_t = std::function<void()>;
 		using ptr = std::shared_ptr<zch::AsynLopper>;
 
-        AsynLopper(cb_t call_back, ASYNCTYPE type = ASYNCTYPE::ASYNC_SAFE)
-			        : _type(type) 
+        AsynLopper(cb_t call_back
+                    , ASYNCTYPE type = ASYNCTYPE::ASYNC_SAFE
+                    , const OverflowOptions& overflow = OverflowOptions()
+                    , drop_cb_t drop_call_back = nullptr
+                    , idle_cb_t idle_call_back = nullptr)
+			        : _type(type)
 					, _stop(false)
-                    , _td(&AsynLopper::ThreadEntry, this)
-					, _call_back(call_back) {}
+					, _overflow(overflow)
+					, _cap(Capacity(type, overflow))
+					, _pro_buf(std::min(default_buffer_size, _cap), _cap)
+					, _con_buf(std::min(default_buffer_size, _cap), _cap)
+					, _pro_drop(0)
+					, _dropped(0)
+					, _reported(0)
+					, _last_seen(0)
+					, _id(NextId())
+					, _sleeping(false)
+					, _batch_data(nullptr)
+					, _batch_len(0)
+					, _sinking(false)
+					, _idle_pending(false)
+					, _call_back(call_back)
+					, _drop_call_back(drop_call_back)
+					, _idle_call_back(idle_call_back)
+                    , _td(&AsynLopper::ThreadEntry, this) {}
+
+        // 向生产者缓冲区放入数据，level 为消息的等级(用于 DROP_BELOW_LEVEL)，
+        // 消息因缓冲区已满被丢弃时返回 false
+		bool Push(const char* data, size_t len, LogLevel::Level level = LogLevel::Level::FATAL);
+
+        // 累计丢弃的消息条数
+		uint64_t Dropped() const { return _dropped.load(std::memory_order_relaxed); }
 
-        // 向生产者缓冲区放入数据
-		void Push(const char* data, size_t len);
+        // 进程崩溃时由信号处理函数调用：不加锁地取出尚未落地的数据，依次为异步线程正在落地的批次、
+        // 各线程的环形缓冲区与生产者缓冲区，每次以若干条完整的消息调用 fn。
+        // 崩溃处理开始后异步线程不再取走新的数据；正在落地的批次先等待异步线程写完，
+        // 异步线程本身崩溃或者超过等待时长时才由 fn 输出(可能与已经写入的部分重复)。结果只是尽力而为
+        void Salvage(void (*fn)(void* arg, const char* data, size_t len), void* arg);
 
         // 停止异步线程的工作
 		void Stop() {
-			_stop = true;
-			// 唤醒异步线程，进行退出
+			{
+				std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+				_stop = true;
+			}
+			// 唤醒异步线程，进行退出 (同时唤醒阻塞等待空间的生产者)
 			_cond_con.notify_all();
+			_cond_pro.notify_all();
 			// 回收异步线程
-			_td.join();
+			if (_td.joinable()) {
+				_td.join();
+			}
 		}
 
         ~AsynLopper() {
 			// 停止异步线程
 			Stop();
+			// 通知仍持有环形缓冲区的生产者线程，该工作器已经失效
+			for (auto& ring : _rings) {
+				ring->Close();
+			}
 		}
 
     private:
+        // 根据工作模式得到待处理数据的上限
+		static size_t Capacity(ASYNCTYPE type, const OverflowOptions& overflow) {
+			if (overflow._max_bytes > 0) {
+				return overflow._max_bytes;
+			}
+			return type == ASYNCTYPE::ASYNC_UN_SAFE ? SIZE_MAX : default_buffer_size;
+		}
+
+		// 在持有锁的情况下为长度为 len 的消息腾出生产者缓冲区的空间，按照策略无法放入时返回 false
+		bool Reserve(std::unique_lock<std::mutex>& ulk, size_t len, LogLevel::Level level);
+
+		// 在持有锁的情况下写入生产者缓冲区
+		void PushLocked(const char* data, size_t len);
+
+		// 在持有锁的情况下丢弃生产者缓冲区中最早的消息，直到能放下长度为 len 的消息
+		void DropOldest(size_t len);
+
+		// 生产者缓冲区被取走后，清空其中消息的长度记录
+		void ResetPending() {
+			_pro_lens.clear();
+			_pro_drop = 0;
+		}
+
+		// 异步线程在每批数据处理完毕后调用：一个完整的批次周期内没有新的丢弃，
+		// 说明压力已经解除，通过回调报告丢弃的条数；force 为 true 时直接报告
+		void ReportDropped(bool force = false);
+
+		// 是否有尚未报告的丢弃
+		bool Unreported() const { return _dropped.load(std::memory_order_relaxed) != _reported; }
+
         // 异步线程的入口函数
 		void ThreadEntry();
 
+		// 无锁模式下异步线程的入口函数
+		void RingThreadEntry();
+
+		// 无锁模式下的写入：写入当前线程独占的环形缓冲区
+		bool PushRing(const char* data, size_t len, LogLevel::Level level);
+
+		// 无锁模式下环形缓冲区已满时，短暂自旋后在生产者条件变量上等待异步线程腾出空间再写入，
+		// 超过等待时长时返回 false
+		bool WaitRing(SpscRing* ring, uint64_t stamp, const char* data, size_t len);
+
+		// 无锁模式下异步线程处于休眠时将其唤醒
+		void WakeConsumer();
+
+		// 获取(首次使用时注册)当前线程在本工作器中的环形缓冲区
+		SpscRing* LocalRing();
+
+		// 将所有环形缓冲区中的记录按时间戳归并到消费者缓冲区中，返回归并的记录数
+		size_t MergeRings(std::vector<SpscRing::ptr>& rings);
+
+		// 通过回调落地消费者缓冲区中的数据，并记录正在落地的批次供崩溃时取出
+		void Sink();
+
+		// 异步线程没有待处理的数据时调用：上次空闲以来落地过数据才调用空闲回调
+		void Idle();
+
+		// 为每个工作器分配唯一的标识，线程局部的环形缓冲区表以此为键
+		static uint64_t NextId() {
+			static std::atomic<uint64_t> id(0);
+			return ++id;
+		}
+
     private:
         // 异步工作器的安全类型
 		ASYNCTYPE _type;
-		// 线程的工作状态 
+		// 线程的工作状态
 		// (由于日志线程需要读取此变量的状态，而上层的业务线程可能会对这个变量进行修改，
 		// 因此这个变量存在线程安全问题，我们这里使用原子类型)
 		std::atomic<bool>  _stop;
+		// 缓冲区已满时的处理策略
+		OverflowOptions _overflow;
+		// 待处理数据的上限
+		size_t _cap;
 		// 保护生产者缓冲区的锁
 		std::mutex _mtx_pro_buf;
 		// 生产者缓冲区
 		zch::Buffer _pro_buf;
 		// 消费者缓冲区
 		zch::Buffer _con_buf;
+		// 生产者缓冲区中每条消息的长度，以及其中已经被丢弃的条数 (只在 DROP_OLDEST 时记录)
+		std::vector<size_t> _pro_lens;
+		size_t _pro_drop;
+		// 累计丢弃的消息条数
+		std::atomic<uint64_t> _dropped;
+		// 已经报告的丢弃条数，以及上一批次结束时的丢弃条数 (只由异步线程访问)
+		uint64_t _reported;
+		uint64_t _last_seen;
 		// 生产者条件变量
 		std::condition_variable _cond_pro;
 		// 消费者条件变量
 		std::condition_variable _cond_con;
-		// 异步线程对象
-		std::thread _td;
+		// 工作器的唯一标识
+		uint64_t _id;
+		// 保护环形缓冲区集合的锁(只有线程首次注册和异步线程取快照时才会使用)
+		std::mutex _mtx_rings;
+		// 所有生产者线程的环形缓冲区
+		std::vector<SpscRing::ptr> _rings;
+		// 异步线程是否处于休眠状态，生产者据此决定是否需要唤醒它
+		std::atomic<bool> _sleeping;
+		// 异步线程正在落地的批次 (落地期间 _sinking 为 true；回调会移动消费者缓冲区的读位置，因此单独记录)
+		const char* _batch_data;
+		size_t _batch_len;
+		std::atomic<bool> _sinking;
+		// 上次空闲以来是否落地过数据 (只由异步线程访问)
+		bool _idle_pending;
 		// 线程对象的回调函数
 		cb_t _call_back;
+		// 丢弃统计的回调函数
+		drop_cb_t _drop_call_back;
+		// 空闲回调函数
+		idle_cb_t _idle_call_back;
+		// 异步线程对象(必须最后初始化，保证线程启动时其余成员都已构造完毕)
+		std::thread _td;
     };
 }
 
@@ -0,0 +1,134 @@
+/**
+ * @file BinaryLog.h
+ * @brief 二进制日志文件格式：文本日志中的时间、等级、文件名、行号、日志器名称等前缀在每行中重复出现，
+ *        二进制格式中调用点与名称在每个文件中只写入一次，之后的日志只引用其编号，时间戳以变长整数
+ *        记录与上一条日志的差值，有效载荷原样写入。文件通过 zchlog-decode 按照任意格式化规则还原为文本
+ *
+ *        文件由若干段组成，每段以 8 字节的魔数开始(每次打开文件写入时开始新的一段)，魔数之后为若干条目，
+ *        条目的第一个字节为类型，其后的整数均为 LEB128 变长整数：
+ *          - 调用点定义：编号、行号、等级(1 字节)、文件名长度 + 文件名、格式串长度 + 格式串
+ *          - 字符串定义：编号、长度 + 内容 (日志器名称与线程名称共用一个编号空间)
+ *          - 日志：调用点编号、日志器名称编号、线程 id、线程名称编号、
+ *                  时间戳与上一条日志的差值(纳秒，zigzag 编码)、有效载荷长度 + 有效载荷
+ *        编号与时间戳的差值只在当前段内有效
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef BINARYLOG_H__
+#define BINARYLOG_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Formatter.h"
+#include "LogSink.h"
+
+namespace zch {
+
+    // 二进制格式化器：不生成文本，只把日志消息的各个字段(调用点、日志器名称、线程名称均为指针)
+    // 与有效载荷按原始字节打包，交给 BinaryFileSink 编码为文件格式。
+    // 只能与 BinaryFileSink 搭配使用，同一日志器中不能再有文本落地方向
+	class BinaryFormatter : public Formatter {
+	public:
+		BinaryFormatter() : Formatter("%m") {}
+
+		void Format(std::string& out, const LogMsg& msg) override;
+	};
+
+    // 二进制日志文件：解析 BinaryFormatter 打包的记录，按照文件格式写入。
+    // 调用点与名称在当前段中第一次出现时写入其定义。日志器的锁保证对本对象的调用是串行的。
+    // batch_size 与 FdSink 相同，大于 0 时较小的数据先暂存再批量写入
+	class BinaryFileSink : public LogSink {
+	public:
+		BinaryFileSink(const std::string& pathname, size_t batch_size = 0);
+
+		void log(const char* data, size_t len) override;
+
+		void Flush() override { _file->Flush(); }
+
+	private:
+		// 取得调用点在当前段中的编号，第一次出现时写入其定义
+		uint64_t SiteId(const CallSite* site);
+
+		// 取得字符串在当前段中的编号，第一次出现时写入其定义
+		uint64_t StringId(const char* str, size_t len);
+
+	private:
+		std::string _pathname;
+		std::unique_ptr<FdSink> _file;
+		// 本次 log 编码出的数据
+		std::string _out;
+		// 当前段中已经定义的调用点(静态对象，以其地址为键)与字符串(以内容为键：
+		// 日志器销毁、线程退出后其名称的地址可能被其他名称复用)
+		std::unordered_map<const CallSite*, uint64_t> _sites;
+		std::unordered_map<std::string, uint64_t> _strings;
+		// 查找字符串编号时复用的键
+		std::string _key;
+		// 当前段中上一条日志的时间戳(纳秒)
+		int64_t _prev_ns;
+		// 是否已经报告过无法解析的数据
+		bool _reported;
+	};
+
+    // 二进制日志文件的读取器，按顺序还原出每条日志消息
+	class BinaryReader {
+	public:
+		BinaryReader(const std::string& pathname);
+
+		~BinaryReader();
+
+		// 文件是否成功打开并且以魔数开始
+		bool IsOpen() const { return _data != nullptr; }
+
+		// 读取下一条日志，msg 中的指针在读取器析构前有效；到达文件末尾时返回 false。
+		// 遇到损坏的数据时跳到下一段继续读取 (进程崩溃时最后一条不完整，重启后文件中会追加新的一段)
+		bool Next(LogMsg& msg);
+
+		// 是否遇到过损坏或不完整的数据 (其后直到下一段开始的内容被跳过)
+		bool Corrupted() const { return _corrupted; }
+
+	private:
+		// 读取一个变长整数，数据不完整时返回 false
+		bool ReadVarint(uint64_t& value);
+
+		// 读取长度 + 内容
+		bool ReadBytes(std::string& str);
+
+		// 开始新的一段，清空编号与时间戳
+		void ResetSegment();
+
+		// 是否有魔数从 start 开始刚刚解析出的条目内部开始：不完整的条目会把之后一段的开头当作自己的内容
+		bool CrossesSegment(size_t start) const;
+
+		// 从 from 开始查找下一段的魔数，找不到时定位到文件末尾
+		void SkipToSegment(size_t from);
+
+	private:
+		// 解码出的调用点 (CallSite 中的文件名与格式串指向本结构体中的字符串)
+		struct SiteEntry {
+			std::string _file;
+			std::string _fmt;
+			std::unique_ptr<CallSite> _site;
+		};
+
+		// 文件的只读映射
+		const char* _data;
+		size_t _size;
+		size_t _pos;
+		bool _corrupted;
+		// 解码出的全部调用点与字符串 (保证返回的指针在读取器析构前有效)
+		std::vector<std::unique_ptr<SiteEntry>> _owned_sites;
+		std::vector<std::unique_ptr<std::string>> _owned_strings;
+		// 当前段中按编号索引的调用点与字符串
+		std::vector<const CallSite*> _sites;
+		std::vector<const std::string*> _strings;
+		// 当前段中上一条日志的时间戳(纳秒)
+		int64_t _prev_ns;
+	};
+}
+
+#endif
@@ -9,7 +9,10 @@
 #define BUFFER_H__
 
 #include <iostream>
+#include <algorithm>
 #include <vector>
+#include <cstdint>
+#include <cstring>
 #include <assert.h>
 
 namespace zch {
@@ -22,10 +25,12 @@ namespace zch {
 
     class Buffer {
     public:
-        Buffer(size_t buffer_size = default_buffer_size) 
+        // max_size 为扩容时缓冲区大小的上限(数据本身超过上限时以数据大小为准)
+        Buffer(size_t buffer_size = default_buffer_size, size_t max_size = SIZE_MAX) 
 				: _buffer(buffer_size)
 				, _read_idx(0)
-				, _write_idx(0) {}
+				, _write_idx(0)
+				, _max_size(max_size) {}
 
         // 返回可写空间大小 
 		size_t WriteableSize() { return _buffer.size() - _write_idx; }
@@ -37,7 +42,7 @@ namespace zch {
 		void MoveReadIdx(size_t len) {
 			// 防止外界传入的参数不合法
 			if (len > ReadableSize()) {
-				_read_idx = ReadableSize();
+				_read_idx = _write_idx;
 			} else {
 				_read_idx += len;
 			}
@@ -70,7 +75,10 @@ namespace zch {
         
         // 将数据放入缓冲区中
 		inline void Push(const char* data, size_t len) {
-			// 1. 判断空间是否足够
+			// 1. 判断空间是否足够，先回收已读数据占用的空间，仍然不够再扩容
+			if (len > WriteableSize() && _read_idx > 0) {
+				Compact();
+			}
 			if (len > WriteableSize()) {
                 Resize(len);
             }
@@ -89,6 +97,14 @@ namespace zch {
 			_write_idx += len;
 		}
 
+        // 将未读数据移动到缓冲区起始位置
+		void Compact() {
+			size_t readable = ReadableSize();
+			memmove(&_buffer[0], &_buffer[_read_idx], readable);
+			_read_idx = 0;
+			_write_idx = readable;
+		}
+
         // 扩容
 		void Resize(size_t len) {
 			size_t new_size;
@@ -97,6 +113,8 @@ namespace zch {
 			} else {
 				new_size = _buffer.size() + increament + len;
 			}
+			// 不超过大小上限，但至少能放下本次写入的数据
+			new_size = std::max(std::min(new_size, _max_size), _write_idx + len);
 			_buffer.resize(new_size);
 		}
         
@@ -107,6 +125,8 @@ namespace zch {
 		size_t _read_idx;
 		// 可写位置的起始下标
 		size_t _write_idx;
+		// 缓冲区大小的上限
+		size_t _max_size;
     };
 }
 
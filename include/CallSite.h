@@ -0,0 +1,133 @@
+/**
+ * @file CallSite.h
+ * @brief 日志调用点描述符：每个日志宏展开处在首次使用时注册一个静态的描述符，
+ *        保存文件名、行号、等级、格式串等元数据，日志消息只需携带指向它的指针；
+ *        同时预先解析 printf 格式串，用于延迟格式化时捕获与还原参数
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef CALLSITE_H__
+#define CALLSITE_H__
+
+#include <cstdarg>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LogLevel.hpp"
+
+namespace zch {
+
+    // printf 参数在可变参数列表中的类型
+	enum class ArgType : uint8_t {
+		INT,			// int / char / short / wint_t 之外的整数提升类型
+		LONG,			// long
+		LONGLONG,		// long long
+		INTMAX,			// intmax_t
+		SIZE,			// size_t
+		PTRDIFF,		// ptrdiff_t
+		DOUBLE,			// double
+		LONGDOUBLE,		// long double
+		STRING,			// const char*
+		POINTER			// void*
+	};
+
+    // 格式串被拆分成的片段：原始字符串或者一个转换说明符
+	struct FmtSegment {
+		bool _literal;				// 是否为原始字符串
+		std::string _text;			// 原始字符串内容或者转换说明符(如 "%-*.3lu")
+		int _stars;					// 转换说明符中 '*' 的个数，每个 '*' 对应一个 int 参数
+		int _precision;				// %s 的精度，-1 表示未指定，-2 表示由 '*' 参数指定
+		ArgType _type;				// 转换说明符对应的参数类型
+	};
+
+    // 日志调用点
+	class CallSite {
+	public:
+		CallSite(const char* file, size_t line, LogLevel::Level level, const char* fmt);
+
+		// 调用点的格式串能否进行延迟格式化
+		// (%n、%m、位置参数和宽字符等在异步线程中无法还原，只能在调用线程中格式化)
+		bool Deferrable() const { return _deferrable; }
+
+		// 在调用线程中按照格式串从可变参数列表中取出参数，将其原始字节追加到 out 中
+		void EncodeArgs(va_list ap, std::string& out) const;
+
+		// 在异步线程中根据 EncodeArgs 捕获的参数还原出格式化后的有效载荷
+		void RenderArgs(const char* data, size_t len, std::string& out) const;
+
+	private:
+		// 解析格式串并填充 _segments 数组
+		bool ParseFormat();
+
+	public:
+		const char* _file;				// 源码文件名
+		const char* _basename;			// 源码文件的基础名(指向 _file 中最后一个路径分隔符之后)
+		size_t _line;					// 源码行号
+		LogLevel::Level _level;			// 日志等级
+		const char* _fmt;				// 格式串(只保存字符串常量，其余格式串为 nullptr)
+		uint32_t _id;					// 调用点的唯一标识(按注册顺序从 0 开始分配，进程内不变)
+
+	private:
+		bool _deferrable;
+		std::vector<FmtSegment> _segments;
+	};
+
+    // 格式串表达式是否为字符串常量 (const char 数组的左值)。字符串常量的地址与内容在进程内不变，
+    // 调用点才能保存它并据此延迟格式化；复用的缓冲区等其他格式串在同一地址上内容可能不同，
+    // 每次都在调用线程中格式化
+	template<class T>
+	struct IsFormatLiteral { static const bool value = false; };
+
+	template<size_t N>
+	struct IsFormatLiteral<const char (&)[N]> { static const bool value = true; };
+
+    // 调用点注册表：按唯一标识保存所有已注册的调用点
+	class CallSiteRegistry {
+	public:
+		static CallSiteRegistry& GetInstance() {
+			static CallSiteRegistry ins;
+			return ins;
+		}
+
+		// 注册调用点，返回分配的唯一标识
+		uint32_t Register(const CallSite* site) {
+			std::unique_lock<std::mutex> ulk(_mtx_sites);
+			_sites.push_back(site);
+			return static_cast<uint32_t>(_sites.size() - 1);
+		}
+
+		// 根据唯一标识查找调用点，不存在时返回 nullptr
+		const CallSite* Get(uint32_t id) {
+			std::unique_lock<std::mutex> ulk(_mtx_sites);
+			return id < _sites.size() ? _sites[id] : nullptr;
+		}
+
+		// 已注册的调用点个数
+		size_t Size() {
+			std::unique_lock<std::mutex> ulk(_mtx_sites);
+			return _sites.size();
+		}
+
+	private:
+		CallSiteRegistry() {}
+		CallSiteRegistry(const CallSiteRegistry&) = delete;
+
+	private:
+		std::mutex _mtx_sites;
+		std::vector<const CallSite*> _sites;
+	};
+}
+
+// 在宏展开处定义一个静态的调用点描述符，首次执行时完成注册。
+// 只有字符串常量才保存为调用点的格式串；条件在编译期确定，其他格式串表达式在这里不会被求值，
+// 日志调用中只求值一次
+#define ZCH_CALL_SITE(level, fmt) \
+	([](const char* zch_fmt) -> const zch::CallSite* { \
+		static const zch::CallSite zch_site(__FILE__, __LINE__, level, zch_fmt); \
+		return &zch_site; \
+	}(zch::IsFormatLiteral<decltype((fmt))>::value ? (fmt) : nullptr))
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file Clock.h
+ * @brief 日志时间戳的时钟源：每个日志器可以选择不同精度与开销的时钟
+ *          - CLOCK_REALTIME_COARSE：开销最低，精度为系统时钟节拍(通常 1~4 毫秒)
+ *          - CLOCK_REALTIME：纳秒精度的墙上时间
+ *          - TSC：读取处理器时间戳计数器，由后台线程定期对照墙上时间进行校准
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef CLOCK_H__
+#define CLOCK_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+namespace zch {
+
+    enum class ClockType {
+        REALTIME_COARSE,
+        REALTIME,
+        TSC
+    };
+
+    // 基于时间戳计数器的时钟
+	// 换算参数 (基准计数值、基准纳秒、每个计数对应的纳秒数) 由后台线程定期(最长每秒)重新校准，
+	// 通过顺序锁发布，读取方无需加锁。
+	// 重新校准时换算出的时间如果超前于墙上时间，不直接回退，而是以当前换算值为基准、
+	// 放慢到下一次校准前追平；同一线程取得的时间不会回退。
+	// 墙上时间被向后调整超过 kMaxSlew 时跟随跳变(与 CLOCK_REALTIME 一致)
+	class TscClock {
+	public:
+		static TscClock& GetInstance() {
+			static TscClock ins;
+			return ins;
+		}
+
+		// 当前处理器是否提供频率恒定的时间戳计数器，不可用时退化为 CLOCK_REALTIME
+		bool Available() const { return _available; }
+
+		// 自 1970-01-01 以来的纳秒数
+		int64_t Now();
+
+		~TscClock();
+
+	private:
+		TscClock();
+		TscClock(const TscClock&) = delete;
+
+		// 读取时间戳计数器
+		static uint64_t ReadTsc();
+
+		// 同时采样时间戳计数器与墙上时间
+		static void Sample(uint64_t& tsc, int64_t& ns);
+
+		// 后台校准线程的入口函数
+		void CalibrateEntry();
+
+		// 发布新的换算参数
+		void Publish(uint64_t base_tsc, int64_t base_ns, double ns_per_tick, uint64_t epoch);
+
+	private:
+		bool _available;
+		// 顺序锁：奇数表示正在更新
+		std::atomic<uint64_t> _seq;
+		std::atomic<uint64_t> _base_tsc;
+		std::atomic<int64_t> _base_ns;
+		std::atomic<double> _ns_per_tick;
+		// 墙上时间向后跳变的次数，线程内的时间只在同一纪元中保持不回退
+		std::atomic<uint64_t> _epoch;
+		// 首次采样，作为计算换算比例的起点
+		uint64_t _first_tsc;
+		int64_t _first_ns;
+		// 校准线程的退出控制
+		bool _stop;
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		std::thread _td;
+	};
+
+    class Clock {
+    public:
+        // 按照指定时钟源取得当前时间，sec 为自 1970-01-01 以来的秒数，nsec 为秒内的纳秒数
+        static void Now(ClockType type, time_t& sec, long& nsec) {
+            if (type == ClockType::TSC) {
+                int64_t ns = TscClock::GetInstance().Now();
+                sec = static_cast<time_t>(ns / 1000000000);
+                nsec = static_cast<long>(ns % 1000000000);
+                return;
+            }
+            struct timespec ts;
+            clock_gettime(type == ClockType::REALTIME ? CLOCK_REALTIME : CLOCK_REALTIME_COARSE, &ts);
+            sec = ts.tv_sec;
+            nsec = ts.tv_nsec;
+        }
+    };
+}
+
+#endif
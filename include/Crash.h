@@ -0,0 +1,123 @@
+/**
+ * @file Crash.h
+ * @brief 进程崩溃时的日志保全：异步日志器缓冲区中尚未落地的日志恰好是分析崩溃最需要的上下文，
+ *        进程收到 SIGSEGV、SIGABRT 等信号后这部分数据会直接丢失。
+ *        1. 致命信号的处理函数通过 write 等异步信号安全的系统调用，把待处理的日志直接写入落地方向；
+ *        2. 崩溃环：预先分配并映射的文件，保存最近写入的若干 KB 日志，数据拷贝完成后即位于页缓存中，
+ *           即使处理函数在输出过程中再次崩溃，内容也不会丢失 (使用 zchlog-crash 读取)
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef CRASH_H__
+#define CRASH_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace zch {
+
+    // 崩溃环文件：[文件头][数据区]，数据区按环形覆盖写入，文件头记录累计写入的字节数
+    class CrashRing {
+    public:
+        using ptr = std::shared_ptr<CrashRing>;
+
+        // 创建并映射崩溃环文件，数据区的大小为 size。
+        // 上一次运行留下的崩溃环(写入过数据)先改名为 pathname.1 保留，避免进程被自动拉起后覆盖崩溃现场
+        CrashRing(const std::string& pathname, size_t size = 256 * 1024);
+
+        ~CrashRing();
+
+        bool IsOpen() const { return _data != nullptr; }
+
+        // 追加数据，多个线程可以同时调用，超过容量时覆盖最早的数据。
+        // 只使用原子操作与 memcpy，可以在信号处理函数中调用
+        void Append(const char* data, size_t len);
+
+        // 按写入顺序读出崩溃环文件中保存的数据，文件格式不正确时返回 false
+        static bool Read(const std::string& pathname, std::string& out);
+
+    private:
+        CrashRing(const CrashRing&) = delete;
+
+        struct Header {
+            char _magic[8];
+            uint64_t _capacity;     // 数据区的大小
+            uint64_t _written;      // 累计写入的字节数 (对 _capacity 取模即为下一次写入的位置)
+        };
+
+    private:
+        std::string _pathname;
+        Header* _header;
+        char* _data;
+        size_t _capacity;
+        size_t _map_size;
+    };
+
+    // 异步日志器的崩溃保全选项
+    struct CrashOptions {
+        // 崩溃时是否把异步缓冲区中待处理的日志直接写入落地方向
+        bool _drain;
+        // 崩溃环 (为空表示不使用)
+        CrashRing::ptr _ring;
+
+        CrashOptions(bool drain = false, const CrashRing::ptr& ring = nullptr)
+                    : _drain(drain)
+                    , _ring(ring) {}
+    };
+
+    // 信号处理函数中使用的定长文本缓冲区：不分配内存，超出容量的部分被截断
+    class CrashText {
+    public:
+        CrashText() : _len(0) {}
+
+        CrashText& Append(const char* data, size_t len);
+
+        CrashText& Append(const char* str);
+
+        CrashText& AppendUInt(uint64_t v);
+
+        const char* Data() const { return _buf; }
+        size_t Size() const { return _len; }
+
+    private:
+        char _buf[1024];
+        size_t _len;
+    };
+
+    // 进程崩溃时需要输出待处理数据的对象
+    class CrashListener {
+    public:
+        // 由信号处理函数调用，实现中只能使用异步信号安全的操作：不加锁、不分配内存、不使用 stdio
+        virtual void OnCrash(int sig) = 0;
+
+    protected:
+        ~CrashListener() {}
+    };
+
+    // 致命信号(SIGSEGV、SIGBUS、SIGFPE、SIGILL、SIGABRT)的处理
+    class CrashHandler {
+    public:
+        // 安装信号处理函数 (只安装一次)。处理函数依次通知所有已注册的对象，
+        // 然后恢复安装前的处理方式并重新发送该信号，进程照常终止(生成 core)或交给原来的处理函数。
+        // 调用线程同时设置备用信号栈，该线程栈溢出时处理函数同样可以执行
+        static void Install();
+
+        // 注册/注销崩溃时需要通知的对象，最多同时注册 64 个，超出时返回 false
+        static bool Register(CrashListener* listener);
+        static void Unregister(CrashListener* listener);
+
+        // 是否有线程正在执行崩溃处理
+        static bool Crashing();
+
+        // 崩溃处理期间异步线程调用：不再取走新的数据(剩余数据由信号处理函数输出)，等待进程结束
+        static void Park();
+
+        // 将数据完整写入 fd，处理被信号中断以及部分写入的情况 (异步信号安全)
+        static bool WriteFully(int fd, const char* data, size_t len);
+    };
+}
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file Dedup.h
+ * @brief 按调用点合并重复日志：依赖的服务故障时，重试循环中的同一条错误日志每秒可能输出几十万次，
+ *        占满异步缓冲区与磁盘。开启合并后，同一调用点在一个时间窗口内只输出第一条日志，
+ *        其余日志只计数，窗口结束后该调用点的下一条日志之前输出一条
+ *        "message repeated N times in T ms" 汇总；重复日志停止后，由定时线程输出最后一个窗口的汇总
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef DEDUP_H__
+#define DEDUP_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "CallSite.h"
+
+namespace zch {
+
+	// 同一调用点的日志(格式串相同，参数可以不同)视为近似相同的日志。
+	// 判断过程只使用原子操作，不加锁；被合并的日志不需要格式化，开销只有一次粗粒度时钟读取与一次原子加法
+	class Deduper {
+	public:
+		// 汇总的输出方式：调用点、被合并的条数、持续的毫秒数
+		using report_t = std::function<void(const CallSite*, uint64_t, uint64_t)>;
+
+		// window 为合并窗口；slots 为槽位个数(向上取整为 2 的幂)，调用点按唯一标识映射到槽位，
+		// 槽位已经被其他调用点占用时该调用点的日志不进行合并。
+		// 第一次有日志被合并时启动定时线程，每隔半个窗口(10ms ~ 1s)通过 report 输出已经结束的窗口的汇总
+		Deduper(std::chrono::milliseconds window, const report_t& report, size_t slots = 4096);
+
+		~Deduper();
+
+		// 判断调用点的这条日志是否被合并(不输出)。
+		// 返回 false 并且 repeated 大于 0 时，调用者需要在这条日志之前输出汇总：
+		// 上一个窗口中有 repeated 条日志被合并，持续 elapsed_ms 毫秒
+		bool Suppress(const CallSite* site, uint64_t& repeated, uint64_t& elapsed_ms);
+
+		// 取出所有调用点尚未汇总的计数 (日志器析构时调用，保证最后一个窗口的汇总不丢失)
+		void Drain(const report_t& fn);
+
+		// 停止定时线程 (日志器析构时在 Drain 之前调用，之后不再调用 report)
+		void StopTimer();
+
+	private:
+		struct Slot {
+			std::atomic<const CallSite*> _site;		// 占用该槽位的调用点
+			std::atomic<int64_t> _start;			// 当前窗口的开始时间(纳秒)
+			std::atomic<int64_t> _last;				// 最后一条被合并的日志的时间(纳秒)
+			std::atomic<uint64_t> _count;			// 当前窗口中被合并的条数
+		};
+
+		// 单调时钟的当前时间(纳秒)，使用粗粒度时钟，精度足以衡量毫秒级的窗口
+		static int64_t NowNs();
+
+		// 输出已经结束且尚未汇总的窗口
+		void Expire();
+
+		// 定时线程的入口函数
+		void TimerEntry();
+
+	private:
+		int64_t _window_ns;
+		size_t _mask;
+		std::unique_ptr<Slot[]> _slots;
+		report_t _report;
+		// 定时线程 (第一次有日志被合并时启动)
+		std::atomic<bool> _started;
+		std::once_flag _start_once;
+		bool _stop;
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		std::thread _td;
+	};
+}
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file Escape.h
+ * @brief 有效载荷的转义与 UTF-8 校验：日志消息中夹带的换行或控制字符会把一条记录拆成多行、
+ *        破坏文件内容，非法的 UTF-8 字节会让下游的 JSON 解析失败。
+ *        扫描按 SSE2/AVX2 一次检查 16/32 个字节，不需要处理的载荷整段原样复制；
+ *        不支持的平台上使用逐字节的实现
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef ESCAPE_H__
+#define ESCAPE_H__
+
+#include <cstddef>
+#include <string>
+
+namespace zch {
+
+	// 转义规则 (与 JSON 字符串一致，结果可以直接放进 JSON 的引号中)：
+	//   '"'、'\\' 转义为 \" 与 \\；'\n'、'\r'、'\t' 转义为 \n、\r、\t；
+	//   其余控制字符(0x00 ~ 0x1f 以及 0x7f)转义为 \u00XX；
+	//   合法的 UTF-8 多字节字符原样保留，非法的字节替换为 U+FFFD
+	class Escaper {
+	public:
+		// 扫描实现
+		enum class Kernel { SCALAR, SSE2, AVX2 };
+
+		// 转义后追加到 out 中
+		static void Append(std::string& out, const char* data, size_t len);
+
+		// 第一个需要检查的字节(需要转义的 ASCII 字符或者非 ASCII 字节)的位置，没有时返回 len
+		static size_t Scan(const char* data, size_t len);
+
+		// 当前使用的扫描实现 (首次使用时按 CPU 支持的指令集选择)
+		static Kernel Active();
+
+		// 指定扫描实现，CPU 不支持时返回 false；只用于测试与性能对比，需要在开始输出日志之前调用
+		static bool Select(Kernel kernel);
+
+		static const char* ToCString(Kernel kernel);
+	};
+}
+
+#endif
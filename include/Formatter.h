@@ -15,123 +15,228 @@
 #include <vector>
 #include <cassert>
 #include <unordered_set>
+#include <atomic>
 
+#include "Escape.h"
 #include "LogMsg.h"
 
 /**
  * 日志格式如：%d{%H:%M:%S}%T[%t]%T[%p]%T[%c]%T%f:%l%T%m%n
  * 
  * 日志格式符               描述
- *     %d                  日期
+ *     %d                  日期 (子格式为 strftime 格式，另外支持 %L 毫秒、%f 微秒、%N 纳秒)
  *     %T                  缩进
- *     %t                 线程 id
+ *     %t                 线程 id (内核线程 id)
+ *     %i                 线程名称 (通过 ThreadInfo::SetName 注册)
  *     %p                 日志级别
  *     %c                日志器名称
  *     %f                  文件名
+ *     %F               文件基础名(不含目录)
  *     %l                  行号
- *     %m                 日志消息
+ *     %m                 日志消息 (结构化字段以 logfmt 的形式追加在消息之后)；
+ *                        %m{escape} 转义消息中的换行、引号与控制字符并把非法的 UTF-8 字节替换为 U+FFFD
  *     %n                  换行
  */
 
 namespace zch {
 
+    // 结构化字段的序列化，直接追加到输出中
+	class FieldWriter {
+	public:
+		// logfmt：key=value，值中含有空白、'='、'"' 等字符时加引号并转义
+		static void AppendLogfmt(std::string& out, const Field* fields, size_t n);
+
+		// logfmt 的单个值
+		static void AppendLogfmtValue(std::string& out, const char* data, size_t len);
+
+		// JSON 对象的成员："key":value，每个成员前都有 ','
+		static void AppendJson(std::string& out, const Field* fields, size_t n);
+
+		// JSON 字符串 (包括两侧的引号)
+		static void AppendJsonString(std::string& out, const char* data, size_t len);
+	};
+
     // 格式化基类
     class FormatItem {
 	public:
 		using ptr = std::shared_ptr<FormatItem>;
-		virtual void Format(std::ostream& out, const LogMsg& msg) = 0;
+		virtual ~FormatItem() {}
+		// 将格式化结果追加到 out 中 (调用者复用 out 的容量，稳态下不产生堆分配)
+		virtual void Format(std::string& out, const LogMsg& msg) = 0;
 	};
 
     // 日期格式化子项
+	// 同一秒内的日志渲染结果中只有秒以下的部分不同，因此每个线程缓存上一次的渲染结果，
+	// 只有秒数变化时才重新调用 localtime_r 和 strftime；%L、%f、%N 在缓存结果中的位置
+	// 被预先记录下来，每条日志只需要用整数格式化填入这些字段
 	class TimeFormatItem : public FormatItem {
 	public:
 		// 日期格式化子项比较特殊，我们在使用时还需要指定时分秒的格式
-		TimeFormatItem(const std::string& fmt = "%H:%M:%S") : _time_fmt(fmt) {}
+		// cache_utc_offset 为 true 时缓存本地时区相对 UTC 的偏移，使用 gmtime_r 代替 localtime_r 进行换算，
+		// 偏移每隔一段时间(足以覆盖夏令时切换)重新查询一次
+		TimeFormatItem(const std::string& fmt = "%H:%M:%S", bool cache_utc_offset = false);
 
 		// 重写父类的格式化接口
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			struct tm t;
-			char buf[32] = { 0 };
-			// 使用C库函数对时间戳进行格式化
-			localtime_r(&msg._ctime, &t);
-            // 将结构体 t 中存储的时间按照 _time_fmt 的格式进行存储到 buf 中。 
-			strftime(buf, sizeof(buf), _time_fmt.c_str(), &t);
-			// 放入流中
-			oss << buf;
+		void Format(std::string& out, const LogMsg& msg) override {
+			TimeCache& cache = LocalCache();
+			if (!cache._valid || cache._sec != msg._ctime) {
+				Render(cache, msg._ctime);
+			}
+			if (_subsec.empty()) {
+				out.append(cache._text);
+				return;
+			}
+			// 将秒以下的字段依次填入缓存结果中预留的位置
+			size_t pos = 0;
+			for (size_t i = 0; i < _subsec.size(); ++i) {
+				out.append(cache._text, pos, cache._ends[i] - pos);
+				switch (_subsec[i]) {
+					case 'L': Number::AppendPadded(out, msg._nsec / 1000000, 3); break;
+					case 'f': Number::AppendPadded(out, msg._nsec / 1000, 6); break;
+					default: Number::AppendPadded(out, msg._nsec, 9); break;
+				}
+				pos = cache._ends[i];
+			}
+			out.append(cache._text, pos, std::string::npos);
 		}
+
+	private:
+		// 线程局部的渲染结果缓存
+		struct TimeCache {
+			uint64_t _owner = 0;			// 所属格式化子项的唯一标识
+			bool _valid = false;			// 缓存是否有效
+			time_t _sec = 0;				// 缓存对应的秒数
+			std::string _text;				// 渲染结果(不含秒以下的字段)
+			std::vector<size_t> _ends;		// 每个秒以下字段在 _text 中的插入位置
+			// 以下为缓存的 UTC 偏移及其有效区间 [_offset_begin, _offset_end)
+			long _gmtoff = 0;
+			int _isdst = 0;
+			const char* _zone = nullptr;
+			time_t _offset_begin = 0;
+			time_t _offset_end = 0;
+		};
+
+		// 取得当前线程中属于本子项的缓存
+		TimeCache& LocalCache();
+
+		// 重新渲染 sec 对应的时间
+		void Render(TimeCache& cache, time_t sec);
+
+		// 为每个子项分配唯一标识(不使用对象地址，避免新对象复用旧地址时命中过期的缓存)
+		static uint64_t NextId() {
+			static std::atomic<uint64_t> id(0);
+			return ++id;
+		}
+
 	private:
 		std::string _time_fmt;
+		// _time_fmt 按秒以下的字段拆分成的 strftime 格式串，个数比 _subsec 多一个
+		std::vector<std::string> _chunks;
+		// 秒以下的字段：'L' 毫秒，'f' 微秒，'N' 纳秒
+		std::vector<char> _subsec;
+		bool _cache_utc_offset;
+		uint64_t _id;
 	};
 
     // 日志等级格式化子项
 	class LevelFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << LogLevel::ToString(msg._level);
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			out.append(LogLevel::ToCString(msg.Level()));
 		}
 	};
 
     // 日志器名称格式化子项
 	class LoggerFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << msg._logger;
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			if (msg._logger != nullptr) {
+				out.append(*msg._logger);
+			}
 		}
 	};
 
     // 线程id格式化子项
 	class ThreadFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << msg._tid;
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 当前线程的 id 使用线程局部缓存中预先生成的文本
+			ThreadInfo::AppendTid(out, msg._tid);
+		}
+	};
+
+    // 线程名称格式化子项
+	class ThreadNameFormatItem : public FormatItem {
+	public:
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			out.append(msg._tname);
 		}
 	};
 
     // 文件名称格式化子项
 	class FileFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << msg._file;
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			out.append(msg._site->_file);
+		}
+	};
+
+    // 文件基础名格式化子项
+	class BaseNameFormatItem : public FormatItem {
+	public:
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 基础名在调用点注册时已经计算完毕
+			out.append(msg._site->_basename);
 		}
 	};
 
     // 文件行号格式化子项
 	class LineFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << msg._line;
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			Number::AppendUInt(out, msg._site->_line);
 		}
 	};
 
     // 日志有效信息格式化子项
+	// escape 为 true 时转义换行、引号与控制字符并校验 UTF-8，保证一条日志只占一行
 	class MsgFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << msg._payload;
+		MsgFormatItem(bool escape = false) : _escape(escape) {}
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 提取指定字段追加到输出中
+			if (_escape) {
+				Escaper::Append(out, msg._payload.data(), msg._payload.size());
+			} else {
+				out.append(msg._payload);
+			}
+			if (msg._nfields > 0) {
+				FieldWriter::AppendLogfmt(out, msg._fields, msg._nfields);
+			}
 		}
+
+	private:
+		bool _escape;
 	};
 
     // 制表符格式化子项
 	class TabFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << "\t";
+		void Format(std::string& out, const LogMsg& msg) override {
+			out.push_back('\t');
 		}
 	};
 
     // 新行格式化子项
 	class NLineFormatItem : public FormatItem {
 	public:
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 提取指定字段插入流中
-			oss << "\n";
+		void Format(std::string& out, const LogMsg& msg) override {
+			out.push_back('\n');
 		}
 	};
 
@@ -141,9 +246,9 @@ namespace zch {
 	public:
 		// 想要在日志中添加的字符
 		OtherFormatItem(const std::string& str) :_str(str) {}
-		void Format(std::ostream& oss, const LogMsg& msg) override {
-			// 将字符串添加到流中
-			oss << _str;
+		void Format(std::string& out, const LogMsg& msg) override {
+			// 将字符串追加到输出中
+			out.append(_str);
 		}
 
 	private:
@@ -154,19 +259,31 @@ namespace zch {
 	class Formatter {
 	public:
 		using ptr = std::shared_ptr<Formatter>;
-		Formatter(const std::string& pattern = "[%d{%H:%M:%S}][%p][%f:%l]%m%n") : _pattern(pattern) {
+		// cache_utc_offset 为 true 时，日期格式化子项缓存 UTC 偏移而不是每次查询时区
+		Formatter(const std::string& pattern = "[%d{%H:%M:%S}][%p][%f:%l]%m%n", bool cache_utc_offset = false)
+				: _pattern(pattern)
+				, _cache_utc_offset(cache_utc_offset) {
 			assert(ParsePattern());
 		}
 
+		virtual ~Formatter() {}
+
+		// 将日志追加到 out 中 (日志器的热路径使用此接口，复用 out 的容量)
+		virtual void Format(std::string& out, const LogMsg& msg);
+
 		// 将日志输出到指定的流中
-		void Format(std::ostream& oss, const LogMsg& msg);
+		virtual void Format(std::ostream& oss, const LogMsg& msg) {
+			std::string out;
+			Format(out, msg);
+			oss.write(out.data(), out.size());
+		}
 
 		// 将日志以返回值的形式进行返回
-		std::string Format(const LogMsg& msg) {
-			// 复用 Format(std::ostream& oss, const LogMsg& msg) 接口
-			std::stringstream oss;
-			Format(oss, msg);
-			return oss.str();
+		virtual std::string Format(const LogMsg& msg) {
+			// 复用 Format(std::string& out, const LogMsg& msg) 接口
+			std::string out;
+			Format(out, msg);
+			return out;
 		}
 
 	private:
@@ -178,8 +295,38 @@ namespace zch {
 
 	private:
 		std::string _pattern;                       // 格式化规则字符串
+		bool _cache_utc_offset;                     // 日期格式化子项是否缓存 UTC 偏移
 		std::vector<FormatItem::ptr> _items;        // 按顺序存储指定的格式化对象
 	};
+
+    // logfmt 格式化器：每条日志一行 key=value，便于日志采集端直接按键值解析
+    // time=... level=INFO logger=root tid=123 thread=main caller=main.cpp:12 msg="..." 字段...
+	class LogfmtFormatter : public Formatter {
+	public:
+		// time_fmt 为时间字段的格式 (同 %d 的子格式)
+		LogfmtFormatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%f%z", bool cache_utc_offset = false)
+						: Formatter("%m")
+						, _time(time_fmt, cache_utc_offset) {}
+
+		void Format(std::string& out, const LogMsg& msg) override;
+
+	private:
+		TimeFormatItem _time;
+	};
+
+    // JSON 格式化器：每条日志一行 JSON 对象 (JSON Lines)，结构化字段作为对象的成员
+    // {"time":"...","level":"INFO","logger":"root","tid":123,"thread":"main","file":"main.cpp","line":12,"msg":"...",字段...}
+	class JsonFormatter : public Formatter {
+	public:
+		JsonFormatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%f%z", bool cache_utc_offset = false)
+					: Formatter("%m")
+					, _time(time_fmt, cache_utc_offset) {}
+
+		void Format(std::string& out, const LogMsg& msg) override;
+
+	private:
+		TimeFormatItem _time;
+	};
 }
 
 #endif
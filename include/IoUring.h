@@ -0,0 +1,75 @@
+/**
+ * @file IoUring.h
+ * @brief io_uring 的最小封装：直接通过系统调用建立提交队列与完成队列，不依赖 liburing，
+ *        只提供落地方向需要的 writev 请求
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef IOURING_H__
+#define IOURING_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace zch {
+
+	// 只能由单个线程使用
+	class IoUring {
+	public:
+		// entries 为提交队列的长度(内核会向上取整为 2 的幂)
+		explicit IoUring(unsigned entries);
+
+		~IoUring();
+
+		// 内核是否支持 io_uring (建立失败时所有接口都不可用)
+		bool Available() const { return _ring_fd >= 0; }
+
+		// 在提交队列中放入一个 writev 请求，完成时通过 user_data 识别，队列已满时返回 false
+		bool PrepWritev(int fd, const struct iovec* iov, unsigned iovcnt, off_t offset, uint64_t user_data);
+
+		// 将放入的请求提交给内核，wait_nr 大于 0 时阻塞到至少有 wait_nr 个完成事件
+		bool Submit(unsigned wait_nr = 0);
+
+		// 撤回已经放入但尚未提交给内核的请求 (Submit 失败后调用，内核不会再执行这些请求)
+		void DropUnsubmitted();
+
+		// 取出一个完成事件，res 为对应系统调用的返回值(失败时为负的错误码)，没有时返回 false
+		bool PeekCompletion(uint64_t& user_data, int& res);
+
+	private:
+		IoUring(const IoUring&) = delete;
+		IoUring& operator=(const IoUring&) = delete;
+
+	private:
+		int _ring_fd;
+		// 尚未提交给内核的请求数
+		unsigned _to_submit;
+
+		// 提交队列
+		void* _sq_ptr;
+		size_t _sq_size;
+		unsigned* _sq_head;
+		unsigned* _sq_tail;
+		unsigned* _sq_mask;
+		unsigned* _sq_array;
+		unsigned _sq_entries;
+		struct io_uring_sqe* _sqes;
+		size_t _sqes_size;
+
+		// 完成队列 (内核支持时与提交队列共用一次映射)
+		void* _cq_ptr;
+		size_t _cq_size;
+		unsigned* _cq_head;
+		unsigned* _cq_tail;
+		unsigned* _cq_mask;
+		struct io_uring_cqe* _cqes;
+	};
+}
+
+#endif
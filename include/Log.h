@@ -12,25 +12,147 @@
 
 namespace zch {
 
-    // 1. 提供一个全局接口来得到指定的日志器对象
-	const zch::Logger::ptr& GetLogger(std::string name);
+    // 1. 提供一个全局接口来得到指定的日志器对象 (不加锁；返回的引用一直有效，可以缓存)
+	const zch::Logger::ptr& GetLogger(const std::string& name);
 
     // 2. 提供一个全局接口来得到默认日志器对象
 	const zch::Logger::ptr& DefaultLogger();
 
-    // 3. 使用宏函数简化用户的传参，自动填充行号和文件名
-    #define Debug(fmt, ...) Debug(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-    #define Info(fmt, ...) Info(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-    #define Warn(fmt, ...) Warn(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-    #define Error(fmt, ...) Error(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-    #define Fatal(fmt, ...) Fatal(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-
-    // 4.给用户使用的宏函数
-    #define DEBUG(fmt,...) zch::DefaultLogger()->Debug(fmt, ##__VA_ARGS__)
-    #define INFO(fmt,...) zch::DefaultLogger()->Info(fmt, ##__VA_ARGS__)
-    #define WARN(fmt,...) zch::DefaultLogger()->Warn(fmt, ##__VA_ARGS__)
-    #define ERROR(fmt,...) zch::DefaultLogger()->Error(fmt, ##__VA_ARGS__)
-    #define FATAL(fmt,...) zch::DefaultLogger()->Fatal(fmt, ##__VA_ARGS__)
+    // 3. 使用宏函数简化用户的传参，自动注册调用点(文件名、行号、等级、格式串)
+    #define Debug(fmt, ...) Debug(ZCH_CALL_SITE(zch::LogLevel::Level::DEBUG, fmt), fmt, ##__VA_ARGS__)
+    #define Info(fmt, ...) Info(ZCH_CALL_SITE(zch::LogLevel::Level::INFO, fmt), fmt, ##__VA_ARGS__)
+    #define Warn(fmt, ...) Warn(ZCH_CALL_SITE(zch::LogLevel::Level::WARN, fmt), fmt, ##__VA_ARGS__)
+    #define Error(fmt, ...) Error(ZCH_CALL_SITE(zch::LogLevel::Level::ERROR, fmt), fmt, ##__VA_ARGS__)
+    #define Fatal(fmt, ...) Fatal(ZCH_CALL_SITE(zch::LogLevel::Level::FATAL, fmt), fmt, ##__VA_ARGS__)
+
+    // 4. 编译期最低等级：低于 ZCH_ACTIVE_LEVEL 的 ZCH_LOG_* 宏(以及 DEBUG 等宏)展开为空语句，
+    //    调用与参数都不会出现在生成的代码中。如以 -DZCH_ACTIVE_LEVEL=ZCH_LEVEL_INFO 编译以去掉所有 DEBUG 日志
+    #define ZCH_LEVEL_DEBUG 1
+    #define ZCH_LEVEL_INFO 2
+    #define ZCH_LEVEL_WARN 3
+    #define ZCH_LEVEL_ERROR 4
+    #define ZCH_LEVEL_FATAL 5
+    #define ZCH_LEVEL_OFF 6
+
+    #ifndef ZCH_ACTIVE_LEVEL
+    #define ZCH_ACTIVE_LEVEL ZCH_LEVEL_DEBUG
+    #endif
+
+    // 5. 先判断日志器的运行期等级(一次原子读取)，通过后才求值参数并调用日志器，logger 只求值一次
+    #define ZCH_LOG_IF(logger, LEVEL, Method, fmt, ...) \
+        do { \
+            zch::Logger* zch_logger = (logger).get(); \
+            if (zch_logger->Enabled(zch::LogLevel::Level::LEVEL)) { \
+                zch_logger->Method(fmt, ##__VA_ARGS__); \
+            } \
+        } while (0)
+
+    // 惰性日志：fn 为返回 std::string 或 const char* 的可调用对象，通过等级判断后才调用
+    #define ZCH_LOG_LAZY_IF(logger, LEVEL, fn) \
+        do { \
+            zch::Logger* zch_logger = (logger).get(); \
+            if (zch_logger->Enabled(zch::LogLevel::Level::LEVEL)) { \
+                zch_logger->Lazy(zch::LogLevel::Level::LEVEL, ZCH_CALL_SITE(zch::LogLevel::Level::LEVEL, ""), fn); \
+            } \
+        } while (0)
+
+    // 采样日志：同一调用点每 n 条只保留一条 (第 1、n+1、2n+1 ... 条，调用点内的原子计数器)，
+    // 未保留的日志不求值参数，保留的日志附带 sample_rate=n
+    #define ZCH_LOG_EVERY_N_IF(logger, LEVEL, n, fmt, ...) \
+        do { \
+            static std::atomic<uint64_t> zch_sample_count(0); \
+            zch::Logger* zch_logger = (logger).get(); \
+            const uint64_t zch_sample_n = (n); \
+            if (zch_logger->Enabled(zch::LogLevel::Level::LEVEL) \
+                && (zch_sample_n <= 1 || zch_sample_count.fetch_add(1, std::memory_order_relaxed) % zch_sample_n == 0)) { \
+                zch_logger->Sampled(zch::LogLevel::Level::LEVEL, ZCH_CALL_SITE(zch::LogLevel::Level::LEVEL, fmt), \
+                                    zch_sample_n > 1 ? static_cast<double>(zch_sample_n) : 1.0, fmt, ##__VA_ARGS__); \
+            } \
+        } while (0)
+
+    // 采样日志：以概率 p 保留 (线程局部的随机数发生器)，保留的日志附带 sample_rate=1/p
+    #define ZCH_LOG_SAMPLED_IF(logger, LEVEL, p, fmt, ...) \
+        do { \
+            zch::Logger* zch_logger = (logger).get(); \
+            const double zch_sample_p = (p); \
+            if (zch_logger->Enabled(zch::LogLevel::Level::LEVEL) && zch::Sampler::Bernoulli(zch_sample_p)) { \
+                zch_logger->Sampled(zch::LogLevel::Level::LEVEL, ZCH_CALL_SITE(zch::LogLevel::Level::LEVEL, fmt), \
+                                    zch_sample_p < 1.0 ? 1.0 / zch_sample_p : 1.0, fmt, ##__VA_ARGS__); \
+            } \
+        } while (0)
+
+    #if ZCH_ACTIVE_LEVEL <= ZCH_LEVEL_DEBUG
+    #define ZCH_LOG_DEBUG(logger, fmt, ...) ZCH_LOG_IF(logger, DEBUG, Debug, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_DEBUG_LAZY(logger, fn) ZCH_LOG_LAZY_IF(logger, DEBUG, fn)
+    #define ZCH_LOG_DEBUG_EVERY_N(logger, n, fmt, ...) ZCH_LOG_EVERY_N_IF(logger, DEBUG, n, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_DEBUG_SAMPLED(logger, p, fmt, ...) ZCH_LOG_SAMPLED_IF(logger, DEBUG, p, fmt, ##__VA_ARGS__)
+    #else
+    #define ZCH_LOG_DEBUG(logger, fmt, ...) do {} while (0)
+    #define ZCH_LOG_DEBUG_LAZY(logger, fn) do {} while (0)
+    #define ZCH_LOG_DEBUG_EVERY_N(logger, n, fmt, ...) do {} while (0)
+    #define ZCH_LOG_DEBUG_SAMPLED(logger, p, fmt, ...) do {} while (0)
+    #endif
+
+    #if ZCH_ACTIVE_LEVEL <= ZCH_LEVEL_INFO
+    #define ZCH_LOG_INFO(logger, fmt, ...) ZCH_LOG_IF(logger, INFO, Info, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_INFO_LAZY(logger, fn) ZCH_LOG_LAZY_IF(logger, INFO, fn)
+    #define ZCH_LOG_INFO_EVERY_N(logger, n, fmt, ...) ZCH_LOG_EVERY_N_IF(logger, INFO, n, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_INFO_SAMPLED(logger, p, fmt, ...) ZCH_LOG_SAMPLED_IF(logger, INFO, p, fmt, ##__VA_ARGS__)
+    #else
+    #define ZCH_LOG_INFO(logger, fmt, ...) do {} while (0)
+    #define ZCH_LOG_INFO_LAZY(logger, fn) do {} while (0)
+    #define ZCH_LOG_INFO_EVERY_N(logger, n, fmt, ...) do {} while (0)
+    #define ZCH_LOG_INFO_SAMPLED(logger, p, fmt, ...) do {} while (0)
+    #endif
+
+    #if ZCH_ACTIVE_LEVEL <= ZCH_LEVEL_WARN
+    #define ZCH_LOG_WARN(logger, fmt, ...) ZCH_LOG_IF(logger, WARN, Warn, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_WARN_LAZY(logger, fn) ZCH_LOG_LAZY_IF(logger, WARN, fn)
+    #define ZCH_LOG_WARN_EVERY_N(logger, n, fmt, ...) ZCH_LOG_EVERY_N_IF(logger, WARN, n, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_WARN_SAMPLED(logger, p, fmt, ...) ZCH_LOG_SAMPLED_IF(logger, WARN, p, fmt, ##__VA_ARGS__)
+    #else
+    #define ZCH_LOG_WARN(logger, fmt, ...) do {} while (0)
+    #define ZCH_LOG_WARN_LAZY(logger, fn) do {} while (0)
+    #define ZCH_LOG_WARN_EVERY_N(logger, n, fmt, ...) do {} while (0)
+    #define ZCH_LOG_WARN_SAMPLED(logger, p, fmt, ...) do {} while (0)
+    #endif
+
+    #if ZCH_ACTIVE_LEVEL <= ZCH_LEVEL_ERROR
+    #define ZCH_LOG_ERROR(logger, fmt, ...) ZCH_LOG_IF(logger, ERROR, Error, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_ERROR_LAZY(logger, fn) ZCH_LOG_LAZY_IF(logger, ERROR, fn)
+    #define ZCH_LOG_ERROR_EVERY_N(logger, n, fmt, ...) ZCH_LOG_EVERY_N_IF(logger, ERROR, n, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_ERROR_SAMPLED(logger, p, fmt, ...) ZCH_LOG_SAMPLED_IF(logger, ERROR, p, fmt, ##__VA_ARGS__)
+    #else
+    #define ZCH_LOG_ERROR(logger, fmt, ...) do {} while (0)
+    #define ZCH_LOG_ERROR_LAZY(logger, fn) do {} while (0)
+    #define ZCH_LOG_ERROR_EVERY_N(logger, n, fmt, ...) do {} while (0)
+    #define ZCH_LOG_ERROR_SAMPLED(logger, p, fmt, ...) do {} while (0)
+    #endif
+
+    #if ZCH_ACTIVE_LEVEL <= ZCH_LEVEL_FATAL
+    #define ZCH_LOG_FATAL(logger, fmt, ...) ZCH_LOG_IF(logger, FATAL, Fatal, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_FATAL_LAZY(logger, fn) ZCH_LOG_LAZY_IF(logger, FATAL, fn)
+    #define ZCH_LOG_FATAL_EVERY_N(logger, n, fmt, ...) ZCH_LOG_EVERY_N_IF(logger, FATAL, n, fmt, ##__VA_ARGS__)
+    #define ZCH_LOG_FATAL_SAMPLED(logger, p, fmt, ...) ZCH_LOG_SAMPLED_IF(logger, FATAL, p, fmt, ##__VA_ARGS__)
+    #else
+    #define ZCH_LOG_FATAL(logger, fmt, ...) do {} while (0)
+    #define ZCH_LOG_FATAL_LAZY(logger, fn) do {} while (0)
+    #define ZCH_LOG_FATAL_EVERY_N(logger, n, fmt, ...) do {} while (0)
+    #define ZCH_LOG_FATAL_SAMPLED(logger, p, fmt, ...) do {} while (0)
+    #endif
+
+    // 6.给用户使用的宏函数 (使用默认日志器)
+    #define DEBUG(fmt,...) ZCH_LOG_DEBUG(zch::DefaultLogger(), fmt, ##__VA_ARGS__)
+    #define INFO(fmt,...) ZCH_LOG_INFO(zch::DefaultLogger(), fmt, ##__VA_ARGS__)
+    #define WARN(fmt,...) ZCH_LOG_WARN(zch::DefaultLogger(), fmt, ##__VA_ARGS__)
+    #define ERROR(fmt,...) ZCH_LOG_ERROR(zch::DefaultLogger(), fmt, ##__VA_ARGS__)
+    #define FATAL(fmt,...) ZCH_LOG_FATAL(zch::DefaultLogger(), fmt, ##__VA_ARGS__)
+
+    // 默认日志器的采样日志，如 DEBUG_EVERY_N(1000, "recv %d bytes", n)、INFO_SAMPLED(0.01, "hit %s", key)
+    #define DEBUG_EVERY_N(n, fmt, ...) ZCH_LOG_DEBUG_EVERY_N(zch::DefaultLogger(), n, fmt, ##__VA_ARGS__)
+    #define INFO_EVERY_N(n, fmt, ...) ZCH_LOG_INFO_EVERY_N(zch::DefaultLogger(), n, fmt, ##__VA_ARGS__)
+    #define DEBUG_SAMPLED(p, fmt, ...) ZCH_LOG_DEBUG_SAMPLED(zch::DefaultLogger(), p, fmt, ##__VA_ARGS__)
+    #define INFO_SAMPLED(p, fmt, ...) ZCH_LOG_INFO_SAMPLED(zch::DefaultLogger(), p, fmt, ##__VA_ARGS__)
 }
 
 #endif
@@ -26,6 +26,11 @@ namespace zch {
 		};
 
         static std::string ToString(LogLevel::Level level) {
+			return ToCString(level);
+		}
+
+        // 返回等级名称的字符串常量，避免构造 std::string
+        static const char* ToCString(LogLevel::Level level) {
 			switch (level) {
                 case LogLevel::Level::DEBUG: 
                     return "DEBUG";
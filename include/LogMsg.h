@@ -9,33 +9,84 @@
 #define LOGMSG_H__
 
 #include <ctime>
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <thread>
 
 #include "LogLevel.hpp"
+#include "CallSite.h"
+#include "ThreadInfo.h"
 #include "util.hpp"
 
 namespace zch {
 
+    // 结构化日志的字段：键为字符串常量，值按类型保存，格式化时直接写入输出中，不生成临时字符串。
+    // 字符串值只保存指针，字段只在日志调用期间有效
+	struct Field {
+		enum class Type : uint8_t {
+			INT,
+			UINT,
+			DOUBLE,
+			BOOL,
+			STRING
+		};
+
+		Field(const char* key, int v) : _key(key), _type(Type::INT) { _int = v; }
+		Field(const char* key, long v) : _key(key), _type(Type::INT) { _int = v; }
+		Field(const char* key, long long v) : _key(key), _type(Type::INT) { _int = v; }
+		Field(const char* key, unsigned v) : _key(key), _type(Type::UINT) { _uint = v; }
+		Field(const char* key, unsigned long v) : _key(key), _type(Type::UINT) { _uint = v; }
+		Field(const char* key, unsigned long long v) : _key(key), _type(Type::UINT) { _uint = v; }
+		Field(const char* key, double v) : _key(key), _type(Type::DOUBLE) { _double = v; }
+		Field(const char* key, bool v) : _key(key), _type(Type::BOOL) { _bool = v; }
+		Field(const char* key, const char* v) : _key(key), _type(Type::STRING) {
+			_str._data = v != nullptr ? v : "(null)";
+			_str._len = strlen(_str._data);
+		}
+		Field(const char* key, const std::string& v) : _key(key), _type(Type::STRING) {
+			_str._data = v.data();
+			_str._len = v.size();
+		}
+
+		const char* _key;
+		Type _type;
+		union {
+			long long _int;
+			unsigned long long _uint;
+			double _double;
+			bool _bool;
+			struct {
+				const char* _data;
+				size_t _len;
+			} _str;
+		};
+	};
+
     struct LogMsg {
-		time_t _ctime;				// 时间戳
-		LogLevel::Level _level;		// 日志等级
-		std::string _logger;		// 日志器名称
-		std::thread::id _tid;		// 线程id
-		std::string _file;			// 源码文件名
-		size_t _line;				// 源码行号
+		time_t _ctime;				// 时间戳(秒)
+		long _nsec;					// 时间戳(秒内的纳秒数)
+		const CallSite* _site;		// 调用点(源码文件名、行号、日志等级等静态元数据)
+		const std::string* _logger;	// 日志器名称(指向日志器自身保存的名称，不进行拷贝)
+		uint32_t _tid;				// 内核线程id
+		const char* _tname;			// 线程名称(指向 ThreadInfo 中保存的名称，不进行拷贝)
 		std::string _payload;		// 有效载荷
-		LogMsg() {}
+		const Field* _fields;		// 结构化字段(只在日志调用期间有效)
+		size_t _nfields;			// 结构化字段的个数
+		LogMsg() : _ctime(0), _nsec(0), _site(nullptr), _logger(nullptr), _tid(0), _tname(""), _fields(nullptr), _nfields(0) {}
 
-		LogMsg(LogLevel::Level level, const std::string logger, const std::string file,
-			size_t line, const std::string payload)
+		LogMsg(const CallSite* site, const std::string* logger, const std::string& payload)
 			: _ctime(Date::Now())
-			, _level(level)
+			, _nsec(0)
+			, _site(site)
 			, _logger(logger)
-			, _tid(std::this_thread::get_id())
-			, _file(file)
-			, _line(line)
-			, _payload(payload) {}
+			, _tid(ThreadInfo::Tid())
+			, _tname(ThreadInfo::Name())
+			, _payload(payload)
+			, _fields(nullptr)
+			, _nfields(0) {}
+
+		// 日志等级
+		LogLevel::Level Level() const { return _site->_level; }
 	};
 }
 
@@ -3,7 +3,10 @@
  * @brief 实现日志的输出方式，并支持输出方式的扩展
  *          - 标准输出
  *          - 指定文件
- *          - 滚动文件
+ *          - 滚动文件 (按大小；按大小与时间，并限制保留的文件并压缩；可选稀疏时间索引)
+ *          - 文件描述符 (不经过 C++ 流，可选 O_DIRECT)
+ *          - io_uring 异步写入文件
+ *          - 内存映射文件
  * @author zch
  * @date 2025-11-02
  */
@@ -16,9 +19,20 @@
 #include <sstream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <ctime>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/uio.h>
 //#include <json/json.h>
 
 #include "util.hpp"
+#include "TimeIndex.h"
 //#include "../include/MySQLConn.h"
 
 namespace zch {
@@ -29,6 +43,15 @@ namespace zch {
 		using ptr = std::shared_ptr<LogSink>;
 		// 日志输出接口, data 为日志的真实地址, len 为日志的长度
 		virtual void log(const char* data, size_t len) = 0;
+
+		// 进程崩溃时由信号处理函数调用，把数据直接写入目标：实现中只能使用异步信号安全的操作
+		// (write 等系统调用与 memcpy)，不加锁也不分配内存。默认不输出，这类落地方向的数据只保存在崩溃环中
+		virtual void EmergencyWrite(const char* data, size_t len) {}
+
+		// 将暂存在本对象中的数据写入内核。异步日志器的异步线程处理完所有待处理的数据后调用，
+		// 保证暂存的数据不会在日志的间歇期无限期地停留在进程内。默认没有暂存的数据
+		virtual void Flush() {}
+
 		virtual ~LogSink() {};
 	};
 
@@ -38,6 +61,12 @@ namespace zch {
 		void log(const char* data, size_t len) override {
 			std::cout.write(data, len);
 		}
+
+		void EmergencyWrite(const char* data, size_t len) override;
+
+		void Flush() override {
+			std::cout.flush();
+		}
 	};
 
     // 指定文件
@@ -50,34 +79,376 @@ namespace zch {
 			_ofs.write(data, len);
 		}
 
+		void Flush() override {
+			_ofs.flush();
+		}
+
 	private:
 		std::string _pathname;
 		std::ofstream _ofs;
 	};
 
+    // 基于文件描述符的文件输出，不经过 std::ofstream 的流缓冲区
+    // - 普通模式：以 O_APPEND 打开文件。batch_size 为 0 时每次 log 都直接写入内核；
+    //   大于 0 时较小的数据先暂存，暂存的数据与放不下的数据通过一次 writev 写入，
+    //   大块数据本身不经过拷贝。暂存的数据在暂存区写满、Flush 或者析构时写入：异步日志器在异步线程空闲时
+    //   调用 Flush；同步日志器没有定时写入，日志的间歇期中暂存的数据可见的延迟没有上限
+    // - O_DIRECT 模式：数据不进入页缓存。数据先拷贝到按块对齐的暂存区，每次 log 结束时
+    //   (或者暂存数据达到 batch_size 时) 写入所有数据，末尾不满一块的部分补齐后写入，
+    //   再截断文件到真实长度；未满的块保留在暂存区中，下次写入时覆盖该块。
+    //   写入失败时只推进已经落地的完整块，其余数据留在暂存区中重试。
+    //   O_DIRECT 模式下需要独占该文件，文件系统不支持时退回普通模式
+	class FdSink : public LogSink {
+	public:
+		FdSink(const std::string& pathname, bool direct = false, size_t batch_size = 0);
+
+		~FdSink();
+
+		void log(const char* data, size_t len) override;
+
+		// 直接写入文件描述符，不经过暂存区 (暂存区中尚未写入的数据只保存在崩溃环中)
+		void EmergencyWrite(const char* data, size_t len) override;
+
+		// 将暂存的数据写入内核
+		void Flush() override;
+
+	private:
+		// 写入全部数据，处理被信号中断以及部分写入的情况
+		bool WriteAll(struct iovec* iov, int iovcnt);
+
+		// O_DIRECT 模式下的写入
+		void LogDirect(const char* data, size_t len);
+
+		// O_DIRECT 模式下将暂存区中的数据写入文件
+		bool FlushDirect();
+
+	private:
+		std::string _pathname;
+		int _fd;
+		// 是否为 O_DIRECT 模式
+		bool _direct;
+		// 暂存数据达到该大小后写入
+		size_t _batch_size;
+		// 暂存区 (O_DIRECT 模式下按块对齐)
+		char* _stage;
+		// 暂存区的容量
+		size_t _stage_cap;
+		// 暂存区中数据的长度
+		size_t _staged;
+		// O_DIRECT 模式下暂存区中已经写入文件的长度
+		size_t _written;
+		// O_DIRECT 模式下暂存区起始位置对应的文件偏移量(按块对齐)
+		off_t _offset;
+	};
+
+    class IoUring;
+
+    // 基于 io_uring 的文件输出：log 只把数据拷贝到空闲的写缓冲区并提交写请求，
+    // 不等待磁盘完成；最多 depth 个写缓冲区同时处于写入中，写请求完成后缓冲区才被复用，
+    // 所有缓冲区都在写入中时才会等待。每次 log 至少提交一个写请求，适合异步日志器的批量写入。
+    // 运行时不支持 io_uring 时退回 FdSink 的 write 路径。写入位置由本对象维护，需要独占该文件
+	class UringSink : public LogSink {
+	public:
+		UringSink(const std::string& pathname, size_t depth = 4, size_t buffer_size = 1024 * 1024);
+
+		// 等待所有写请求完成
+		~UringSink();
+
+		void log(const char* data, size_t len) override;
+
+		// 通过 pwrite 同步写入到当前写入位置之后
+		void EmergencyWrite(const char* data, size_t len) override;
+
+		// 是否在使用 io_uring (否则为退回的 write 路径)
+		bool UsingUring() const { return _ring.get() != nullptr; }
+
+	private:
+		// 写缓冲区
+		struct Slot {
+			std::vector<char> _buf;
+			struct iovec _iov;
+			// 写入的文件偏移量
+			off_t _offset;
+			// 是否处于写入中
+			bool _busy;
+		};
+
+		// 取得一个空闲的写缓冲区，没有时等待写请求完成，等待超时返回 nullptr
+		Slot* AcquireSlot();
+
+		// 处理已经完成的写请求，回收其缓冲区，返回回收的个数
+		size_t Reap();
+
+		// 等待至少一个写请求完成并回收其缓冲区。io_uring_enter 失败时改为轮询完成队列，
+		// 最多等待约 1s，超时返回 false
+		bool WaitReap();
+
+	private:
+		std::string _pathname;
+		int _fd;
+		// 下一次写入的文件偏移量
+		off_t _offset;
+		std::vector<Slot> _slots;
+		std::unique_ptr<IoUring> _ring;
+		// 不支持 io_uring 时使用的落地方向
+		std::unique_ptr<LogSink> _fallback;
+	};
+
+    // 基于内存映射的文件输出：文件按段预先分配(fallocate)并映射，log 直接把数据拷贝到映射区，
+    // 不需要写系统调用；数据拷贝完成后即位于页缓存中，进程崩溃也不会丢失。
+    // 当前段写过一半时由辅助线程预先分配、映射并读入下一段，写满后直接切换，旧段也交给辅助线程解除映射，
+    // 写日志的线程上不做分配与缺页处理；脏页累计到一定数量时通过 msync(MS_ASYNC) 通知内核回写。
+    // 已分配的段之后另有一页记录真实数据的末尾，每次写入后更新；关闭时截断文件末尾未使用的部分(包括该页)。
+    // 进程崩溃时文件末尾会留下预分配的部分，重新打开时从记录的位置继续写入，数据本身可以包含 '\0'。
+    // 写入位置由本对象维护，需要独占该文件
+	class MmapSink : public LogSink {
+	public:
+		MmapSink(const std::string& pathname, size_t segment_size = 64 * 1024 * 1024);
+
+		// 等待辅助线程退出，截断文件末尾未使用的部分
+		~MmapSink();
+
+		void log(const char* data, size_t len) override;
+
+		// 只写入当前段剩余的空间 (映射新的段不是异步信号安全的操作)，超出的部分被截断
+		void EmergencyWrite(const char* data, size_t len) override;
+
+	private:
+		// 分配并映射从 base 开始的一段文件以及其后的记录页，记录页中写入 end 与上一个记录页的位置 prev，
+		// 失败时返回 nullptr
+		char* MapSegment(off_t base, uint64_t end, uint64_t prev, char*& trailer);
+
+		// 当前段已经写满，切换到辅助线程准备好的下一段
+		void NextSegment();
+
+		// 通知内核回写当前段中新写入的数据
+		void SyncAsync();
+
+		// 在文件末尾的记录页中更新真实数据的末尾
+		void UpdateTrailer();
+
+		// 持有锁时调用：改用辅助线程准备好的记录页
+		void AdoptTrailer();
+
+		// 辅助线程的入口函数
+		void HelperEntry();
+
+		// 分步读入一段映射区
+		void Prefault(char* seg);
+
+		// 读取 offset 处的记录页，不是记录页时返回 false
+		bool ReadTrailer(off_t offset, uint64_t& end, uint64_t& prev);
+
+		// 找到文件中真实数据的末尾 (跳过上次崩溃留下的预分配部分)
+		off_t DataEnd();
+
+	private:
+		std::string _pathname;
+		int _fd;
+		// 每段的大小(按页对齐)
+		size_t _segment_size;
+		// 页大小
+		size_t _page;
+		// 当前段的映射区及其在文件中的起始位置
+		char* _cur;
+		off_t _cur_base;
+		// 当前段中下一次写入的位置
+		size_t _pos;
+		// 当前段中已经通知内核回写的位置
+		size_t _synced;
+		// 最后一个已分配的段之后记录真实数据末尾的一页，及其在文件中的位置
+		char* _trailer;
+		off_t _trailer_off;
+		// 以下成员用于与辅助线程交互
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		bool _want_next;
+		// 辅助线程映射下一段失败
+		bool _failed;
+		bool _stop;
+		// 预先映射的下一段及其之后的记录页
+		char* _next;
+		char* _next_trailer;
+		// 等待解除映射的旧段
+		char* _retired;
+		// 新的记录页已经准备好，写日志的线程据此尽快改用它
+		std::atomic<bool> _trailer_ready;
+		std::thread _td;
+	};
+
     // 滚动文件(这里按照文件大小进行滚动)
+    // 当前文件写过一半时，由辅助线程提前创建、预分配并打开下一个文件；写满后直接切换，
+    // 旧文件也交给辅助线程关闭，写日志的线程上不做文件名生成与打开/关闭
 	class RollBySizeSink : public LogSink {
 	public:
-		// 创建文件并打开
-		RollBySizeSink(const std::string& basename, size_t max_size);
+        // 滚动的统计信息，耗时单位为纳秒
+        struct RollStats {
+            // 滚动次数
+            uint64_t _rolls;
+            // 滚动时下一个文件尚未准备好、需要等待的次数
+            uint64_t _stalls;
+            // 最近一次、最长以及累计的滚动耗时
+            uint64_t _last_ns;
+            uint64_t _max_ns;
+            uint64_t _total_ns;
+        };
+
+		// 创建文件并打开，index_interval 大于 0 时每写入 index_interval 字节在 .idx 文件中记录一次时间索引
+		RollBySizeSink(const std::string& basename, size_t max_size, size_t index_interval = 0);
+
+		// 等待辅助线程关闭所有文件，删除预先创建但没有使用的文件
+		~RollBySizeSink();
 
 		void log(const char* data, size_t len) override;
 
+		void Flush() override;
+
+		RollStats Stats() const;
+
 	private:
 		// 得到要生成的日志文件的名称
 		// 通过基础文件名 + 时间组成 + 计数器生成真正的文件名
 		std::string GetFileName();
 
+		// 打开的日志文件及其时间索引
+		struct OpenedFile {
+			std::string _name;
+			std::ofstream _ofs;
+			std::unique_ptr<TimeIndex> _index;
+		};
+
+		// 创建、预分配并打开一个新文件
+		std::unique_ptr<OpenedFile> OpenFile();
+
+		// 切换到预先打开的文件
+		void Roll();
+
+		// 辅助线程的入口函数
+		void HelperEntry();
+
 	private:
         // 基础文件名
 		std::string _basename;
 		// 文件大小限制
 		size_t _max_size;
+		// 时间索引的间隔(0 表示不记录)
+		size_t _index_interval;
 		// 当前文件的大小
 		size_t _cur_size;
-		std::ofstream _ofs;
+		std::unique_ptr<OpenedFile> _file;
 		// 文件名称计数器(防止一秒之内创建多个文件时，使用同一个名称)
 		size_t _name_cout;
+		// 以下成员用于与辅助线程交互
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		// 是否需要准备下一个文件
+		bool _want_next;
+		// 预先打开的下一个文件
+		std::unique_ptr<OpenedFile> _next;
+		// 等待关闭的旧文件
+		std::vector<std::unique_ptr<OpenedFile>> _retired;
+		bool _stop;
+		// 滚动的统计信息
+		std::atomic<uint64_t> _rolls;
+		std::atomic<uint64_t> _stalls;
+		std::atomic<uint64_t> _last_ns;
+		std::atomic<uint64_t> _max_ns;
+		std::atomic<uint64_t> _total_ns;
+		std::thread _td;
+	};
+
+    // 按时间滚动的周期
+    enum class RollPeriod {
+        // 不按时间滚动
+        NONE,
+        // 每个整点
+        HOURLY,
+        // 每天零点
+        DAILY
+    };
+
+    // 滚动文件(按照文件大小以及时间边界进行滚动)
+    // 文件名为 基础文件名-年月日_时分秒-序号.log，各字段补 0 对齐，按名称排序即按时间排序。
+    // 被关闭的文件交给低优先级的辅助线程压缩为 .gz，并按照文件数与总字节数删除最早的文件，
+    // 写日志的线程不做压缩与目录扫描
+	class RollingFileSink : public LogSink {
+	public:
+		// max_size 为单个文件的大小上限(0 表示不按大小滚动)，period 为按时间滚动的周期，
+		// max_files、max_bytes 为保留的文件数与总字节数上限(包括正在写入的文件，0 表示不限制)，
+		// compress 为是否压缩被关闭的文件，index_interval 大于 0 时记录时间索引(同 RollBySizeSink)
+		RollingFileSink(const std::string& basename
+						, size_t max_size
+						, RollPeriod period = RollPeriod::DAILY
+						, size_t max_files = 0
+						, size_t max_bytes = 0
+						, bool compress = true
+						, size_t index_interval = 0);
+
+		// 关闭当前文件，等待辅助线程处理完已经关闭的文件
+		~RollingFileSink();
+
+		void log(const char* data, size_t len) override;
+
+		// 写入当前文件，不进行滚动
+		void EmergencyWrite(const char* data, size_t len) override;
+
+	private:
+		// 关闭当前文件(交给辅助线程)，打开新的文件
+		void Roll(time_t now);
+
+		// 得到要生成的日志文件的名称
+		std::string GetFileName(time_t now);
+
+		// now 之后的下一个时间边界
+		time_t NextBoundary(time_t now);
+
+		// 辅助线程的入口函数
+		void HelperEntry();
+
+		// 将文件压缩为 .gz 并删除原文件
+		void Compress(const std::string& path);
+
+		// 按照保留数量与总字节数删除最早的文件
+		void EnforceRetention();
+
+		// 目录中属于本日志的文件(含压缩后的文件)，按名称排序
+		std::vector<std::pair<std::string, off_t>> ListFiles();
+
+	private:
+        // 基础文件名
+		std::string _basename;
+		// 文件大小限制
+		size_t _max_size;
+		// 按时间滚动的周期
+		RollPeriod _period;
+		// 保留的文件数与总字节数上限
+		size_t _max_files;
+		size_t _max_bytes;
+		// 是否压缩被关闭的文件
+		bool _compress;
+		// 时间索引的间隔(0 表示不记录)
+		size_t _index_interval;
+		// 当前文件及其时间索引
+		std::unique_ptr<FdSink> _file;
+		std::unique_ptr<TimeIndex> _index;
+		// 当前文件的名称
+		std::string _cur_path;
+		// 本对象打开的第一个文件的名称(构造后不再修改)，名称排在它之前的才是上次运行遗留的文件
+		std::string _first_path;
+		// 当前文件的大小
+		size_t _cur_size;
+		// 下一个时间边界
+		time_t _next_roll;
+		// 上一个文件名中的时间，以及同一秒内的序号
+		time_t _last_name_time;
+		size_t _name_count;
+		// 以下成员用于与辅助线程交互
+		std::mutex _mtx;
+		std::condition_variable _cond;
+		// 已经关闭、等待辅助线程处理的文件
+		std::deque<std::string> _closed;
+		bool _stop;
+		std::thread _td;
 	};
 
     // // MySQL 服务器中
@@ -9,64 +9,252 @@
 #define LOGGER_H__
 
 #include <vector>
-#include <unordered_map>
 #include <mutex>
 #include <atomic>
 #include <cstdarg>
+#include <initializer_list>
 
 #include "LogLevel.hpp"
 #include "Formatter.h"
+#include "StaticFormatter.hpp"
 #include "LogSink.h"
+#include "BinaryLog.h"
 #include "AsynLopper.h"
+#include "CallSite.h"
+#include "Clock.h"
+#include "Dedup.h"
+#include "Sampling.h"
+#include "Crash.h"
+
+// 为每个等级生成 1~6 个字段以及任意个字段(初始化列表)的结构化日志接口
+#define ZCH_LOGGER_FIELDS(Name, LEVEL) \
+        void Name(const CallSite* site, const char* msg, std::initializer_list<Field> fields) { \
+            double rate = 0; \
+            if (Enabled(LogLevel::Level::LEVEL) && !Suppressed(site) && Sample(LogLevel::Level::LEVEL, site, rate)) { \
+                LogSampledFields(LogLevel::Level::LEVEL, site, msg, fields.begin(), fields.size(), rate); \
+            } \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1) { \
+            Name(site, msg, std::initializer_list<Field>{ f1 }); \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1, const Field& f2) { \
+            Name(site, msg, std::initializer_list<Field>{ f1, f2 }); \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1, const Field& f2, const Field& f3) { \
+            Name(site, msg, std::initializer_list<Field>{ f1, f2, f3 }); \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1, const Field& f2, const Field& f3, \
+                  const Field& f4) { \
+            Name(site, msg, std::initializer_list<Field>{ f1, f2, f3, f4 }); \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1, const Field& f2, const Field& f3, \
+                  const Field& f4, const Field& f5) { \
+            Name(site, msg, std::initializer_list<Field>{ f1, f2, f3, f4, f5 }); \
+        } \
+        void Name(const CallSite* site, const char* msg, const Field& f1, const Field& f2, const Field& f3, \
+                  const Field& f4, const Field& f5, const Field& f6) { \
+            Name(site, msg, std::initializer_list<Field>{ f1, f2, f3, f4, f5, f6 }); \
+        }
 
 namespace zch {
 
+    // 单独配置的落地方向：格式化器为空时使用日志器的格式化器，低于 level 的日志不会输出到该落地方向
+    struct SinkConfig {
+        LogSink::ptr _sink;
+        Formatter::ptr _formatter;
+        LogLevel::Level _level;
+    };
+
     class Logger {
     public:
         using ptr = std::shared_ptr<Logger>;
+        // sinks 使用日志器的格式化器与限制等级，configs 中的落地方向可以单独指定格式化器与最低等级
         Logger(const std::string logger
                 , zch::LogLevel::Level level
                 , zch::Formatter::ptr formatter
-                , std::vector<zch::LogSink::ptr> sinks)
+                , std::vector<zch::LogSink::ptr> sinks
+                , ClockType clock = ClockType::REALTIME_COARSE
+                , const std::vector<SinkConfig>& configs = std::vector<SinkConfig>()
+                , std::chrono::milliseconds dedup_window = std::chrono::milliseconds::zero()
+                , const Sampler::ptr& sampler = nullptr)
 			    : _logger(logger)
                 , _limit_level(level)
                 , _formatter(formatter)
-                , _sinks(sinks) {}
+                , _sinks(sinks)
+                , _clock(clock)
+                , _sink_floor(LogLevel::Level::UNKONWN)
+                , _routed(false)
+                , _sampler(sampler) {
+            InitRoutes(configs);
+            if (dedup_window > std::chrono::milliseconds::zero()) {
+                _dedup.reset(new Deduper(dedup_window, [this](const CallSite* site, uint64_t repeated, uint64_t elapsed_ms) {
+                    ReportRepeated(site, repeated, elapsed_ms);
+                }));
+            }
+            // 在创建日志器时完成时间戳计数器的首次校准(约 10ms)并启动校准线程，而不是在第一条日志中
+            if (_clock == ClockType::TSC) {
+                TscClock::GetInstance();
+            }
+        }
 
         // 以 Debug 等级进行输出
-		void Debug(const std::string& file, size_t line, const char* fmt, ...);
+		void Debug(const CallSite* site, const char* fmt, ...);
         
         // 以 Info 等级进行输出
-		void Info(const std::string& file, size_t line, const char* fmt, ...);
+		void Info(const CallSite* site, const char* fmt, ...);
 
         // 以 Warn 等级进行输出
-		void Warn(const std::string& file, size_t line, const char* fmt, ...);
+		void Warn(const CallSite* site, const char* fmt, ...);
 
 		// 以 Error 等级进行输出
-		void Error(const std::string& file, size_t line, const char* fmt, ...);
+		void Error(const CallSite* site, const char* fmt, ...);
 
 		// 以 Fatal 等级进行输出
-		void Fatal(const std::string& file, size_t line, const char* fmt, ...);
+		void Fatal(const CallSite* site, const char* fmt, ...);
+
+        // 调用者已经完成采样判断的日志：附带 sample_rate 字段(每条日志代表的条数)输出，
+        // 不再经过日志器的采样器与重复日志合并 (供 ZCH_LOG_*_EVERY_N 与 ZCH_LOG_*_SAMPLED 宏使用)
+        void Sampled(LogLevel::Level level, const CallSite* site, double rate, const char* fmt, ...);
+
+        // 结构化日志：msg 为不经过 printf 格式化的消息，其后为任意个字段，如
+        // logger->Info("request done", {"user_id", id}, {"latency_us", us});
+        // 字段超过 6 个时使用 logger->Info("request done", {{"a", 1}, {"b", 2}, ...});
+        ZCH_LOGGER_FIELDS(Debug, DEBUG)
+        ZCH_LOGGER_FIELDS(Info, INFO)
+        ZCH_LOGGER_FIELDS(Warn, WARN)
+        ZCH_LOGGER_FIELDS(Error, ERROR)
+        ZCH_LOGGER_FIELDS(Fatal, FATAL)
+
+        // 惰性日志：通过等级判断后才调用 fn 形成有效载荷 (fn 返回 std::string 或 const char*，不经过 printf 格式化)
+        template<class Fn>
+        void Lazy(LogLevel::Level level, const CallSite* site, Fn&& fn) {
+            double rate = 0;
+            if (!Enabled(level) || Suppressed(site) || !Sample(level, site, rate)) {
+                return;
+            }
+            const std::string payload = fn();
+            LogSampledFields(level, site, payload.c_str(), nullptr, 0, rate);
+        }
+
+        // 指定等级的日志是否会被输出 (只读取一次原子变量，日志宏在求值参数之前调用)
+        bool Enabled(LogLevel::Level level) const {
+            return level >= _limit_level.load(std::memory_order_relaxed);
+        }
+
+        // 运行期修改限制等级，不加锁，随后的日志调用立即生效；
+        // 落地方向单独指定了等级时，低于所有落地方向等级的日志仍然被过滤
+        void SetLevel(LogLevel::Level level);
+
+        // 当前生效的限制等级
+        LogLevel::Level GetLevel() const {
+            return _limit_level.load(std::memory_order_relaxed);
+        }
+
+        // 开启重复日志合并时，输出所有调用点尚未汇总的合并条数 (日志器析构时自动调用)
+        void FlushRepeated();
 
         const std::string& GetLoggerName() {
             return _logger;
         }
 
+        virtual ~Logger() {}
+
     protected:
+        // 开启重复日志合并时判断调用点的这条日志是否被合并，需要时先输出上一个窗口的汇总
+        bool Suppressed(const CallSite* site) {
+            return _dedup != nullptr && Deduplicate(site);
+        }
+
+        // Suppressed 的慢速路径
+        bool Deduplicate(const CallSite* site);
+
+        // 派生类析构时调用：停止合并的定时线程(它会通过虚函数输出汇总)，再输出剩余的汇总
+        void StopRepeated() {
+            if (_dedup != nullptr) {
+                _dedup->StopTimer();
+                FlushRepeated();
+            }
+        }
+
+        // 开启采样时判断调用点的这条日志是否保留，rate 为需要附带的采样率(为 0 时不附带)
+        bool Sample(LogLevel::Level level, const CallSite* site, double& rate) {
+            rate = 0;
+            return _sampler == nullptr || _sampler->Keep(level, site, rate);
+        }
+
+        // 结构化日志通过采样后调用此接口，rate 大于 0 时在字段末尾追加 sample_rate 字段
+        void LogSampledFields(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n, double rate);
+
+        // 输出一条调用点的合并汇总
+        void ReportRepeated(const CallSite* site, uint64_t repeated, uint64_t elapsed_ms);
+
+        // 各个等级的输出接口在通过等级判断后都调用此接口：形成有效载荷、格式化并落地；
+        // fields 为附加在有效载荷之后的字段(如采样率)，没有时为空
+		virtual void LogV(LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap);
+
+        // 在调用线程中形成完整的日志消息字符串并追加到 out 中，失败时返回 false
+		bool FormatV(std::string& out, LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap);
+
+        // 结构化日志在通过等级判断后调用此接口
+        virtual void LogFieldsV(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n);
+
+        // 在调用线程中形成结构化日志的日志消息字符串并追加到 out 中
+        void FormatFields(std::string& out, LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n);
+
         // 通过 log 接口让不同的日志器支持同步落地或者异步落地
-		virtual void log(const char* data, size_t len) = 0;
+		virtual void log(LogLevel::Level level, const char* data, size_t len) = 0;
+
+        // 格式化日志消息：只有一个格式化器时直接追加日志消息字符串，
+        // 否则按照记录等级需要的格式化器各渲染一次，以分发记录的形式追加到 out 中
+        void Render(std::string& out, LogLevel::Level level, const LogMsg& msg);
+
+        // 将 data 中的日志消息字符串(或分发记录)写入落地方向，调用者需要持有 _mtx；
+        // outputs 为每个通道暂存渲染结果的缓冲区，分发记录按通道拼接后每个落地方向只写入一次
+        void Deliver(const char* data, size_t len, std::vector<std::string>& outputs);
+
+    private:
+        // 根据单独配置的落地方向建立分发表，并把日志器的限制等级提高到所有落地方向中最低的等级
+        void InitRoutes(const std::vector<SinkConfig>& configs);
+
+    protected:
+        // 格式化器与最低等级都相同的一组落地方向
+        struct Channel {
+            LogLevel::Level _level;
+            std::vector<LogSink::ptr> _sinks;
+        };
+
+        // 一个格式化器及使用它的通道
+        struct Route {
+            Formatter::ptr _formatter;
+            // 使用该格式化器的通道中最低的等级，低于它的日志不需要该格式化器渲染
+            LogLevel::Level _level;
+            std::vector<size_t> _channels;
+        };
 
     protected:
         // 保护日志落地的锁
         std::mutex _mtx;
         // 日志器名称
         std::string _logger;
-        // 日志限制等级
-        LogLevel::Level _limit_level;
+        // 日志限制等级 (可以在运行期修改)
+        std::atomic<LogLevel::Level> _limit_level;
         // 格式化器
         Formatter::ptr _formatter;
         // 落地方向集合
         std::vector<LogSink::ptr> _sinks; 
+        // 日志时间戳的时钟源
+        ClockType _clock;
+        // 所有落地方向中最低的等级，限制等级不会低于它
+        LogLevel::Level _sink_floor;
+        // 是否有落地方向单独指定了格式化器或等级 (为 false 时所有落地方向共享同一条日志消息字符串)
+        bool _routed;
+        // 分发表：每个不同的格式化器及其通道 (只在 _routed 为 true 时使用，_sinks 中的落地方向也包含在内)
+        std::vector<Route> _routes;
+        std::vector<Channel> _channels;
+        // 重复日志合并 (未开启时为空)
+        std::unique_ptr<Deduper> _dedup;
+        // 采样器 (未开启时为空)
+        Sampler::ptr _sampler;
     };
 
     // 同步日志器
@@ -75,37 +263,136 @@ namespace zch {
         SyncLogger(const std::string logger
                     , zch::LogLevel::Level level
                     , zch::Formatter::ptr formatter
-                    , std::vector<zch::LogSink::ptr> sinks)
-			        : Logger(logger, level, formatter, sinks) {}
+                    , std::vector<zch::LogSink::ptr> sinks
+                    , ClockType clock = ClockType::REALTIME_COARSE
+                    , const std::vector<SinkConfig>& configs = std::vector<SinkConfig>()
+                    , std::chrono::milliseconds dedup_window = std::chrono::milliseconds::zero()
+                    , const Sampler::ptr& sampler = nullptr)
+			        : Logger(logger, level, formatter, sinks, clock, configs, dedup_window, sampler) {}
+
+        ~SyncLogger() {
+            StopRepeated();
+        }
 
     protected:
-        void log(const char* data, size_t len) override;  
+        void log(LogLevel::Level level, const char* data, size_t len) override;
+
+    private:
+        // 分发记录按通道拼接的缓冲区 (由 _mtx 保护)
+        std::vector<std::string> _outputs;
     };
 
     // 异步日志器
-    class AsyncLogger : public Logger {
+    // 日志器内部可以拥有多个分片，每个分片是一个独立的异步工作器(各自拥有异步线程)。
+    // 生产者线程按照线程 id 固定映射到其中一个分片，同一线程的日志保持有序；延迟格式化
+    // 的还原工作在各个分片的异步线程中并行完成，落地时通过日志器的锁串行写入落地方向。
+    // 开启崩溃保全后，进程收到致命信号时把各分片中尚未落地的日志直接写入落地方向，
+    // 并且每条日志在放入异步缓冲区时同时写入崩溃环
+    class AsyncLogger : public Logger, public CrashListener {
 	public:
 		AsyncLogger(const std::string logger
                     , zch::LogLevel::Level level
                     , zch::Formatter::ptr formatter
                     , std::vector<zch::LogSink::ptr> sinks
-                    , ASYNCTYPE type)
-			        : Logger(logger, level, formatter, sinks)
-			        , _lopper(std::bind(&AsyncLogger::RealSink, this, std::placeholders::_1)
-                    , type) {}
+                    , ASYNCTYPE type
+                    , bool deferred = false
+                    , ClockType clock = ClockType::REALTIME_COARSE
+                    , size_t shards = 1
+                    , const OverflowOptions& overflow = OverflowOptions()
+                    , const std::vector<SinkConfig>& configs = std::vector<SinkConfig>()
+                    , std::chrono::milliseconds dedup_window = std::chrono::milliseconds::zero()
+                    , const Sampler::ptr& sampler = nullptr
+                    , const CrashOptions& crash = CrashOptions());
+
+        ~AsyncLogger() {
+            CrashHandler::Unregister(this);
+            // 汇总需要经过异步线程落地
+            StopRepeated();
+            // 异步线程会调用 RealSink，必须在其余成员析构之前停止
+            for (auto& shard : _shards) {
+                shard->_lopper->Stop();
+            }
+        }
+
+        // 缓冲区已满时累计丢弃的消息条数
+        uint64_t Dropped() const {
+            uint64_t dropped = 0;
+            for (auto& shard : _shards) {
+                dropped += shard->_lopper->Dropped();
+            }
+            return dropped;
+        }
     
 	protected:
-		void log(const char* data, size_t len) override {
-			// 将数据放入异步缓冲区(这个接口是线程安全的因此不需要加锁)
-			_lopper.Push(data, len);
+		// 每个分片的异步工作器及其异步线程使用的暂存区
+		struct Shard {
+			// 异步线程还原出的日志消息字符串
+			std::string _rendered;
+			// 异步线程还原日志消息时复用的结构体
+			LogMsg _render_msg;
+			// 分发记录按通道拼接的缓冲区
+			std::vector<std::string> _outputs;
+			// 异步工作器
+			std::unique_ptr<AsynLopper> _lopper;
+		};
+
+		// 延迟格式化模式下，调用线程只拷贝调用点和参数的原始字节，格式化交由异步线程完成
+		// (附带字段的日志在调用线程中完成格式化)
+		void LogV(LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap) override;
+
+		// 结构化日志的字段只在调用期间有效，延迟格式化模式下也在调用线程中完成格式化
+		void LogFieldsV(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n) override;
+
+		void log(LogLevel::Level level, const char* data, size_t len) override {
+			Push(level, data, len);
+		}
+
+		// 将数据放入当前线程对应分片的异步缓冲区(这个接口是线程安全的因此不需要加锁)，
+		// level 供缓冲区已满时按等级丢弃
+		void Push(LogLevel::Level level, const char* data, size_t len) {
+			if (_crash._ring) {
+				Salvage(data, len, true);
+			}
+			size_t idx = _shards.size() == 1 ? 0 : ThreadInfo::Tid() % _shards.size();
+			_shards[idx]->_lopper->Push(data, len, level);
 		}
 
 		// 异步线程调用此函数，用于真正地将数据落地
-		void RealSink(Buffer& buf);
+		void RealSink(Shard* shard, Buffer& buf);
+
+		// 将缓冲区中的延迟格式化记录还原为日志消息字符串
+		void RenderRecords(Shard* shard, Buffer& buf);
+
+		// 异步线程在压力解除后调用，输出一条丢弃了多少条消息的日志
+		void ReportDropped(Shard* shard, uint64_t dropped);
+
+		// 异步线程空闲时调用，让所有落地方向写出暂存的数据
+		void FlushSinks();
+
+		// 进程崩溃时由信号处理函数调用：在崩溃环中写入崩溃标记，把各分片中尚未落地的日志直接写入落地方向
+		void OnCrash(int sig) override;
+
+		// 以下均只使用异步信号安全的操作
+		// AsynLopper::Salvage 的回调
+		static void SalvageChunk(void* self, const char* data, size_t len);
+
+		// 取出异步缓冲区数据中的日志文本，to_ring 为 true 时写入崩溃环，否则写入落地方向；
+		// 延迟格式化记录的参数需要格式化才能还原，只输出其调用点与格式串
+		void Salvage(const char* data, size_t len, bool to_ring);
+
+		// 处理日志消息字符串或分发记录
+		void SalvageText(const char* data, size_t len, bool to_ring);
+
+		// 输出一段文本：写入崩溃环，或者写入等级为 level 的日志应当到达的落地方向
+		void EmergencyText(const char* data, size_t len, LogLevel::Level level, bool to_ring);
 
 	protected:
-		// 异步工作器
-		AsynLopper _lopper;
+		// 是否开启延迟格式化
+		bool _deferred;
+		// 分片集合
+		std::vector<std::unique_ptr<Shard>> _shards;
+		// 崩溃保全选项
+		CrashOptions _crash;
 	};
 
     // 使用建造者模式建造日志器，简化日志器的构建，降低用户的使用复杂度定义一个建造
@@ -125,11 +412,36 @@ namespace zch {
 	public:
 		LoggerBuilder() : _async_type(ASYNCTYPE::ASYNC_SAFE)
 			            , _logger_type(LoggerType::Sync_Logger)
-			            , _limit(LogLevel::Level::DEBUG) {}
+			            , _limit(LogLevel::Level::DEBUG)
+			            , _deferred(false)
+			            , _clock(ClockType::REALTIME_COARSE)
+			            , _shards(1)
+			            , _dedup_window(std::chrono::milliseconds::zero())
+			            , _crash_safe(false)
+			            , _crash_ring_size(0) {}
 
 		// 开启非安全模式 
 		void BuildEnableUnSafe() { _async_type = ASYNCTYPE::ASYNC_UN_SAFE; }
 
+		// 开启无锁模式 (每个生产者线程独占一个环形缓冲区)
+		void BuildEnableLockFree() { _async_type = ASYNCTYPE::ASYNC_LOCK_FREE; }
+
+		// 开启延迟格式化 (仅对异步日志器有效，格式化工作由异步线程完成)
+		void BuildEnableDeferred() { _deferred = true; }
+
+		// 构建异步缓冲区已满时的处理策略
+		// max_bytes 为待处理数据的上限(0 表示使用默认值)，timeout 为 BLOCK 的最长等待时长，
+		// level 为 DROP_BELOW_LEVEL 的等级阈值
+		void BuildOverflowPolicy(OverflowPolicy policy
+								, size_t max_bytes = 0
+								, std::chrono::milliseconds timeout = std::chrono::milliseconds::max()
+								, LogLevel::Level level = LogLevel::Level::WARN) {
+			_overflow = OverflowOptions(policy, max_bytes, timeout, level);
+		}
+
+		// 构建异步日志器的分片数量 (每个分片拥有独立的异步线程)
+		void BuildShards(size_t shards) { _shards = shards > 0 ? shards : 1; }
+
 		// 构建日志器类型
 		void BuildType(LoggerType logger_type = LoggerType::Sync_Logger) { _logger_type = logger_type; }
 
@@ -139,9 +451,56 @@ namespace zch {
 		// 构建日志限制输出等级
 		void BuildLevel(LogLevel::Level limit) { _limit = limit; }
 
+		// 构建时间戳的时钟源
+		void BuildClock(ClockType clock) { _clock = clock; }
+
+		// 开启按调用点合并重复日志：同一调用点在 window 内只输出第一条日志，窗口结束后输出一条汇总
+		void BuildDedup(std::chrono::milliseconds window) { _dedup_window = window; }
+
+		// 开启崩溃保全 (仅对异步日志器有效)：安装致命信号的处理函数，崩溃时把尚未落地的日志直接写入落地方向；
+		// ring_path 不为空时另外在该文件中保存最近 ring_size 字节的日志 (此时延迟格式化退化为在调用线程中格式化，
+		// 保证崩溃环中的内容可以直接阅读)
+		void BuildCrashSafe(const std::string& ring_path = "", size_t ring_size = 256 * 1024) {
+			_crash_safe = true;
+			_crash_ring_path = ring_path;
+			_crash_ring_size = ring_size;
+		}
+
+		// 开启采样：不高于 up_to 等级的日志，每个调用点每 n 条保留一条 (如 BuildSampleEveryN(1000) 为千分之一)
+		void BuildSampleEveryN(uint64_t n, LogLevel::Level up_to = LogLevel::Level::INFO) {
+			_sampler = Sampler::EveryN(n, up_to);
+		}
+
+		// 开启采样：不高于 up_to 等级的日志以概率 p 保留 (如 BuildSampleProbability(0.01))
+		void BuildSampleProbability(double p, LogLevel::Level up_to = LogLevel::Level::INFO) {
+			_sampler = Sampler::Probability(p, up_to);
+		}
+
 		// 构建格式化器
-		void BuildFormatter(const std::string& pattern = "[%d{%H:%M:%S}][%p][%f:%l]%m%n") {
-			_formatter = std::make_shared<zch::Formatter>(pattern);
+		// cache_utc_offset 为 true 时日期子项缓存 UTC 偏移，不再每次换算都查询时区
+		void BuildFormatter(const std::string& pattern = "[%d{%H:%M:%S}][%p][%f:%l]%m%n", bool cache_utc_offset = false) {
+			_formatter = std::make_shared<zch::Formatter>(pattern, cache_utc_offset);
+		}
+
+		// 构建编译期特化的格式化器 (Pattern 为 constexpr 字符数组)
+		template<const char* Pattern>
+		void BuildStaticFormatter() {
+			_formatter = std::make_shared<zch::StaticFormatter<Pattern>>();
+		}
+
+		// 构建 logfmt 格式化器 (每条日志一行 key=value)
+		void BuildLogfmtFormatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%f%z", bool cache_utc_offset = false) {
+			_formatter = std::make_shared<zch::LogfmtFormatter>(time_fmt, cache_utc_offset);
+		}
+
+		// 构建 JSON 格式化器 (每条日志一行 JSON 对象)
+		void BuildJsonFormatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%f%z", bool cache_utc_offset = false) {
+			_formatter = std::make_shared<zch::JsonFormatter>(time_fmt, cache_utc_offset);
+		}
+
+		// 构建二进制格式化器 (落地方向只能使用 BinaryFileSink)
+		void BuildBinaryFormatter() {
+			_formatter = std::make_shared<zch::BinaryFormatter>();
 		}
 
 		// 构建落地方向数组
@@ -151,9 +510,20 @@ namespace zch {
 			_sinks.push_back(sink);
 		}
 
+		// 添加单独配置的落地方向：formatter 为空时使用日志器的格式化器，低于 level 的日志不输出到该落地方向。
+		// 每条日志按每个不同的格式化器只渲染一次，低于所有落地方向等级的日志在格式化之前就被过滤
+		// 如 builder.AddLogSink(SinkFactory::create<FdSink>("app.json"), std::make_shared<JsonFormatter>(), LogLevel::Level::INFO);
+		void AddLogSink(const LogSink::ptr& sink, const Formatter::ptr& formatter, LogLevel::Level level = LogLevel::Level::DEBUG) {
+			_configs.push_back(SinkConfig{ sink, formatter, level });
+		}
+
 		// 构建日志器
 		virtual Logger::ptr Build() = 0;
 
+	protected:
+		// 补全默认的格式化器和落地方向，并根据日志器类型构造日志器
+		Logger::ptr Create();
+
 	protected:
 		// 异步日志器的写入是否开启非安全模式
 		ASYNCTYPE  _async_type;
@@ -163,10 +533,28 @@ namespace zch {
 		std::string _logger_name;
 		// 日志限制输出等级
 		zch::LogLevel::Level _limit;
+		// 异步日志器是否开启延迟格式化
+		bool _deferred;
+		// 时间戳的时钟源
+		ClockType _clock;
+		// 异步日志器的分片数量
+		size_t _shards;
+		// 异步缓冲区已满时的处理策略
+		OverflowOptions _overflow;
+		// 重复日志合并的窗口 (0 表示不合并)
+		std::chrono::milliseconds _dedup_window;
+		// 采样器 (为空表示不采样)
+		Sampler::ptr _sampler;
+		// 是否开启崩溃保全，以及崩溃环文件的路径(为空表示不使用)与大小
+		bool _crash_safe;
+		std::string _crash_ring_path;
+		size_t _crash_ring_size;
 		// 格式化器
 		zch::Formatter::ptr	_formatter;
 		// 日志落地方向数组
 		std::vector<zch::LogSink::ptr> _sinks;
+		// 单独配置的落地方向
+		std::vector<SinkConfig> _configs;
 	};
 
     // 局部日志器建造者
@@ -176,6 +564,10 @@ namespace zch {
 	};
 
     // 日志器管理者
+	// 日志器只增不删，查找是读多写少的操作：日志器集合是一张开放寻址的哈希表，槽位中的指针只会从空变为
+	// 指向已经构造完毕的条目，读者只需原子地读取表与槽位，不加锁也不等待写者(wait-free)；
+	// 写者之间通过锁串行，表的装载率超过一半时建立两倍大小的新表后整体替换，旧表与条目在管理者析构前
+	// 一直保留，正在读取旧表的线程不受影响
 	class LogManager {
 	public:
 		// 得到实例化对象
@@ -184,20 +576,14 @@ namespace zch {
 			return ins;
 		}
 
-		// 添加日志器
-		void AddLogger(const Logger::ptr& logger) {
-			if (HasLogger(logger->GetLoggerName())) {
-				return;
-			}
+		~LogManager();
 
-			std::unique_lock<std::mutex> ulk(_mtx_loggers);
-			_loggers[logger->GetLoggerName()] = logger;
-		}
+		// 添加日志器 (已经存在同名的日志器时忽略)
+		void AddLogger(const Logger::ptr& logger);
 
 		// 判断日志器集合中是否存在指定的日志器
-		bool HasLogger(const std::string& logger_name) {
-			std::unique_lock<std::mutex> ulk(_mtx_loggers);
-			return _loggers.find(logger_name) != _loggers.end();
+		bool HasLogger(const std::string& logger_name) const {
+			return Find(logger_name) != nullptr;
 		}
 
 		// 返回默认日志器
@@ -205,28 +591,55 @@ namespace zch {
 			return _default_logger;
 		}
 
-		// 返回指定日志器
-		const Logger::ptr& GetLogger(const std::string& logger_name) {
-			return _loggers[logger_name];
+		// 返回指定日志器，不存在时返回空指针。
+		// 返回的引用在进程结束前一直有效，热路径上可以在第一次查找后缓存该引用
+		const Logger::ptr& GetLogger(const std::string& logger_name) const {
+			const Entry* entry = Find(logger_name);
+			return entry != nullptr ? entry->_logger : _null_logger;
 		}
 
 	private:
-		LogManager() {
-			std::unique_ptr<LoggerBuilder> builder(new LocalLoggerBuilder());
-			builder->BuildName("default");
-			_default_logger = builder->Build();
-			AddLogger(_default_logger);
-		}
+		LogManager();
 
 		LogManager(const LogManager&) = delete;
 
+		// 日志器条目，发布之后不再修改
+		struct Entry {
+			std::string _name;
+			size_t _hash;
+			Logger::ptr _logger;
+		};
+
+		// 开放寻址的哈希表，容量为 2 的幂
+		struct Table {
+			explicit Table(size_t capacity)
+						: _mask(capacity - 1)
+						, _size(0)
+						, _slots(new std::atomic<const Entry*>[capacity]()) {}
+
+			size_t _mask;
+			size_t _size;
+			std::unique_ptr<std::atomic<const Entry*>[]> _slots;
+		};
+
+		// 在当前的表中查找日志器，读者不加锁
+		const Entry* Find(const std::string& logger_name) const;
+
+		// 将条目放入表中 (调用者持有 _mtx_loggers)
+		static void Insert(Table* table, const Entry* entry);
+
 	private:
-		// 用于保证 _loggers(日志器对象集合)线程安全的锁
+		// 写者之间互斥的锁，读者不使用
 		std::mutex _mtx_loggers;
+		// 读者使用的当前表
+		std::atomic<Table*> _table;
+		// 建立过的全部表与条目 (管理者析构时释放)
+		std::vector<std::unique_ptr<Table>> _tables;
+		std::vector<std::unique_ptr<Entry>> _entries;
 		// 默认 logger 日志器
 		Logger::ptr _default_logger;
-		// 日志器对象集合
-		std::unordered_map<std::string, Logger::ptr> _loggers;
+		// 查找不到日志器时返回的空指针
+		Logger::ptr _null_logger;
 	};
 
     // 全局建造者,通过全局建造者建造出的对象会自动添加到 LogManager 对象中
@@ -236,4 +649,6 @@ namespace zch {
 	};
 }
 
+#undef ZCH_LOGGER_FIELDS
+
 #endif
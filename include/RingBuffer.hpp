@@ -0,0 +1,244 @@
+/**
+ * @file RingBuffer.hpp
+ * @brief 单生产者单消费者的无锁环形缓冲区，供异步工作器为每个生产者线程分配一个
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef RINGBUFFER_H__
+#define RINGBUFFER_H__
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+namespace zch {
+
+    // 每个生产者线程的环形缓冲区默认大小
+	const size_t default_ring_size = 256 * 1024;
+
+    // 环形缓冲区中的每一条记录由 [RecordHeader][数据][填充] 组成，
+    // 记录整体按 16 字节对齐，这样缓冲区尾部剩余的空间总能放下一个记录头。
+    // 当剩余的连续空间放不下一条记录时，生产者写入一个回绕标记，然后从头开始写。
+    // 超过容量一半的超长记录拷贝到堆上，环形缓冲区中只保存指向它的标记，
+    // 因此超长记录与普通记录在同一个队列中保持写入顺序
+	class SpscRing {
+	public:
+		using ptr = std::shared_ptr<SpscRing>;
+
+		// capacity 会被向上取整为 2 的幂
+		explicit SpscRing(size_t capacity = default_ring_size)
+				: _buffer(RoundUp(capacity))
+				, _mask(_buffer.size() - 1)
+				, _head(0)
+				, _tail_cache(0)
+				, _tail(0)
+				, _head_cache(0)
+				, _large(0)
+				, _waiting(false)
+				, _closed(false) {}
+
+		~SpscRing() {
+			// 释放尚未处理的超长记录
+			uint64_t stamp;
+			const char* data;
+			size_t len;
+			while (Front(stamp, data, len)) {
+				Pop();
+			}
+		}
+
+		// 一条长度为 len 的数据能否直接放入环形缓冲区(与当前是否有空闲无关)。
+		// 写入位置靠近尾部时还需要额外消耗尾部的连续空间，记录不超过容量的一半时，
+		// 无论写入位置在哪里，缓冲区被取空后总能放下；否则作为超长记录写入
+		bool Fits(size_t len) const { return RecordSize(len) <= _buffer.size() / 2; }
+
+		// 生产者接口：写入一条带有时间戳的记录，空间不足或者尚未处理的超长记录
+		// 加上本条超过 large_cap 字节时返回 false
+		bool TryPush(uint64_t stamp, const char* data, size_t len, size_t large_cap = SIZE_MAX) {
+			bool large = !Fits(len);
+			if (large && _large.load(std::memory_order_relaxed) + len > large_cap) {
+				return false;
+			}
+			size_t need = RecordSize(large ? sizeof(char*) : len);
+			size_t head = _head.load(std::memory_order_relaxed);
+			size_t offset = head & _mask;
+			size_t contig = _buffer.size() - offset;
+			// 连续空间不足时需要额外消耗尾部的空间写回绕标记
+			size_t total = need + (contig < need ? contig : 0);
+			if (total > _buffer.size()) {
+				return false;
+			}
+			if (head + total - _tail_cache > _buffer.size()) {
+				// 缓存的读位置过旧，重新读取一次消费者的位置
+				_tail_cache = _tail.load(std::memory_order_acquire);
+				if (head + total - _tail_cache > _buffer.size()) {
+					return false;
+				}
+			}
+
+			if (contig < need) {
+				WriteHeader(offset, 0, 0, kWrap);
+				head += contig;
+				offset = 0;
+			}
+			if (large) {
+				// 空间足够后才拷贝，等待空间时的重试不会重复分配
+				char* copy = new char[len];
+				memcpy(copy, data, len);
+				_large.fetch_add(len, std::memory_order_relaxed);
+				WriteHeader(offset, stamp, static_cast<uint32_t>(len), kLarge);
+				memcpy(&_buffer[offset + sizeof(RecordHeader)], &copy, sizeof(copy));
+			} else {
+				WriteHeader(offset, stamp, static_cast<uint32_t>(len), kData);
+				memcpy(&_buffer[offset + sizeof(RecordHeader)], data, len);
+			}
+			// 发布写入的数据，消费者通过 acquire 读取 _head 后即可看到完整的记录
+			_head.store(head + need, std::memory_order_release);
+			return true;
+		}
+
+		// 消费者接口：查看下一条记录，没有数据时返回 false
+		bool Front(uint64_t& stamp, const char*& data, size_t& len) {
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			while (true) {
+				if (tail == _head_cache) {
+					_head_cache = _head.load(std::memory_order_acquire);
+					if (tail == _head_cache) {
+						return false;
+					}
+				}
+				size_t offset = tail & _mask;
+				RecordHeader hdr;
+				memcpy(&hdr, &_buffer[offset], sizeof(hdr));
+				if (hdr._flag == kWrap) {
+					// 跳过回绕标记，直接释放尾部的空间
+					tail += _buffer.size() - offset;
+					_tail.store(tail, std::memory_order_release);
+					continue;
+				}
+				stamp = hdr._stamp;
+				data = Payload(offset, hdr);
+				len = hdr._len;
+				return true;
+			}
+		}
+
+		// 消费者接口：释放 Front 返回的记录
+		void Pop() {
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			size_t offset = tail & _mask;
+			RecordHeader hdr;
+			memcpy(&hdr, &_buffer[offset], sizeof(hdr));
+			if (hdr._flag == kLarge) {
+				delete[] Payload(offset, hdr);
+				_large.fetch_sub(hdr._len, std::memory_order_relaxed);
+			}
+			_tail.store(tail + Span(hdr), std::memory_order_release);
+		}
+
+		// 不移动读位置，依次查看所有待处理的记录 (只用于进程崩溃时取出剩余的数据，
+		// 此时消费者可能仍在运行，结果只是尽力而为)
+		template<class Fn>
+		void Peek(Fn&& fn) const {
+			size_t tail = _tail.load(std::memory_order_acquire);
+			size_t head = _head.load(std::memory_order_acquire);
+			while (head - tail >= sizeof(RecordHeader) && head - tail <= _buffer.size()) {
+				size_t offset = tail & _mask;
+				RecordHeader hdr;
+				memcpy(&hdr, &_buffer[offset], sizeof(hdr));
+				if (hdr._flag == kWrap) {
+					tail += _buffer.size() - offset;
+					continue;
+				}
+				if (Span(hdr) > head - tail) {
+					break;
+				}
+				fn(Payload(offset, hdr), static_cast<size_t>(hdr._len));
+				tail += Span(hdr);
+			}
+		}
+
+		// 消费者接口：判断是否没有待处理的数据
+		bool Empty() {
+			return _tail.load(std::memory_order_relaxed) == _head.load(std::memory_order_acquire);
+		}
+
+		// 生产者在等待空间之前设置等待标志，消费者释放空间后取走标志并负责唤醒生产者
+		void SetWaiting() { _waiting.store(true, std::memory_order_relaxed); }
+		bool TakeWaiting() {
+			return _waiting.load(std::memory_order_relaxed) && _waiting.exchange(false, std::memory_order_relaxed);
+		}
+
+		// 生产者线程退出时关闭环形缓冲区，消费者处理完剩余数据后即可将其回收
+		void Close() { _closed.store(true, std::memory_order_release); }
+		bool Closed() const { return _closed.load(std::memory_order_acquire); }
+
+	private:
+		struct RecordHeader {
+			uint64_t _stamp;	// 记录的时间戳，消费者据此进行多路归并
+			uint32_t _len;		// 数据长度
+			uint32_t _flag;		// 记录类型
+		};
+
+		static const uint32_t kData = 0;
+		static const uint32_t kWrap = 1;
+		// 超长记录：数据部分为指向堆上副本的指针，_len 为副本的长度
+		static const uint32_t kLarge = 2;
+		static const size_t kAlign = 16;
+
+		static size_t RecordSize(size_t len) {
+			return (sizeof(RecordHeader) + len + kAlign - 1) & ~(kAlign - 1);
+		}
+
+		// 记录在环形缓冲区中占用的空间
+		static size_t Span(const RecordHeader& hdr) {
+			return RecordSize(hdr._flag == kLarge ? sizeof(char*) : hdr._len);
+		}
+
+		// 记录的数据 (超长记录为堆上的副本)
+		const char* Payload(size_t offset, const RecordHeader& hdr) const {
+			const char* p = &_buffer[offset + sizeof(RecordHeader)];
+			if (hdr._flag == kLarge) {
+				char* copy;
+				memcpy(&copy, p, sizeof(copy));
+				return copy;
+			}
+			return p;
+		}
+
+		static size_t RoundUp(size_t n) {
+			size_t size = kAlign * 4;
+			while (size < n) {
+				size <<= 1;
+			}
+			return size;
+		}
+
+		void WriteHeader(size_t offset, uint64_t stamp, uint32_t len, uint32_t flag) {
+			RecordHeader hdr;
+			hdr._stamp = stamp;
+			hdr._len = len;
+			hdr._flag = flag;
+			memcpy(&_buffer[offset], &hdr, sizeof(hdr));
+		}
+
+	private:
+		std::vector<char> _buffer;
+		size_t _mask;
+		// 生产者独占的缓存行：写位置以及缓存的读位置
+		alignas(64) std::atomic<size_t> _head;
+		size_t _tail_cache;
+		// 消费者独占的缓存行：读位置以及缓存的写位置
+		alignas(64) std::atomic<size_t> _tail;
+		size_t _head_cache;
+		// 尚未处理的超长记录占用的字节数
+		alignas(64) std::atomic<size_t> _large;
+		std::atomic<bool> _waiting;
+		std::atomic<bool> _closed;
+	};
+}
+
+#endif
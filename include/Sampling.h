@@ -0,0 +1,64 @@
+/**
+ * @file Sampling.h
+ * @brief 高频调用点的日志采样：每秒数十万次的 DEBUG/INFO 日志全部输出代价太大，全部关闭又失去观测手段。
+ *        采样只保留其中一部分(每 N 条保留一条，或者按概率 p 保留)，判断在形成有效载荷与格式化之前完成；
+ *        保留下来的日志携带 sample_rate 字段(每条日志代表的条数)，下游统计时乘以该值即可还原总量
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef SAMPLING_H__
+#define SAMPLING_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "CallSite.h"
+#include "LogLevel.hpp"
+
+namespace zch {
+
+    // 日志器级别的采样器：对不高于 up_to 等级的日志按调用点采样，更高等级的日志不受影响
+    class Sampler {
+    public:
+        using ptr = std::shared_ptr<Sampler>;
+
+        // 每个调用点每 n 条保留一条 (保留第 1、n+1、2n+1 ... 条)，使用按调用点计数的原子计数器；
+        // slots 为计数器个数(向上取整为 2 的幂)，槽位已经被其他调用点占用时该调用点退化为按概率 1/n 采样
+        static ptr EveryN(uint64_t n, LogLevel::Level up_to, size_t slots = 4096);
+
+        // 每条日志以概率 p 保留，使用线程局部的随机数发生器，不访问共享变量
+        static ptr Probability(double p, LogLevel::Level up_to);
+
+        // 判断这条日志是否保留；被采样的等级保留时 rate 为采样率(每条日志代表的条数)，不被采样的等级 rate 为 0
+        bool Keep(LogLevel::Level level, const CallSite* site, double& rate);
+
+        // 以概率 p 返回 true (线程局部的 xorshift64*，首次使用时播种，每次只需几次移位与乘法)
+        static bool Bernoulli(double p);
+
+    private:
+        Sampler(uint64_t n, double p, LogLevel::Level up_to, size_t slots);
+
+        Sampler(const Sampler&) = delete;
+
+        struct Slot {
+            std::atomic<const CallSite*> _site;     // 占用该槽位的调用点
+            std::atomic<uint64_t> _count;           // 该调用点的日志条数
+        };
+
+    private:
+        // 每 N 条保留一条 (为 0 时按概率采样)
+        uint64_t _every_n;
+        // 按概率采样的概率
+        double _probability;
+        // 每条保留的日志代表的条数
+        double _rate;
+        // 被采样的最高等级
+        LogLevel::Level _up_to;
+        size_t _mask;
+        std::unique_ptr<Slot[]> _slots;
+    };
+}
+
+#endif
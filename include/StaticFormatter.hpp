@@ -0,0 +1,374 @@
+/**
+ * @file StaticFormatter.hpp
+ * @brief 编译期特化的格式化器：在编译期解析固定的格式化规则字符串，
+ *        生成无虚函数调用、可内联的直线式渲染代码，输出与 Formatter 逐字节一致
+ * @author zch
+ * @date 2026-10-16
+ *
+ * 使用方式：
+ *     constexpr char kPattern[] = "[%d{%H:%M:%S}][%p][%f:%l]%m%n";
+ *     builder.BuildStaticFormatter<kPattern>();
+ *
+ * 格式化规则与 Formatter 相同，%d 的子格式支持 strftime 的以下转换字符：
+ *     %Y %y %m %d %e %j %H %M %S %F %T %R %% 以及秒以下的 %L %f %N
+ */
+
+#ifndef STATICFORMATTER_H__
+#define STATICFORMATTER_H__
+
+#include <ctime>
+#include <string>
+
+#include "Formatter.h"
+
+namespace zch {
+
+namespace sfmt {
+
+	// 用于在 static_assert 中延迟求值
+	template<char C>
+	struct AlwaysFalse { static const bool value = false; };
+
+	// 从 pos 开始的原始字符串的结束位置
+	constexpr size_t LiteralEnd(const char* p, size_t pos, size_t end) {
+		return (pos >= end || p[pos] == '%') ? pos : LiteralEnd(p, pos + 1, end);
+	}
+
+	// 字符串的长度
+	constexpr size_t Length(const char* p, size_t pos = 0) {
+		return p[pos] == '\0' ? pos : Length(p, pos + 1);
+	}
+
+	// 从 pos 开始查找 '}' 的位置，找不到时返回字符串结尾
+	constexpr size_t CloseBrace(const char* p, size_t pos) {
+		return (p[pos] == '\0' || p[pos] == '}') ? pos : CloseBrace(p, pos + 1);
+	}
+
+	// 子格式 [begin, end) 是否与 s 相同
+	constexpr bool SubEquals(const char* p, size_t begin, size_t end, const char* s) {
+		return begin == end ? *s == '\0' : (*s != '\0' && p[begin] == *s && SubEquals(p, begin + 1, end, s + 1));
+	}
+
+	// pos 处为 '%'，返回格式化字符的子格式 {...} 的起止位置
+	constexpr size_t SubBegin(const char* p, size_t pos) {
+		return p[pos + 2] == '{' ? pos + 3 : pos + 2;
+	}
+	constexpr size_t SubEnd(const char* p, size_t pos) {
+		return p[pos + 2] == '{' ? CloseBrace(p, pos + 3) : pos + 2;
+	}
+
+	// 格式化字符(及其子格式)之后的下一个位置
+	constexpr size_t SpecNext(const char* p, size_t pos) {
+		return p[pos + 2] == '{' ? CloseBrace(p, pos + 3) + 1 : pos + 2;
+	}
+
+	// ------------------------- %d 的子格式 -------------------------
+
+	// 时间子格式 [pos, end) 中是否含有秒以下的字段
+	constexpr bool HasSubSec(const char* p, size_t pos, size_t end) {
+		return pos + 1 >= end ? false
+			: (p[pos] == '%' ? ((p[pos + 1] == 'L' || p[pos + 1] == 'f' || p[pos + 1] == 'N') || HasSubSec(p, pos + 2, end))
+				: HasSubSec(p, pos + 1, end));
+	}
+
+	// 时间转换字符
+	template<char C>
+	struct TimeSpec {
+		static_assert(AlwaysFalse<C>::value, "StaticFormatter: 不支持的时间转换字符");
+		static void Render(std::string&, const struct tm&, long) {}
+	};
+	template<> struct TimeSpec<'Y'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::AppendInt(out, t.tm_year + 1900LL); }
+	};
+	template<> struct TimeSpec<'y'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, ((t.tm_year % 100) + 100) % 100); }
+	};
+	template<> struct TimeSpec<'m'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_mon + 1); }
+	};
+	template<> struct TimeSpec<'d'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_mday); }
+	};
+	template<> struct TimeSpec<'e'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_mday, ' '); }
+	};
+	template<> struct TimeSpec<'j'> {
+		static void Render(std::string& out, const struct tm& t, long) {
+			int v = t.tm_yday + 1;
+			char buf[3] = { static_cast<char>('0' + v / 100), static_cast<char>('0' + v / 10 % 10), static_cast<char>('0' + v % 10) };
+			out.append(buf, 3);
+		}
+	};
+	template<> struct TimeSpec<'H'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_hour); }
+	};
+	template<> struct TimeSpec<'M'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_min); }
+	};
+	template<> struct TimeSpec<'S'> {
+		static void Render(std::string& out, const struct tm& t, long) { Number::Append2(out, t.tm_sec); }
+	};
+	template<> struct TimeSpec<'F'> {
+		static void Render(std::string& out, const struct tm& t, long nsec) {
+			TimeSpec<'Y'>::Render(out, t, nsec);
+			out.push_back('-');
+			TimeSpec<'m'>::Render(out, t, nsec);
+			out.push_back('-');
+			TimeSpec<'d'>::Render(out, t, nsec);
+		}
+	};
+	template<> struct TimeSpec<'T'> {
+		static void Render(std::string& out, const struct tm& t, long nsec) {
+			TimeSpec<'H'>::Render(out, t, nsec);
+			out.push_back(':');
+			TimeSpec<'M'>::Render(out, t, nsec);
+			out.push_back(':');
+			TimeSpec<'S'>::Render(out, t, nsec);
+		}
+	};
+	template<> struct TimeSpec<'R'> {
+		static void Render(std::string& out, const struct tm& t, long nsec) {
+			TimeSpec<'H'>::Render(out, t, nsec);
+			out.push_back(':');
+			TimeSpec<'M'>::Render(out, t, nsec);
+		}
+	};
+	// 秒以下的字段：%L 毫秒，%f 微秒，%N 纳秒
+	template<> struct TimeSpec<'L'> {
+		static void Render(std::string& out, const struct tm&, long nsec) { Number::AppendPadded(out, nsec / 1000000, 3); }
+	};
+	template<> struct TimeSpec<'f'> {
+		static void Render(std::string& out, const struct tm&, long nsec) { Number::AppendPadded(out, nsec / 1000, 6); }
+	};
+	template<> struct TimeSpec<'N'> {
+		static void Render(std::string& out, const struct tm&, long nsec) { Number::AppendPadded(out, nsec, 9); }
+	};
+	template<> struct TimeSpec<'%'> {
+		static void Render(std::string& out, const struct tm&, long) { out.push_back('%'); }
+	};
+
+	// 时间子格式 [Pos, End) 中的一个节点：原始字符串或者时间转换字符
+	template<const char* P, size_t Pos, size_t End, bool Done = (Pos >= End), bool Spec = (P[Pos] == '%')>
+	struct TimeNode;
+
+	template<const char* P, size_t Pos, size_t End, bool Spec>
+	struct TimeNode<P, Pos, End, true, Spec> {
+		static void Render(std::string&, const struct tm&, long) {}
+	};
+
+	template<const char* P, size_t Pos, size_t End>
+	struct TimeNode<P, Pos, End, false, false> {
+		static void Render(std::string& out, const struct tm& t, long nsec) {
+			out.append(P + Pos, LiteralEnd(P, Pos, End) - Pos);
+			TimeNode<P, LiteralEnd(P, Pos, End), End>::Render(out, t, nsec);
+		}
+	};
+
+	template<const char* P, size_t Pos, size_t End>
+	struct TimeNode<P, Pos, End, false, true> {
+		static_assert(Pos + 1 < End, "StaticFormatter: 时间子格式以 % 结尾");
+		static void Render(std::string& out, const struct tm& t, long nsec) {
+			TimeSpec<P[Pos + 1]>::Render(out, t, nsec);
+			TimeNode<P, Pos + 2, End>::Render(out, t, nsec);
+		}
+	};
+
+	// ------------------------- 格式化字符 -------------------------
+
+	// 格式化字符 C 对应的渲染，Begin 和 End 为其子格式 {...} 的范围
+	template<const char* P, char C, size_t Begin, size_t End>
+	struct Item {
+		static_assert(AlwaysFalse<C>::value, "StaticFormatter: 格式化字符不正确");
+		static void Render(std::string&, const LogMsg&) {}
+	};
+
+	// %d 日期
+	// 与 TimeFormatItem 相同，每个线程缓存上一秒的换算结果：子格式不含秒以下的字段时缓存渲染后的文本，
+	// 否则缓存 struct tm，每条日志只做整数格式化
+	template<const char* P, size_t Begin, size_t End, bool SubSec>
+	struct TimeItem;
+
+	template<const char* P, size_t Begin, size_t End>
+	struct TimeItem<P, Begin, End, false> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			static thread_local bool valid = false;
+			static thread_local time_t sec = 0;
+			static thread_local std::string text;
+			if (!valid || sec != msg._ctime) {
+				struct tm t;
+				localtime_r(&msg._ctime, &t);
+				text.clear();
+				TimeNode<P, Begin, End>::Render(text, t, 0);
+				sec = msg._ctime;
+				valid = true;
+			}
+			out.append(text);
+		}
+	};
+
+	template<const char* P, size_t Begin, size_t End>
+	struct TimeItem<P, Begin, End, true> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			static thread_local bool valid = false;
+			static thread_local time_t sec = 0;
+			static thread_local struct tm t;
+			if (!valid || sec != msg._ctime) {
+				localtime_r(&msg._ctime, &t);
+				sec = msg._ctime;
+				valid = true;
+			}
+			TimeNode<P, Begin, End>::Render(out, t, msg._nsec);
+		}
+	};
+
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'd', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			// 与 Formatter 一致：%d 没有子格式时输出为空
+			if (Begin == End) {
+				return;
+			}
+			TimeItem<P, Begin, End, HasSubSec(P, Begin, End)>::Render(out, msg);
+		}
+	};
+	// %p 日志级别
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'p', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { out.append(LogLevel::ToCString(msg.Level())); }
+	};
+	// %c 日志器名称
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'c', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			if (msg._logger != nullptr) {
+				out.append(*msg._logger);
+			}
+		}
+	};
+	// %t 线程id
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 't', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { ThreadInfo::AppendTid(out, msg._tid); }
+	};
+	// %i 线程名称
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'i', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { out.append(msg._tname); }
+	};
+	// %f 文件名
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'f', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { out.append(msg._site->_file); }
+	};
+	// %F 文件基础名
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'F', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { out.append(msg._site->_basename); }
+	};
+	// %l 行号
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'l', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) { Number::AppendUInt(out, msg._site->_line); }
+	};
+	// %m 日志消息，子格式为 escape 时转义有效载荷
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'm', Begin, End> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			if (SubEquals(P, Begin, End, "escape")) {
+				Escaper::Append(out, msg._payload.data(), msg._payload.size());
+			} else {
+				out.append(msg._payload);
+			}
+			if (msg._nfields > 0) {
+				FieldWriter::AppendLogfmt(out, msg._fields, msg._nfields);
+			}
+		}
+	};
+	// %T 缩进
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'T', Begin, End> {
+		static void Render(std::string& out, const LogMsg&) { out.push_back('\t'); }
+	};
+	// %n 换行
+	template<const char* P, size_t Begin, size_t End>
+	struct Item<P, 'n', Begin, End> {
+		static void Render(std::string& out, const LogMsg&) { out.push_back('\n'); }
+	};
+
+	// ------------------------- 格式化规则 -------------------------
+
+	// 格式化规则中从 Pos 开始的节点
+	// Kind: 0 结束，1 原始字符串，2 %% 转义，3 格式化字符
+	constexpr int NodeKind(const char* p, size_t pos) {
+		return p[pos] == '\0' ? 0 : (p[pos] != '%' ? 1 : (p[pos + 1] == '%' ? 2 : 3));
+	}
+
+	template<const char* P, size_t Pos, int Kind = NodeKind(P, Pos)>
+	struct Node;
+
+	template<const char* P, size_t Pos>
+	struct Node<P, Pos, 0> {
+		static void Render(std::string&, const LogMsg&) {}
+	};
+
+	template<const char* P, size_t Pos>
+	struct Node<P, Pos, 1> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			// 原始字符串的长度在编译期确定
+			out.append(P + Pos, LiteralEnd(P, Pos, Length(P)) - Pos);
+			Node<P, LiteralEnd(P, Pos, Length(P))>::Render(out, msg);
+		}
+	};
+
+	template<const char* P, size_t Pos>
+	struct Node<P, Pos, 2> {
+		static void Render(std::string& out, const LogMsg& msg) {
+			out.push_back('%');
+			Node<P, Pos + 2>::Render(out, msg);
+		}
+	};
+
+	template<const char* P, size_t Pos>
+	struct Node<P, Pos, 3> {
+		static_assert(P[Pos + 1] != '\0', "StaticFormatter: % 后无格式化字符");
+		static_assert(P[Pos + 2] != '{' || P[SubEnd(P, Pos)] == '}', "StaticFormatter: 格式化子串{}匹配出现问题");
+		static void Render(std::string& out, const LogMsg& msg) {
+			Item<P, P[Pos + 1], SubBegin(P, Pos), SubEnd(P, Pos)>::Render(out, msg);
+			Node<P, SpecNext(P, Pos)>::Render(out, msg);
+		}
+	};
+}
+
+    // 编译期特化的格式化器
+	// Pattern 必须指向具有静态存储期的 constexpr 字符数组
+	template<const char* Pattern>
+	class StaticFormatter : public Formatter {
+	public:
+		// 基类同样保存并解析格式化规则字符串，保证两者接受的规则一致
+		StaticFormatter() : Formatter(Pattern) {}
+
+		// 将日志追加到 out 中
+		static void Render(std::string& out, const LogMsg& msg) {
+			sfmt::Node<Pattern, 0>::Render(out, msg);
+		}
+
+		void Format(std::string& out, const LogMsg& msg) override {
+			Render(out, msg);
+		}
+
+		void Format(std::ostream& oss, const LogMsg& msg) override {
+			std::string out;
+			Render(out, msg);
+			oss.write(out.data(), out.size());
+		}
+
+		std::string Format(const LogMsg& msg) override {
+			std::string out;
+			out.reserve(128 + msg._payload.size());
+			Render(out, msg);
+			return out;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file ThreadInfo.h
+ * @brief 线程标识：缓存内核线程 id (与 top -H、perf、/proc/<pid>/task 中的一致) 及其文本形式，
+ *        并提供线程名称的注册接口
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef THREADINFO_H__
+#define THREADINFO_H__
+
+#include <cstdint>
+#include <string>
+
+#include "util.hpp"
+
+namespace zch {
+
+	class ThreadInfo {
+	public:
+		// 当前线程的内核线程 id，首次调用时通过 gettid 获取，之后直接读取线程局部缓存
+		static uint32_t Tid() {
+			Cache& cache = Local();
+			if (cache._tid == 0) {
+				Load(cache);
+			}
+			return cache._tid;
+		}
+
+		// 将线程 id 的文本形式追加到 out 中，当前线程的 id 直接使用预先生成的文本
+		// (延迟格式化时由异步线程输出其他线程的 id，此时按数字进行格式化)
+		static void AppendTid(std::string& out, uint32_t tid) {
+			Cache& cache = Local();
+			if (tid != 0 && tid == cache._tid) {
+				out.append(cache._text, cache._len);
+			} else {
+				Number::AppendUInt(out, tid);
+			}
+		}
+
+		// 当前线程的名称，没有注册过名称时使用内核中的线程名(默认为进程名)
+		// 返回的字符串在进程的整个生命周期内有效，可以直接保存其指针
+		static const char* Name() {
+			Cache& cache = Local();
+			if (cache._name == nullptr) {
+				LoadName(cache);
+			}
+			return cache._name;
+		}
+
+		// 注册当前线程的名称，同时设置内核中的线程名(超过 15 个字符的部分被截断)，
+		// 使得 top -H、perf 中看到的名称与日志一致
+		static void SetName(const std::string& name);
+
+	private:
+		// 线程局部缓存，只包含平凡类型，访问时无需经过线程局部对象的初始化检查
+		struct Cache {
+			uint32_t _tid;			// 内核线程 id，0 表示尚未获取
+			uint32_t _len;			// 文本形式的长度
+			char _text[12];			// 文本形式
+			const char* _name;		// 线程名称
+		};
+
+		static Cache& Local() {
+			static thread_local Cache cache;
+			return cache;
+		}
+
+		// 获取内核线程 id 并生成其文本形式
+		static void Load(Cache& cache);
+
+		// 读取内核中的线程名作为默认名称
+		static void LoadName(Cache& cache);
+
+		// fork 之后子进程中的线程 id 发生变化，清除调用 fork 的线程的缓存
+		static void ResetAfterFork();
+
+		// 保存名称的副本并返回其地址，相同的名称只保存一份，且永不释放
+		static const char* Intern(const std::string& name);
+	};
+}
+
+#endif
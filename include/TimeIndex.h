@@ -0,0 +1,67 @@
+/**
+ * @file TimeIndex.h
+ * @brief 日志文件的稀疏时间索引：日志文件每写入一定字节数，就在旁边的 .idx 文件中记录一次
+ *        (写入时间, 文件偏移量)，查询时间范围时可以直接定位到附近的位置，而不需要从头读取
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#ifndef TIMEINDEX_H__
+#define TIMEINDEX_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zch {
+
+    // 索引文件由固定长度的条目组成，每个条目表示：文件中 _offset 之前的数据都在 _ns 之前写入，
+    // 因此这些数据中日志的时间戳都不晚于 _ns (异步日志器中日志的时间戳早于写入时间)
+	class TimeIndex {
+	public:
+		struct Entry {
+			int64_t _ns;			// 写入时间(纳秒，CLOCK_REALTIME)
+			uint64_t _offset;		// 日志文件的偏移量
+		};
+
+		// 为日志文件 log_path 创建索引文件，日志文件每写入 interval 字节记录一个条目，
+		// offset 为日志文件当前的长度
+		TimeIndex(const std::string& log_path, size_t interval, uint64_t offset = 0);
+
+		// 记录最后一个条目并关闭索引文件
+		~TimeIndex();
+
+		// 日志文件写入 len 字节之后调用
+		void Written(size_t len) {
+			_offset += len;
+			if (_offset >= _next) {
+				Mark();
+			}
+		}
+
+		// 日志文件对应的索引文件 (压缩后的 .gz 文件与压缩前共用一个索引，偏移量为解压后的偏移量)
+		static std::string IndexPath(const std::string& log_path);
+
+		// 读取日志文件的索引，没有索引时返回空数组
+		static std::vector<Entry> Load(const std::string& log_path);
+
+		// 返回查找 ns 及之后的日志时可以开始读取的偏移量：该偏移量之前的数据都在 ns 之前写入
+		static uint64_t Seek(const std::vector<Entry>& entries, int64_t ns);
+
+	private:
+		// 记录一个条目
+		void Mark();
+
+	private:
+		int _fd;
+		// 记录条目的间隔
+		size_t _interval;
+		// 日志文件当前的长度
+		uint64_t _offset;
+		// 日志文件达到该长度时记录下一个条目
+		uint64_t _next;
+	};
+}
+
+#endif
@@ -11,6 +11,8 @@
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cmath>
+#include <cstdio>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -33,6 +35,79 @@ namespace zch {
         }
     };
 
+    // 整数的快速格式化，直接追加到输出字符串中，不经过流和临时字符串
+    class Number {
+    public:
+        // 十进制无符号整数
+        static void AppendUInt(std::string& out, unsigned long long v) {
+            char buf[20];
+            char* end = buf + sizeof(buf);
+            char* cur = end;
+            do {
+                *--cur = static_cast<char>('0' + v % 10);
+                v /= 10;
+            } while (v != 0);
+            out.append(cur, end - cur);
+        }
+
+        // 十进制有符号整数
+        static void AppendInt(std::string& out, long long v) {
+            if (v < 0) {
+                out.push_back('-');
+                AppendUInt(out, 0ull - static_cast<unsigned long long>(v));
+            } else {
+                AppendUInt(out, static_cast<unsigned long long>(v));
+            }
+        }
+
+        // 固定宽度的十进制数字，不足时在前面补 0 (用于毫秒、微秒等小数部分)
+        static void AppendPadded(std::string& out, unsigned long v, int width) {
+            char buf[20];
+            for (int i = width - 1; i >= 0; --i) {
+                buf[i] = static_cast<char>('0' + v % 10);
+                v /= 10;
+            }
+            out.append(buf, width);
+        }
+
+        // 浮点数：小数部分不超过 6 位并且能精确还原的数值(绝大多数耗时、比例等指标)通过整数运算输出，
+        // 去掉末尾的 0；其余数值退回 %.17g，保证解析后得到相同的值
+        static void AppendDouble(std::string& out, double v) {
+            double scaled = v * 1e6;
+            if (scaled > -9e15 && scaled < 9e15) {
+                long long r = static_cast<long long>(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+                // r / 1e6 是与十进制小数 r/10^6 最接近的 double，与 v 相等说明输出的文本能还原出 v
+                if (static_cast<double>(r) / 1e6 == v) {
+                    unsigned long long u = r < 0 ? 0ull - static_cast<unsigned long long>(r) : r;
+                    if (r < 0 || (r == 0 && std::signbit(v))) {
+                        out.push_back('-');
+                    }
+                    AppendUInt(out, u / 1000000);
+                    unsigned long frac = u % 1000000;
+                    if (frac != 0) {
+                        int width = 6;
+                        while (frac % 10 == 0) {
+                            frac /= 10;
+                            --width;
+                        }
+                        out.push_back('.');
+                        AppendPadded(out, frac, width);
+                    }
+                    return;
+                }
+            }
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%.17g", v);
+            out.append(buf, n > 0 ? n : 0);
+        }
+
+        // 两位数字，不足两位时用 pad 补齐
+        static void Append2(std::string& out, int v, char pad = '0') {
+            char buf[2] = { v < 10 ? pad : static_cast<char>('0' + v / 10), static_cast<char>('0' + v % 10) };
+            out.append(buf, 2);
+        }
+    };
+
     class File {
 	public:
 		// 判断文件是否存在
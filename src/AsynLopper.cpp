@@ -1,47 +1,405 @@
+#include <algorithm>
+#include <ctime>
+
 #include "../include/AsynLopper.h"
 
+namespace {
+
+	// 当前线程在各个工作器中注册的环形缓冲区，线程退出时关闭它们，交由异步线程回收
+	struct ThreadRings {
+		std::vector<std::pair<uint64_t, zch::SpscRing::ptr>> _rings;
+
+		~ThreadRings() {
+			for (auto& it : _rings) {
+				it.second->Close();
+			}
+		}
+	};
+
+	thread_local ThreadRings t_rings;
+
+	// 无锁模式下环形缓冲区已满时，生产者在条件变量上等待之前自旋的最长时间
+	const std::chrono::milliseconds kRingSpin(10);
+
+	// 归并使用的单调时钟时间戳(纳秒)
+	inline uint64_t MonotonicStamp() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+	}
+
+	// 归并时每个环形缓冲区的当前记录
+	struct RingCursor {
+		uint64_t _stamp;
+		const char* _data;
+		size_t _len;
+		zch::SpscRing* _ring;
+
+		// 用于构造小顶堆
+		bool operator<(const RingCursor& other) const { return _stamp > other._stamp; }
+	};
+}
+
 // 向生产者缓冲区放入数据
-void zch::AsynLopper::Push(const char* data, size_t len) {
+bool zch::AsynLopper::Push(const char* data, size_t len, LogLevel::Level level) {
+	if (_type == ASYNCTYPE::ASYNC_LOCK_FREE) {
+		return PushRing(data, len, level);
+	}
 	{
 		// 1.先对生产者缓冲区进行加锁
 		std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
-		// 2.进行条件判断，如果生产者缓冲区空间足够则进行写入，否则就阻塞在生产者条件变量上面
-		if (_type == ASYNCTYPE::ASYNC_SAFE) {
-            // 调用 _cond_pro.wait 方法，传入锁 ulk 和一个 lambda 表达式作为条件谓词，
-            // 线程会在 _pro_buf.WriteableSize() >= len 这个条件为 false 时被阻塞，直到
-            // 有其他线程调用了 _cond_pro.notify_one() 或 _cond_pro.notify_all() 方法，
-            // 并且条件 _pro_buf.WriteableSize() >= len 变为 true 时，线程才会被唤醒并继
-            // 续执行后续的操作。
-			_cond_pro.wait(ulk, [&]() {return _pro_buf.WriteableSize() >= len;});
-		}
-		// 3.条件满足，进行数据写入
-		_pro_buf.Push(data, len);
+		// 2.按照缓冲区已满时的处理策略腾出空间，无法放入时丢弃该消息
+		if (!Reserve(ulk, len, level)) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		// 3.空间足够，进行数据写入
+		PushLocked(data, len);
 	}
 	// 4.写入完毕，通知消费者进行数据处理
 	_cond_con.notify_one();
+	return true;
+}
+
+bool zch::AsynLopper::Reserve(std::unique_lock<std::mutex>& ulk, size_t len, LogLevel::Level level) {
+	if (_pro_buf.ReadableSize() + len <= _cap) {
+		return true;
+	}
+	// 单条消息本身超过上限，等待也无法放入
+	if (len > _cap) {
+		return false;
+	}
+	switch (_overflow._policy) {
+		case OverflowPolicy::DROP_NEWEST:
+			return false;
+		case OverflowPolicy::DROP_OLDEST:
+			DropOldest(len);
+			return true;
+		case OverflowPolicy::DROP_BELOW_LEVEL:
+			if (level < _overflow._level) {
+				return false;
+			}
+			break;
+		case OverflowPolicy::BLOCK:
+			break;
+	}
+
+    // 阻塞在生产者条件变量上，直到异步线程取走生产者缓冲区中的数据，或者超过等待时长
+	auto ready = [&]() { return _stop || _pro_buf.ReadableSize() + len <= _cap; };
+	if (_overflow._timeout == std::chrono::milliseconds::max()) {
+		_cond_pro.wait(ulk, ready);
+	} else {
+		_cond_pro.wait_for(ulk, _overflow._timeout, ready);
+	}
+	return _pro_buf.ReadableSize() + len <= _cap;
+}
+
+void zch::AsynLopper::PushLocked(const char* data, size_t len) {
+	_pro_buf.Push(data, len);
+	if (_overflow._policy == OverflowPolicy::DROP_OLDEST) {
+		_pro_lens.push_back(len);
+	}
+}
+
+void zch::AsynLopper::DropOldest(size_t len) {
+	uint64_t dropped = 0;
+	while (_pro_buf.ReadableSize() + len > _cap && _pro_drop < _pro_lens.size()) {
+		_pro_buf.MoveReadIdx(_pro_lens[_pro_drop++]);
+		++dropped;
+	}
+	_dropped.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+void zch::AsynLopper::ReportDropped(bool force) {
+	uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+	if (dropped != _reported && (force || dropped == _last_seen)) {
+		if (_drop_call_back) {
+			_drop_call_back(dropped - _reported);
+		}
+		_reported = dropped;
+	}
+	_last_seen = dropped;
+}
+
+bool zch::AsynLopper::PushRing(const char* data, size_t len, LogLevel::Level level) {
+	SpscRing* ring = LocalRing();
+	// 超长消息拷贝到堆上，同一线程中尚未处理的超长消息不超过上限，单条消息本身超过上限时直接丢弃
+	if (!ring->Fits(len) && len > _cap) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	uint64_t stamp = MonotonicStamp();
+	if (!ring->TryPush(stamp, data, len, _cap)) {
+		// 环形缓冲区已满：只有消费者能够移动读位置，生产者无法丢弃最早的消息，
+		// 所以 DROP_OLDEST 与 DROP_NEWEST 相同
+		OverflowPolicy policy = _overflow._policy;
+		if (policy == OverflowPolicy::DROP_NEWEST || policy == OverflowPolicy::DROP_OLDEST
+				|| (policy == OverflowPolicy::DROP_BELOW_LEVEL && level < _overflow._level)) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		// 在生产者条件变量上等待异步线程腾出空间，仍然写入本线程的环形缓冲区，保证同一线程的消息有序
+		if (!WaitRing(ring, stamp, data, len)) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	WakeConsumer();
+	return true;
+}
+
+bool zch::AsynLopper::WaitRing(SpscRing* ring, uint64_t stamp, const char* data, size_t len) {
+	// 1. 唤醒异步线程并让出 CPU，异步线程通常很快就能腾出空间
+	auto start = std::chrono::steady_clock::now();
+	do {
+		WakeConsumer();
+		std::this_thread::yield();
+		if (ring->TryPush(stamp, data, len, _cap)) {
+			return true;
+		}
+	} while (std::chrono::steady_clock::now() - start < kRingSpin);
+
+	// 2. 在生产者条件变量上等待，不再占用 CPU。每次检查空间之前设置等待标志，
+	//    与异步线程"释放空间后取走等待标志"之间使用全屏障，二者至少有一方能看到对方的写入，不会错过唤醒
+	bool pushed = false;
+	auto ready = [&]() {
+		ring->SetWaiting();
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		pushed = ring->TryPush(stamp, data, len, _cap);
+		return pushed || _stop;
+	};
+	std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+	if (_overflow._timeout == std::chrono::milliseconds::max()) {
+		_cond_pro.wait(ulk, ready);
+	} else {
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		if (elapsed < _overflow._timeout) {
+			_cond_pro.wait_for(ulk, _overflow._timeout - elapsed, ready);
+		}
+	}
+	return pushed;
+}
+
+void zch::AsynLopper::WakeConsumer() {
+	// 写入环形缓冲区(release)之后读取休眠标志是"先写后读"，需要全屏障与异步线程一侧配对，
+	// 否则双方可能都看不到对方的写入。只有异步线程处于休眠时才需要唤醒，并且只由一个生产者负责；
+	// 持有锁再通知，保证异步线程已经进入等待或者尚未检查环形缓冲区
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_sleeping.load(std::memory_order_relaxed) && _sleeping.exchange(false)) {
+		{
+			std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+		}
+		_cond_con.notify_one();
+	}
+}
+
+zch::SpscRing* zch::AsynLopper::LocalRing() {
+	auto& rings = t_rings._rings;
+	for (auto& it : rings) {
+		if (it.first == _id) {
+			return it.second.get();
+		}
+	}
+
+	// 清理已经失效的工作器留下的环形缓冲区
+	rings.erase(std::remove_if(rings.begin(), rings.end(),
+			[](const std::pair<uint64_t, SpscRing::ptr>& it) { return it.second->Closed(); }),
+			rings.end());
+
+	SpscRing::ptr ring = std::make_shared<SpscRing>();
+	{
+		std::unique_lock<std::mutex> ulk(_mtx_rings);
+		_rings.push_back(ring);
+	}
+	rings.push_back(std::make_pair(_id, ring));
+	return ring.get();
+}
+
+size_t zch::AsynLopper::MergeRings(std::vector<SpscRing::ptr>& rings) {
+	// 每个环形缓冲区内部的记录已经按时间戳有序，使用小顶堆进行多路归并
+	// (堆只在异步线程中使用，复用其容量)
+	static thread_local std::vector<RingCursor> heap;
+	heap.clear();
+	for (auto& ring : rings) {
+		RingCursor cur;
+		cur._ring = ring.get();
+		if (ring->Front(cur._stamp, cur._data, cur._len)) {
+			heap.push_back(cur);
+		}
+	}
+	std::make_heap(heap.begin(), heap.end());
+
+	size_t count = 0;
+	bool wake = false;
+	// 单批次数据量达到默认缓冲区大小就先落地，避免生产者持续写入时异步线程无法返回
+	while (!heap.empty() && _con_buf.ReadableSize() < default_buffer_size) {
+		std::pop_heap(heap.begin(), heap.end());
+		RingCursor& cur = heap.back();
+		_con_buf.Push(cur._data, cur._len);
+		cur._ring->Pop();
+		++count;
+		// 释放空间之后检查该环形缓冲区的生产者是否在等待 (与 WaitRing 中设置等待标志之后的全屏障配对)
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (cur._ring->TakeWaiting()) {
+			wake = true;
+		}
+		if (cur._ring->Front(cur._stamp, cur._data, cur._len)) {
+			std::push_heap(heap.begin(), heap.end());
+		} else {
+			heap.pop_back();
+		}
+	}
+	// 归并结束后(落地之前)统一唤醒等待空间的生产者，避免每释放一条记录都唤醒所有等待者
+	if (wake) {
+		{
+			std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+		}
+		_cond_pro.notify_all();
+	}
+	return count;
 }
 
 // 异步线程的入口函数
 void zch::AsynLopper::ThreadEntry() {
+	if (_type == ASYNCTYPE::ASYNC_LOCK_FREE) {
+		RingThreadEntry();
+		return;
+	}
 	while (true) {
 		{
 			// 1. 判断生产者缓冲区是否有数据，有则进行交换，无则在消费者者条件变量上面进行等待
 			std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+			// 没有新的数据：在等待之前让落地方向写出暂存的数据
+			if (_idle_pending && _pro_buf.Empty() && !CrashHandler::Crashing()) {
+				ulk.unlock();
+				Idle();
+				ulk.lock();
+			}
 			// 如果 _stop 为真，也可以进行向下运行，为了保证数据能够写入完毕以后再进行退出
-			_cond_con.wait(ulk, [&]() {return _stop || _pro_buf.ReadableSize() > 0;});
+			auto ready = [&]() {return _stop || _pro_buf.ReadableSize() > 0;};
+			if (Unreported()) {
+				// 还有尚未报告的丢弃，定时醒来检查压力是否已经解除
+				_cond_con.wait_for(ulk, std::chrono::milliseconds(100), ready);
+			} else {
+				_cond_con.wait(ulk, ready);
+			}
+			// 进程正在崩溃，剩余数据由信号处理函数输出
+			if (CrashHandler::Crashing()) {
+				ulk.unlock();
+				CrashHandler::Park();
+			}
 			// 退出标志被设置且生产者缓冲区没有数据，才可以退出
 			if (_stop && _pro_buf.Empty()) {
 				break;
 			}
 			_pro_buf.swap(_con_buf);
+			ResetPending();
 		}
-		// 2. 通知生产者进行数据写入
-		if (_type == ASYNCTYPE::ASYNC_SAFE) {
-			_cond_pro.notify_all();
-		}
+		// 2. 通知阻塞等待空间的生产者进行数据写入
+		_cond_pro.notify_all();
 		// 3. 消费者开始进行数据处理
-		_call_back(_con_buf);
+		if (!_con_buf.Empty()) {
+			Sink();
+		}
 		// 4. 数据处理完毕，重新初始化消费缓冲区
 		_con_buf.reset();
+		ReportDropped();
+	}
+	ReportDropped(true);
+}
+
+void zch::AsynLopper::RingThreadEntry() {
+	std::vector<SpscRing::ptr> rings;
+	while (true) {
+		// 1. 取得环形缓冲区集合的快照，并回收生产者线程已经退出且数据处理完毕的缓冲区
+		{
+			std::unique_lock<std::mutex> ulk(_mtx_rings);
+			_rings.erase(std::remove_if(_rings.begin(), _rings.end(),
+					[](const SpscRing::ptr& ring) { return ring->Closed() && ring->Empty(); }),
+					_rings.end());
+			rings = _rings;
+		}
+
+		// 2. 按时间戳归并各个环形缓冲区 (进程正在崩溃时不再归并，剩余数据由信号处理函数输出)
+		if (CrashHandler::Crashing()) {
+			CrashHandler::Park();
+		}
+		bool stop = _stop;
+		size_t merged = MergeRings(rings);
+
+		// 3. 消费者开始进行数据处理
+		if (merged > 0) {
+			Sink();
+			_con_buf.reset();
+			ReportDropped();
+			continue;
+		}
+
+		// 4. 没有数据：退出标志在归并前已经被设置，说明所有数据都已落地，可以退出
+		if (stop) {
+			break;
+		}
+		// 没有新的数据：在休眠之前让落地方向写出暂存的数据，之后重新检查
+		if (_idle_pending) {
+			Idle();
+			continue;
+		}
+		ReportDropped();
+
+		// 5. 进入休眠。生产者只在看到休眠标志时唤醒异步线程，为了避免错过唤醒，
+		//    设置标志后经过全屏障(与 WakeConsumer 配对)再检查一次；检查与等待都在锁内，
+		//    生产者持有同一把锁通知。休眠仍然设置了超时时间作为兜底
+		_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::unique_lock<std::mutex> ulk(_mtx_pro_buf);
+		bool pending = false;
+		for (auto& ring : rings) {
+			if (!ring->Empty()) {
+				pending = true;
+				break;
+			}
+		}
+		if (!pending && !_stop) {
+			_cond_con.wait_for(ulk, std::chrono::milliseconds(10));
+		}
+		_sleeping.store(false, std::memory_order_relaxed);
+	}
+	ReportDropped(true);
+}
+
+void zch::AsynLopper::Sink() {
+	_batch_data = _con_buf.Start();
+	_batch_len = _con_buf.ReadableSize();
+	_sinking.store(true, std::memory_order_release);
+	_call_back(_con_buf);
+	_sinking.store(false, std::memory_order_release);
+	_idle_pending = true;
+}
+
+void zch::AsynLopper::Idle() {
+	_idle_pending = false;
+	if (_idle_call_back) {
+		_idle_call_back();
+	}
+}
+
+void zch::AsynLopper::Salvage(void (*fn)(void* arg, const char* data, size_t len), void* arg) {
+	// 最多等待 500ms，异步线程写完当前批次后会停在下一次取数据之前
+	if (std::this_thread::get_id() != _td.get_id()) {
+		struct timespec ts = { 0, 10 * 1000 * 1000 };
+		for (int i = 0; i < 50 && _sinking.load(std::memory_order_acquire); ++i) {
+			nanosleep(&ts, nullptr);
+		}
+	}
+	if (_sinking.load(std::memory_order_acquire) && _batch_len > 0) {
+		fn(arg, _batch_data, _batch_len);
+	}
+	// 无锁模式下各线程的环形缓冲区分别按时间顺序输出
+	for (auto& ring : _rings) {
+		ring->Peek([fn, arg](const char* data, size_t len) { fn(arg, data, len); });
+	}
+	if (_pro_buf.ReadableSize() > 0) {
+		fn(arg, _pro_buf.Start(), _pro_buf.ReadableSize());
 	}
 }
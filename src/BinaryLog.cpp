@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/BinaryLog.h"
+
+namespace {
+
+	// 每段开始处的魔数
+	const char kMagic[8] = { 'Z', 'C', 'H', 'L', 'O', 'G', 'B', '\x01' };
+
+	// 条目类型
+	const uint8_t kSiteEntry = 1;
+	const uint8_t kStringEntry = 2;
+	const uint8_t kRecordEntry = 3;
+
+	// BinaryFormatter 交给 BinaryFileSink 的记录头，其后为有效载荷 (只在进程内传递，指针保持有效)
+	struct WireHeader {
+		uint32_t _tag;					// 固定为 kWireTag，用于识别非 BinaryFormatter 产生的数据
+		uint32_t _len;					// 记录总长度(包括记录头)
+		const zch::CallSite* _site;		// 调用点
+		const std::string* _logger;		// 日志器名称
+		const char* _tname;				// 线程名称
+		int64_t _ns;					// 时间戳(纳秒)
+		uint32_t _tid;					// 内核线程id
+	};
+
+	const uint32_t kWireTag = 0x42484358;
+
+	inline void PutVarint(std::string& out, uint64_t v) {
+		char buf[10];
+		size_t n = 0;
+		while (v >= 0x80) {
+			buf[n++] = static_cast<char>((v & 0x7f) | 0x80);
+			v >>= 7;
+		}
+		buf[n++] = static_cast<char>(v);
+		out.append(buf, n);
+	}
+
+	inline void PutBytes(std::string& out, const char* data, size_t len) {
+		PutVarint(out, len);
+		out.append(data, len);
+	}
+
+	// 有符号整数按 zigzag 编码，绝对值较小的负数也只占较少的字节
+	inline uint64_t ZigZag(int64_t v) {
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	inline int64_t UnZigZag(uint64_t v) {
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+}
+
+void zch::BinaryFormatter::Format(std::string& out, const LogMsg& msg) {
+	WireHeader hdr;
+	size_t start = out.size();
+	hdr._tag = kWireTag;
+	hdr._site = msg._site;
+	hdr._logger = msg._logger;
+	hdr._tname = msg._tname;
+	hdr._ns = static_cast<int64_t>(msg._ctime) * 1000000000 + msg._nsec;
+	hdr._tid = msg._tid;
+	out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+	// 结构化字段以 logfmt 的形式追加在有效载荷之后，与文本格式中的 %m 一致
+	out.append(msg._payload);
+	FieldWriter::AppendLogfmt(out, msg._fields, msg._nfields);
+	hdr._len = static_cast<uint32_t>(out.size() - start);
+	memcpy(&out[start] + offsetof(WireHeader, _len), &hdr._len, sizeof(hdr._len));
+}
+
+zch::BinaryFileSink::BinaryFileSink(const std::string& pathname, size_t batch_size)
+									: _pathname(pathname)
+									, _prev_ns(0)
+									, _reported(false) {
+	// 每次打开文件开始新的一段，编号与时间戳都从头开始
+	_file.reset(new FdSink(_pathname, false, batch_size));
+	_file->log(kMagic, sizeof(kMagic));
+}
+
+void zch::BinaryFileSink::log(const char* data, size_t len) {
+	_out.clear();
+	WireHeader hdr;
+	while (len >= sizeof(hdr)) {
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr._tag != kWireTag || hdr._len < sizeof(hdr) || hdr._len > len) {
+			if (!_reported) {
+				std::cerr << "BinaryFileSink只能与BinaryFormatter搭配使用" << std::endl;
+				_reported = true;
+			}
+			break;
+		}
+		// 定义需要写在引用之前，先取得编号再写入日志条目
+		uint64_t site = SiteId(hdr._site);
+		uint64_t logger = hdr._logger != nullptr ? StringId(hdr._logger->data(), hdr._logger->size()) : StringId("", 0);
+		uint64_t tname = StringId(hdr._tname, strlen(hdr._tname));
+		_out.push_back(static_cast<char>(kRecordEntry));
+		PutVarint(_out, site);
+		PutVarint(_out, logger);
+		PutVarint(_out, hdr._tid);
+		PutVarint(_out, tname);
+		PutVarint(_out, ZigZag(hdr._ns - _prev_ns));
+		_prev_ns = hdr._ns;
+		PutBytes(_out, data + sizeof(hdr), hdr._len - sizeof(hdr));
+		data += hdr._len;
+		len -= hdr._len;
+	}
+	if (!_out.empty()) {
+		_file->log(_out.data(), _out.size());
+	}
+}
+
+uint64_t zch::BinaryFileSink::SiteId(const CallSite* site) {
+	auto it = _sites.find(site);
+	if (it != _sites.end()) {
+		return it->second;
+	}
+	uint64_t id = _sites.size();
+	_sites[site] = id;
+	_out.push_back(static_cast<char>(kSiteEntry));
+	PutVarint(_out, id);
+	PutVarint(_out, site->_line);
+	_out.push_back(static_cast<char>(site->_level));
+	PutBytes(_out, site->_file, strlen(site->_file));
+	const char* fmt = site->_fmt != nullptr ? site->_fmt : "";
+	PutBytes(_out, fmt, strlen(fmt));
+	return id;
+}
+
+uint64_t zch::BinaryFileSink::StringId(const char* str, size_t len) {
+	_key.assign(str, len);
+	auto it = _strings.find(_key);
+	if (it != _strings.end()) {
+		return it->second;
+	}
+	uint64_t id = _strings.size();
+	_strings[_key] = id;
+	_out.push_back(static_cast<char>(kStringEntry));
+	PutVarint(_out, id);
+	PutBytes(_out, str, len);
+	return id;
+}
+
+zch::BinaryReader::BinaryReader(const std::string& pathname)
+								: _data(nullptr)
+								, _size(0)
+								, _pos(0)
+								, _corrupted(false)
+								, _prev_ns(0) {
+	int fd = open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(kMagic)) {
+		void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			if (memcmp(data, kMagic, sizeof(kMagic)) == 0) {
+				_data = static_cast<const char*>(data);
+				_size = st.st_size;
+			} else {
+				munmap(data, st.st_size);
+			}
+		}
+	}
+	close(fd);
+}
+
+zch::BinaryReader::~BinaryReader() {
+	if (_data != nullptr) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+}
+
+bool zch::BinaryReader::Next(LogMsg& msg) {
+	if (_data == nullptr) {
+		return false;
+	}
+	bool broken = false;
+	size_t start = _pos;
+	while (_pos < _size) {
+		// 条目无法解析，说明数据损坏或者该段的最后一个条目不完整(如进程崩溃)，
+		// 跳过该段剩余的内容，从下一段继续读取
+		if (broken) {
+			_corrupted = true;
+			broken = false;
+			SkipToSegment(start + 1);
+			continue;
+		}
+		// 新的一段
+		if (_size - _pos >= sizeof(kMagic) && memcmp(_data + _pos, kMagic, sizeof(kMagic)) == 0) {
+			_pos += sizeof(kMagic);
+			ResetSegment();
+			continue;
+		}
+		start = _pos;
+		uint8_t type = static_cast<uint8_t>(_data[_pos++]);
+		uint64_t id = 0;
+		if (type == kSiteEntry) {
+			uint64_t line = 0;
+			std::unique_ptr<SiteEntry> entry(new SiteEntry());
+			if (!ReadVarint(id) || !ReadVarint(line) || _pos >= _size) {
+				broken = true;
+				continue;
+			}
+			uint8_t level = static_cast<uint8_t>(_data[_pos++]);
+			if (!ReadBytes(entry->_file) || !ReadBytes(entry->_fmt) || id != _sites.size()) {
+				broken = true;
+				continue;
+			}
+			if (CrossesSegment(start)) {
+				broken = true;
+				continue;
+			}
+			entry->_site.reset(new CallSite(entry->_file.c_str(), line, static_cast<LogLevel::Level>(level), entry->_fmt.c_str()));
+			_sites.push_back(entry->_site.get());
+			_owned_sites.push_back(std::move(entry));
+		} else if (type == kStringEntry) {
+			std::unique_ptr<std::string> str(new std::string());
+			if (!ReadVarint(id) || !ReadBytes(*str) || id != _strings.size() || CrossesSegment(start)) {
+				broken = true;
+				continue;
+			}
+			_strings.push_back(str.get());
+			_owned_strings.push_back(std::move(str));
+		} else if (type == kRecordEntry) {
+			uint64_t site = 0, logger = 0, tid = 0, tname = 0, delta = 0;
+			if (!ReadVarint(site) || !ReadVarint(logger) || !ReadVarint(tid) || !ReadVarint(tname) || !ReadVarint(delta)
+				|| !ReadBytes(msg._payload) || site >= _sites.size() || logger >= _strings.size() || tname >= _strings.size()
+				|| CrossesSegment(start)) {
+				broken = true;
+				continue;
+			}
+			_prev_ns += UnZigZag(delta);
+			msg._ctime = static_cast<time_t>(_prev_ns / 1000000000);
+			msg._nsec = static_cast<long>(_prev_ns % 1000000000);
+			msg._site = _sites[site];
+			msg._logger = _strings[logger];
+			msg._tid = static_cast<uint32_t>(tid);
+			msg._tname = _strings[tname]->c_str();
+			return true;
+		} else {
+			broken = true;
+		}
+	}
+	if (broken) {
+		_corrupted = true;
+		_pos = _size;
+	}
+	return false;
+}
+
+bool zch::BinaryReader::ReadVarint(uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64 && _pos < _size; shift += 7) {
+		uint8_t byte = static_cast<uint8_t>(_data[_pos++]);
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool zch::BinaryReader::ReadBytes(std::string& str) {
+	uint64_t len = 0;
+	if (!ReadVarint(len) || len > _size - _pos) {
+		return false;
+	}
+	str.assign(_data + _pos, len);
+	_pos += len;
+	return true;
+}
+
+void zch::BinaryReader::ResetSegment() {
+	_sites.clear();
+	_strings.clear();
+	_prev_ns = 0;
+}
+
+bool zch::BinaryReader::CrossesSegment(size_t start) const {
+	// 魔数只要从条目内部开始(可以延伸到条目之后)即说明条目吞掉了下一段的开头
+	size_t end = std::min(_pos + sizeof(kMagic) - 1, _size);
+	return memmem(_data + start, end - start, kMagic, sizeof(kMagic)) != nullptr;
+}
+
+void zch::BinaryReader::SkipToSegment(size_t from) {
+	const void* magic = from < _size ? memmem(_data + from, _size - from, kMagic, sizeof(kMagic)) : nullptr;
+	_pos = magic != nullptr ? static_cast<const char*>(magic) - _data : _size;
+	// 找不到下一段时，之前段中的编号也不能再被引用
+	ResetSegment();
+}
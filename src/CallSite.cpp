@@ -0,0 +1,260 @@
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#include "../include/CallSite.h"
+
+namespace {
+
+	// 将一个参数按照原始字节追加到 out 中
+	template<class T>
+	inline void PutArg(std::string& out, T value) {
+		out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	// 从 data 中取出一个参数
+	template<class T>
+	inline T GetArg(const char*& data) {
+		T value;
+		memcpy(&value, data, sizeof(value));
+		data += sizeof(value);
+		return value;
+	}
+
+	// 使用单个转换说明符格式化一个参数并追加到 out 中
+	template<class T>
+	void AppendSpec(std::string& out, const std::string& spec, const int* stars, int nstars, T value) {
+		char buf[128];
+		int n = 0;
+		const char* fmt = spec.c_str();
+		switch (nstars) {
+			case 0: n = snprintf(buf, sizeof(buf), fmt, value); break;
+			case 1: n = snprintf(buf, sizeof(buf), fmt, stars[0], value); break;
+			default: n = snprintf(buf, sizeof(buf), fmt, stars[0], stars[1], value); break;
+		}
+		if (n < 0) {
+			return;
+		}
+		if (static_cast<size_t>(n) < sizeof(buf)) {
+			out.append(buf, n);
+			return;
+		}
+		// 结果超出栈上缓冲区，按照实际长度重新格式化一次
+		size_t pos = out.size();
+		out.resize(pos + n + 1);
+		switch (nstars) {
+			case 0: snprintf(&out[pos], n + 1, fmt, value); break;
+			case 1: snprintf(&out[pos], n + 1, fmt, stars[0], value); break;
+			default: snprintf(&out[pos], n + 1, fmt, stars[0], stars[1], value); break;
+		}
+		out.resize(pos + n);
+	}
+}
+
+zch::CallSite::CallSite(const char* file, size_t line, LogLevel::Level level, const char* fmt)
+						: _file(file)
+						, _basename(file)
+						, _line(line)
+						, _level(level)
+						, _fmt(fmt)
+						, _id(0)
+						, _deferrable(false) {
+	// 预先计算基础名，格式化时无需再查找路径分隔符
+	const char* slash = strrchr(_file, '/');
+	if (slash != nullptr) {
+		_basename = slash + 1;
+	}
+	_deferrable = (_fmt != nullptr) && ParseFormat();
+	_id = CallSiteRegistry::GetInstance().Register(this);
+}
+
+bool zch::CallSite::ParseFormat() {
+	// 转换说明符的格式为：%[标志][宽度][.精度][长度修饰符]转换字符
+	// 例如 abc%-*.3lu%% 被拆分为 "abc"、"%-*.3lu"、"%"
+	const char* p = _fmt;
+	std::string literal;
+	while (*p != '\0') {
+		// 1. 原始字符串
+		if (*p != '%') {
+			literal.push_back(*p++);
+			continue;
+		}
+		// 2. %% 转义
+		if (p[1] == '%') {
+			literal.push_back('%');
+			p += 2;
+			continue;
+		}
+		if (!literal.empty()) {
+			_segments.push_back(FmtSegment{ true, literal, 0, -1, ArgType::INT });
+			literal.clear();
+		}
+
+		// 3. 转换说明符
+		FmtSegment seg{ false, "", 0, -1, ArgType::INT };
+		const char* start = p++;
+		// 3.1 标志
+		while (*p != '\0' && strchr("-+ #0'I", *p) != nullptr) {
+			++p;
+		}
+		// 3.2 宽度
+		if (*p == '*') {
+			++seg._stars;
+			++p;
+		} else {
+			while (*p >= '0' && *p <= '9') {
+				++p;
+			}
+		}
+		// 位置参数(如 %1$d)无法按顺序取出参数
+		if (*p == '$') {
+			return false;
+		}
+		// 3.3 精度
+		if (*p == '.') {
+			++p;
+			if (*p == '*') {
+				++seg._stars;
+				seg._precision = -2;
+				++p;
+			} else {
+				seg._precision = 0;
+				while (*p >= '0' && *p <= '9') {
+					seg._precision = seg._precision * 10 + (*p++ - '0');
+				}
+			}
+		}
+		// 3.4 长度修饰符
+		std::string length;
+		while (*p != '\0' && strchr("hlLqjzt", *p) != nullptr) {
+			length.push_back(*p++);
+		}
+		// 3.5 转换字符
+		char conv = *p;
+		if (conv == '\0') {
+			return false;
+		}
+		++p;
+		switch (conv) {
+			case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+				if (length == "l") {
+					seg._type = ArgType::LONG;
+				} else if (length == "ll" || length == "q") {
+					seg._type = ArgType::LONGLONG;
+				} else if (length == "j") {
+					seg._type = ArgType::INTMAX;
+				} else if (length == "z") {
+					seg._type = ArgType::SIZE;
+				} else if (length == "t") {
+					seg._type = ArgType::PTRDIFF;
+				} else {
+					seg._type = ArgType::INT;
+				}
+				break;
+			case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+				seg._type = (length == "L") ? ArgType::LONGDOUBLE : ArgType::DOUBLE;
+				break;
+			case 'c':
+				if (!length.empty()) {
+					return false;
+				}
+				seg._type = ArgType::INT;
+				break;
+			case 's':
+				if (!length.empty()) {
+					return false;
+				}
+				seg._type = ArgType::STRING;
+				break;
+			case 'p':
+				seg._type = ArgType::POINTER;
+				break;
+			default:
+				// %n 会写回调用者的变量，%m 依赖调用线程的 errno，其余为非法的转换字符
+				return false;
+		}
+		seg._text.assign(start, p);
+		_segments.push_back(seg);
+	}
+	if (!literal.empty()) {
+		_segments.push_back(FmtSegment{ true, literal, 0, -1, ArgType::INT });
+	}
+	return true;
+}
+
+void zch::CallSite::EncodeArgs(va_list ap, std::string& out) const {
+	for (auto& seg : _segments) {
+		if (seg._literal) {
+			continue;
+		}
+		// '*' 对应的宽度或精度参数排在被格式化的参数之前
+		int stars[2] = { 0, -1 };
+		for (int i = 0; i < seg._stars; ++i) {
+			stars[i] = va_arg(ap, int);
+			PutArg(out, stars[i]);
+		}
+		switch (seg._type) {
+			case ArgType::INT: PutArg(out, va_arg(ap, int)); break;
+			case ArgType::LONG: PutArg(out, va_arg(ap, long)); break;
+			case ArgType::LONGLONG: PutArg(out, va_arg(ap, long long)); break;
+			case ArgType::INTMAX: PutArg(out, va_arg(ap, intmax_t)); break;
+			case ArgType::SIZE: PutArg(out, va_arg(ap, size_t)); break;
+			case ArgType::PTRDIFF: PutArg(out, va_arg(ap, ptrdiff_t)); break;
+			case ArgType::DOUBLE: PutArg(out, va_arg(ap, double)); break;
+			case ArgType::LONGDOUBLE: PutArg(out, va_arg(ap, long double)); break;
+			case ArgType::POINTER: PutArg(out, va_arg(ap, void*)); break;
+			case ArgType::STRING: {
+				// 字符串需要按值拷贝，调用返回后指针可能已经失效
+				const char* str = va_arg(ap, const char*);
+				if (str == nullptr) {
+					str = "(null)";
+				}
+				// 指定了精度时字符串不一定以 '\0' 结尾，最多只能读取精度个字节
+				int precision = seg._precision == -2 ? stars[seg._stars - 1] : seg._precision;
+				uint32_t len = static_cast<uint32_t>(precision >= 0 ? strnlen(str, precision) : strlen(str));
+				PutArg(out, len);
+				out.append(str, len);
+				break;
+			}
+		}
+	}
+}
+
+void zch::CallSite::RenderArgs(const char* data, size_t len, std::string& out) const {
+	const char* end = data + len;
+	// 字符串参数需要以 '\0' 结尾才能交给 snprintf，复用线程局部字符串的容量
+	static thread_local std::string str;
+	for (auto& seg : _segments) {
+		if (seg._literal) {
+			out.append(seg._text);
+			continue;
+		}
+		if (data >= end) {
+			// 参数数据不完整，说明记录已经损坏
+			return;
+		}
+		int stars[2] = { 0, 0 };
+		for (int i = 0; i < seg._stars; ++i) {
+			stars[i] = GetArg<int>(data);
+		}
+		switch (seg._type) {
+			case ArgType::INT: AppendSpec(out, seg._text, stars, seg._stars, GetArg<int>(data)); break;
+			case ArgType::LONG: AppendSpec(out, seg._text, stars, seg._stars, GetArg<long>(data)); break;
+			case ArgType::LONGLONG: AppendSpec(out, seg._text, stars, seg._stars, GetArg<long long>(data)); break;
+			case ArgType::INTMAX: AppendSpec(out, seg._text, stars, seg._stars, GetArg<intmax_t>(data)); break;
+			case ArgType::SIZE: AppendSpec(out, seg._text, stars, seg._stars, GetArg<size_t>(data)); break;
+			case ArgType::PTRDIFF: AppendSpec(out, seg._text, stars, seg._stars, GetArg<ptrdiff_t>(data)); break;
+			case ArgType::DOUBLE: AppendSpec(out, seg._text, stars, seg._stars, GetArg<double>(data)); break;
+			case ArgType::LONGDOUBLE: AppendSpec(out, seg._text, stars, seg._stars, GetArg<long double>(data)); break;
+			case ArgType::POINTER: AppendSpec(out, seg._text, stars, seg._stars, GetArg<void*>(data)); break;
+			case ArgType::STRING: {
+				uint32_t slen = GetArg<uint32_t>(data);
+				str.assign(data, slen);
+				data += slen;
+				AppendSpec(out, seg._text, stars, seg._stars, str.c_str());
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../include/Clock.h"
+
+namespace {
+
+	// 校准间隔：启动后从较短的间隔开始逐次翻倍，尽快修正首次校准的误差
+	const std::chrono::milliseconds kMinCalibrateInterval(50);
+	const std::chrono::milliseconds kMaxCalibrateInterval(1000);
+	// 首次校准的采样间隔
+	const std::chrono::milliseconds kInitialInterval(10);
+	// 重新校准时最多通过放慢时钟吸收的超前量，超过时认为墙上时间被向后调整
+	const int64_t kMaxSlew = 10 * 1000 * 1000;
+
+	// 当前线程上一次取得的时间及其纪元
+	thread_local int64_t t_last_ns = 0;
+	thread_local uint64_t t_last_epoch = 0;
+
+	// 通过 /proc/cpuinfo 判断时间戳计数器是否频率恒定且在休眠时不停止
+	bool InvariantTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+		std::ifstream ifs("/proc/cpuinfo");
+		std::string line;
+		while (std::getline(ifs, line)) {
+			if (line.compare(0, 5, "flags") == 0) {
+				return line.find(" constant_tsc") != std::string::npos
+					&& line.find(" nonstop_tsc") != std::string::npos;
+			}
+		}
+#endif
+		return false;
+	}
+
+	int64_t RealtimeNs() {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	}
+}
+
+zch::TscClock::TscClock()
+			: _available(InvariantTsc())
+			, _seq(0)
+			, _base_tsc(0)
+			, _base_ns(0)
+			, _ns_per_tick(0.0)
+			, _epoch(0)
+			, _first_tsc(0)
+			, _first_ns(0)
+			, _stop(false) {
+	if (!_available) {
+		return;
+	}
+
+	// 首次校准：间隔一小段时间采样两次，得到初始的换算比例
+	uint64_t tsc0, tsc1;
+	int64_t ns0, ns1;
+	Sample(tsc0, ns0);
+	std::this_thread::sleep_for(kInitialInterval);
+	Sample(tsc1, ns1);
+	if (tsc1 <= tsc0) {
+		_available = false;
+		return;
+	}
+	_base_tsc = tsc1;
+	_base_ns = ns1;
+	_ns_per_tick = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+	_first_tsc = tsc0;
+	_first_ns = ns0;
+	_td = std::thread(&TscClock::CalibrateEntry, this);
+}
+
+zch::TscClock::~TscClock() {
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	if (_td.joinable()) {
+		_td.join();
+	}
+}
+
+uint64_t zch::TscClock::ReadTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+void zch::TscClock::Sample(uint64_t& tsc, int64_t& ns) {
+	// 取两次计数值的中点，减小读取墙上时间本身带来的误差
+	uint64_t before = ReadTsc();
+	ns = RealtimeNs();
+	uint64_t after = ReadTsc();
+	tsc = before + (after - before) / 2;
+}
+
+int64_t zch::TscClock::Now() {
+	if (!_available) {
+		return RealtimeNs();
+	}
+	uint64_t tsc = ReadTsc();
+	uint64_t seq;
+	uint64_t base_tsc;
+	int64_t base_ns;
+	double ns_per_tick;
+	uint64_t epoch;
+	do {
+		seq = _seq.load(std::memory_order_acquire);
+		base_tsc = _base_tsc.load(std::memory_order_relaxed);
+		base_ns = _base_ns.load(std::memory_order_relaxed);
+		ns_per_tick = _ns_per_tick.load(std::memory_order_relaxed);
+		epoch = _epoch.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((seq & 1) != 0 || seq != _seq.load(std::memory_order_relaxed));
+
+	// 计数值可能略早于基准(不同核心之间的微小偏差)，使用有符号差值
+	int64_t delta = static_cast<int64_t>(tsc - base_tsc);
+	int64_t ns = base_ns + static_cast<int64_t>(delta * ns_per_tick);
+	// 读取计数值与读取换算参数之间恰好发布了新参数时，换算结果可能比上一次略小
+	if (epoch == t_last_epoch && ns < t_last_ns) {
+		ns = t_last_ns;
+	}
+	t_last_ns = ns;
+	t_last_epoch = epoch;
+	return ns;
+}
+
+void zch::TscClock::CalibrateEntry() {
+	std::chrono::milliseconds interval = kMinCalibrateInterval;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			if (_cond.wait_for(ulk, interval, [&]() { return _stop; })) {
+				break;
+			}
+		}
+		interval = std::min(interval * 2, kMaxCalibrateInterval);
+
+		uint64_t tsc;
+		int64_t ns;
+		Sample(tsc, ns);
+		if (tsc <= _first_tsc) {
+			continue;
+		}
+		// 频率恒定时，以首次采样为起点的跨度越长，换算比例越精确；基准点使用最新的采样，
+		// 使得墙上时间的调整(如 NTP)能够及时反映出来
+		double ns_per_tick = static_cast<double>(ns - _first_ns) / static_cast<double>(tsc - _first_tsc);
+
+		// 按当前参数换算出的时间(换算参数只由本线程写入)超前于墙上时间时，以换算值为基准，
+		// 并放慢时钟，在下一次校准时追平，时间不会回退
+		int64_t current = _base_ns.load(std::memory_order_relaxed)
+				+ static_cast<int64_t>(static_cast<int64_t>(tsc - _base_tsc.load(std::memory_order_relaxed))
+									   * _ns_per_tick.load(std::memory_order_relaxed));
+		int64_t ahead = current - ns;
+		uint64_t epoch = _epoch.load(std::memory_order_relaxed);
+		if (ahead > 0 && ahead <= kMaxSlew) {
+			int64_t next_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+			Publish(tsc, current, ns_per_tick * (1.0 - static_cast<double>(ahead) / static_cast<double>(next_ns)), epoch);
+		} else {
+			Publish(tsc, ns, ns_per_tick, ahead > 0 ? epoch + 1 : epoch);
+		}
+	}
+}
+
+void zch::TscClock::Publish(uint64_t base_tsc, int64_t base_ns, double ns_per_tick, uint64_t epoch) {
+	// 使用顺序锁发布新的换算参数
+	_seq.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	_base_tsc.store(base_tsc, std::memory_order_relaxed);
+	_base_ns.store(base_ns, std::memory_order_relaxed);
+	_ns_per_tick.store(ns_per_tick, std::memory_order_relaxed);
+	_epoch.store(epoch, std::memory_order_relaxed);
+	_seq.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/Crash.h"
+#include "../include/util.hpp"
+
+namespace {
+
+	const char kMagic[8] = { 'Z', 'C', 'H', 'C', 'R', 'A', 'S', 'H' };
+
+	// 需要处理的致命信号
+	const int kSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+	const size_t kSignalCount = sizeof(kSignals) / sizeof(kSignals[0]);
+
+	const size_t kMaxListeners = 64;
+
+	// 以下均为静态初始化的平凡类型，信号处理函数中可以直接访问
+	std::atomic<zch::CrashListener*> g_listeners[kMaxListeners];
+	struct sigaction g_previous[kSignalCount];
+	std::atomic<bool> g_entered(false);
+
+	// 备用信号栈 (SIGSTKSZ 在较新的 glibc 中不是常量，使用固定大小)
+	char g_altstack[64 * 1024];
+
+	void OnSignal(int sig, siginfo_t*, void*) {
+		// 多个线程同时崩溃时只由第一个线程输出，其余线程等待它结束进程
+		if (g_entered.exchange(true)) {
+			zch::CrashHandler::Park();
+		}
+		for (size_t i = 0; i < kMaxListeners; ++i) {
+			zch::CrashListener* listener = g_listeners[i].load(std::memory_order_acquire);
+			if (listener != nullptr) {
+				listener->OnCrash(sig);
+			}
+		}
+		// 恢复原来的处理方式后重新发送信号：处理期间该信号被阻塞，返回后立即送达
+		for (size_t i = 0; i < kSignalCount; ++i) {
+			if (kSignals[i] == sig) {
+				sigaction(sig, &g_previous[i], nullptr);
+			}
+		}
+		raise(sig);
+	}
+}
+
+zch::CrashRing::CrashRing(const std::string& pathname, size_t size)
+						: _pathname(pathname)
+						, _header(nullptr)
+						, _data(nullptr)
+						, _capacity(size > 0 ? size : 4096)
+						, _map_size(sizeof(Header) + _capacity) {
+	// 1. 检查路径是否存在,不存在就创建
+	if (!zch::File::IsExist(zch::File::GetDirPath(_pathname))) {
+		zch::File::CreateDirectory(zch::File::GetDirPath(_pathname));
+	}
+
+	// 2. 保留上一次运行留下的崩溃现场
+	int old = open(_pathname.c_str(), O_RDONLY | O_CLOEXEC);
+	if (old >= 0) {
+		Header hdr;
+		if (pread(old, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr))
+			&& memcmp(hdr._magic, kMagic, sizeof(kMagic)) == 0 && hdr._written > 0) {
+			rename(_pathname.c_str(), (_pathname + ".1").c_str());
+		}
+		close(old);
+	}
+
+	// 3. 创建文件并预先分配全部空间，写入时不会因为磁盘空间不足而收到 SIGBUS
+	int fd = open(_pathname.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		perror("CrashRing open fail: ");
+		return;
+	}
+	int ret = posix_fallocate(fd, 0, _map_size);
+	if (ret != 0) {
+		fprintf(stderr, "CrashRing fallocate fail: %s\n", strerror(ret));
+		close(fd);
+		return;
+	}
+	void* addr = mmap(nullptr, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// 映射建立后不再需要文件描述符
+	close(fd);
+	if (addr == MAP_FAILED) {
+		perror("CrashRing mmap fail: ");
+		return;
+	}
+	_header = static_cast<Header*>(addr);
+	memcpy(_header->_magic, kMagic, sizeof(kMagic));
+	_header->_capacity = _capacity;
+	_header->_written = 0;
+	_data = static_cast<char*>(addr) + sizeof(Header);
+}
+
+zch::CrashRing::~CrashRing() {
+	if (_header != nullptr) {
+		munmap(_header, _map_size);
+	}
+}
+
+void zch::CrashRing::Append(const char* data, size_t len) {
+	if (_data == nullptr || len == 0) {
+		return;
+	}
+	// 文件头位于共享映射中，使用编译器内建的原子操作预留写入区间
+	uint64_t start = __atomic_fetch_add(&_header->_written, len, __ATOMIC_RELAXED);
+	if (len > _capacity) {
+		// 只保留最后 _capacity 字节
+		start += len - _capacity;
+		data += len - _capacity;
+		len = _capacity;
+	}
+	size_t offset = start % _capacity;
+	size_t first = std::min(len, _capacity - offset);
+	memcpy(_data + offset, data, first);
+	memcpy(_data, data + first, len - first);
+}
+
+bool zch::CrashRing::Read(const std::string& pathname, std::string& out) {
+	int fd = open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	Header hdr;
+	struct stat st;
+	bool ok = pread(fd, &hdr, sizeof(hdr), 0) == static_cast<ssize_t>(sizeof(hdr))
+			&& memcmp(hdr._magic, kMagic, sizeof(kMagic)) == 0
+			&& hdr._capacity > 0
+			&& fstat(fd, &st) == 0
+			&& static_cast<uint64_t>(st.st_size) >= sizeof(hdr) + hdr._capacity;
+	if (ok) {
+		std::string data(hdr._capacity, '\0');
+		ok = pread(fd, &data[0], data.size(), sizeof(hdr)) == static_cast<ssize_t>(data.size());
+		if (ok) {
+			// 未写满时数据从头开始，写满后从下一次写入的位置开始为最早的数据
+			uint64_t len = std::min<uint64_t>(hdr._written, hdr._capacity);
+			size_t offset = static_cast<size_t>((hdr._written - len) % hdr._capacity);
+			size_t first = std::min<size_t>(len, hdr._capacity - offset);
+			out.append(data, offset, first);
+			out.append(data, 0, len - first);
+		}
+	}
+	close(fd);
+	return ok;
+}
+
+zch::CrashText& zch::CrashText::Append(const char* data, size_t len) {
+	size_t n = std::min(len, sizeof(_buf) - _len);
+	memcpy(_buf + _len, data, n);
+	_len += n;
+	return *this;
+}
+
+zch::CrashText& zch::CrashText::Append(const char* str) {
+	return Append(str, str != nullptr ? strlen(str) : 0);
+}
+
+zch::CrashText& zch::CrashText::AppendUInt(uint64_t v) {
+	char digits[20];
+	size_t n = 0;
+	do {
+		digits[sizeof(digits) - 1 - n++] = static_cast<char>('0' + v % 10);
+		v /= 10;
+	} while (v > 0);
+	return Append(digits + sizeof(digits) - n, n);
+}
+
+void zch::CrashHandler::Install() {
+	static std::once_flag once;
+	std::call_once(once, [] {
+		stack_t ss;
+		memset(&ss, 0, sizeof(ss));
+		ss.ss_sp = g_altstack;
+		ss.ss_size = sizeof(g_altstack);
+		sigaltstack(&ss, nullptr);
+
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = OnSignal;
+		sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+		// 处理期间阻塞所有致命信号：输出过程中再次崩溃时由内核按默认方式直接终止进程
+		sigemptyset(&sa.sa_mask);
+		for (size_t i = 0; i < kSignalCount; ++i) {
+			sigaddset(&sa.sa_mask, kSignals[i]);
+		}
+		for (size_t i = 0; i < kSignalCount; ++i) {
+			sigaction(kSignals[i], &sa, &g_previous[i]);
+		}
+	});
+}
+
+bool zch::CrashHandler::Register(CrashListener* listener) {
+	for (size_t i = 0; i < kMaxListeners; ++i) {
+		CrashListener* expected = nullptr;
+		if (g_listeners[i].compare_exchange_strong(expected, listener, std::memory_order_acq_rel)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void zch::CrashHandler::Unregister(CrashListener* listener) {
+	for (size_t i = 0; i < kMaxListeners; ++i) {
+		CrashListener* expected = listener;
+		if (g_listeners[i].compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+			return;
+		}
+	}
+}
+
+bool zch::CrashHandler::Crashing() {
+	return g_entered.load(std::memory_order_acquire);
+}
+
+void zch::CrashHandler::Park() {
+	while (true) {
+		pause();
+	}
+}
+
+bool zch::CrashHandler::WriteFully(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+	return true;
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <ctime>
+
+#include "../include/Dedup.h"
+#include "../include/ThreadInfo.h"
+
+namespace {
+
+	// 定时线程检查窗口的间隔范围
+	const std::chrono::milliseconds kMinTick(10);
+	const std::chrono::milliseconds kMaxTick(1000);
+}
+
+zch::Deduper::Deduper(std::chrono::milliseconds window, const report_t& report, size_t slots)
+					: _window_ns(std::chrono::duration_cast<std::chrono::nanoseconds>(window).count())
+					, _mask(0)
+					, _report(report)
+					, _started(false)
+					, _stop(false) {
+	size_t capacity = 1;
+	while (capacity < slots) {
+		capacity <<= 1;
+	}
+	_mask = capacity - 1;
+	_slots.reset(new Slot[capacity]);
+	for (size_t i = 0; i < capacity; ++i) {
+		_slots[i]._site.store(nullptr, std::memory_order_relaxed);
+		_slots[i]._start.store(0, std::memory_order_relaxed);
+		_slots[i]._last.store(0, std::memory_order_relaxed);
+		_slots[i]._count.store(0, std::memory_order_relaxed);
+	}
+}
+
+bool zch::Deduper::Suppress(const CallSite* site, uint64_t& repeated, uint64_t& elapsed_ms) {
+	repeated = 0;
+	elapsed_ms = 0;
+	Slot& slot = _slots[site->_id & _mask];
+	const CallSite* owner = slot._site.load(std::memory_order_relaxed);
+	if (owner == nullptr) {
+		// 第一次使用该槽位时占用它，槽位的开始时间为 0，本条日志会开启第一个窗口
+		// (CAS 失败时 owner 为抢先占用的调用点)
+		if (slot._site.compare_exchange_strong(owner, site, std::memory_order_relaxed)) {
+			owner = site;
+		}
+	}
+	if (owner != site) {
+		return false;
+	}
+
+	int64_t now = NowNs();
+	int64_t start = slot._start.load(std::memory_order_relaxed);
+	if (now - start < _window_ns) {
+		// 仍在窗口内，本条日志被合并
+		slot._count.fetch_add(1, std::memory_order_relaxed);
+		slot._last.store(now, std::memory_order_relaxed);
+		if (!_started.load(std::memory_order_relaxed)) {
+			std::call_once(_start_once, [this]() {
+				_td = std::thread(&Deduper::TimerEntry, this);
+				_started.store(true, std::memory_order_relaxed);
+			});
+		}
+		return true;
+	}
+	// 窗口已经结束：先取出上一个窗口的计数，再开启新的窗口。
+	// 顺序相反时，其他线程在新窗口开启之后、计数取出之前合并的日志会被算入上一个窗口
+	repeated = slot._count.exchange(0, std::memory_order_relaxed);
+	int64_t last = slot._last.load(std::memory_order_relaxed);
+	if (!slot._start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+		// 其他线程抢先开启了新的窗口，本条日志属于该窗口；取出的计数放回，在下一次汇总中输出
+		slot._count.fetch_add(repeated + 1, std::memory_order_relaxed);
+		slot._last.store(now, std::memory_order_relaxed);
+		repeated = 0;
+		return true;
+	}
+	// 只有开启新窗口的线程输出本条日志以及上一个窗口的汇总
+	if (repeated > 0) {
+		elapsed_ms = last > start ? static_cast<uint64_t>(last - start) / 1000000 : 0;
+	}
+	return false;
+}
+
+void zch::Deduper::Drain(const report_t& fn) {
+	for (size_t i = 0; i <= _mask; ++i) {
+		Slot& slot = _slots[i];
+		const CallSite* site = slot._site.load(std::memory_order_relaxed);
+		uint64_t repeated = slot._count.exchange(0, std::memory_order_relaxed);
+		if (site == nullptr || repeated == 0) {
+			continue;
+		}
+		int64_t start = slot._start.load(std::memory_order_relaxed);
+		int64_t last = slot._last.load(std::memory_order_relaxed);
+		fn(site, repeated, last > start ? static_cast<uint64_t>(last - start) / 1000000 : 0);
+	}
+}
+
+void zch::Deduper::Expire() {
+	int64_t now = NowNs();
+	for (size_t i = 0; i <= _mask; ++i) {
+		Slot& slot = _slots[i];
+		const CallSite* site = slot._site.load(std::memory_order_relaxed);
+		if (site == nullptr || slot._count.load(std::memory_order_relaxed) == 0) {
+			continue;
+		}
+		int64_t start = slot._start.load(std::memory_order_relaxed);
+		if (now - start < _window_ns) {
+			continue;
+		}
+		// 窗口已经结束但该调用点没有新的日志：取出计数并输出汇总，
+		// 之后的第一条日志照常开启新的窗口(取出的计数为 0，不再重复汇总)
+		uint64_t repeated = slot._count.exchange(0, std::memory_order_relaxed);
+		if (slot._start.load(std::memory_order_relaxed) != start) {
+			// 期间已经开启了新的窗口，取出的计数可能属于新窗口，放回由之后的汇总输出
+			slot._count.fetch_add(repeated, std::memory_order_relaxed);
+			continue;
+		}
+		if (repeated > 0) {
+			int64_t last = slot._last.load(std::memory_order_relaxed);
+			_report(site, repeated, last > start ? static_cast<uint64_t>(last - start) / 1000000 : 0);
+		}
+	}
+}
+
+void zch::Deduper::TimerEntry() {
+	ThreadInfo::SetName("zchlog-dedup");
+	std::chrono::milliseconds tick = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::nanoseconds(_window_ns / 2));
+	tick = std::min(std::max(tick, kMinTick), kMaxTick);
+	std::unique_lock<std::mutex> ulk(_mtx);
+	while (!_cond.wait_for(ulk, tick, [this]() { return _stop; })) {
+		ulk.unlock();
+		Expire();
+		ulk.lock();
+	}
+}
+
+void zch::Deduper::StopTimer() {
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	// 定时线程只在第一次合并时启动，先完成启动再回收
+	std::call_once(_start_once, []() {});
+	if (_td.joinable()) {
+		_td.join();
+	}
+}
+
+zch::Deduper::~Deduper() {
+	StopTimer();
+}
+
+int64_t zch::Deduper::NowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,289 @@
+#include <cstring>
+
+#include "../include/Escape.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define ZCH_HAVE_AVX2 1
+#endif
+
+namespace {
+
+	using ScanFn = size_t (*)(const char*, size_t);
+
+	// U+FFFD 的 UTF-8 编码
+	const char kReplacement[] = "\xef\xbf\xbd";
+
+	inline bool NeedCheck(unsigned char c) {
+		return c < 0x20 || c >= 0x7f || c == '"' || c == '\\';
+	}
+
+	size_t ScanScalar(const char* data, size_t len) {
+		for (size_t i = 0; i < len; ++i) {
+			if (NeedCheck(static_cast<unsigned char>(data[i]))) {
+				return i;
+			}
+		}
+		return len;
+	}
+
+#ifdef __SSE2__
+	// 按有符号数比较时 0x00 ~ 0x1f 与 0x80 ~ 0xff(负数) 都小于 0x20，一次比较同时找出控制字符与非 ASCII 字节
+	inline int MaskSse2(__m128i v) {
+		__m128i m = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+		m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f))));
+		return _mm_movemask_epi8(m);
+	}
+
+	size_t ScanSse2(const char* data, size_t len) {
+		if (len < 16) {
+			return ScanScalar(data, len);
+		}
+		size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			int mask = MaskSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+			if (mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+		if (i == len) {
+			return len;
+		}
+		// 剩余不足 16 字节时重新读取最后 16 字节，丢弃已经检查过的部分
+		size_t rem = len - i;
+		unsigned mask = static_cast<unsigned>(MaskSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + len - 16))));
+		mask >>= 16 - rem;
+		return mask != 0 ? i + __builtin_ctz(mask) : len;
+	}
+#endif
+
+#ifdef ZCH_HAVE_AVX2
+	__attribute__((target("avx2")))
+	inline unsigned MaskAvx2(__m256i v) {
+		__m256i m = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+		m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f))));
+		return static_cast<unsigned>(_mm256_movemask_epi8(m));
+	}
+
+	__attribute__((target("avx2")))
+	size_t ScanAvx2(const char* data, size_t len) {
+		if (len < 32) {
+			return ScanSse2(data, len);
+		}
+		size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			unsigned mask = MaskAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+			if (mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+		if (i == len) {
+			return len;
+		}
+		size_t rem = len - i;
+		unsigned mask = MaskAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len - 32)));
+		mask >>= 32 - rem;
+		return mask != 0 ? i + __builtin_ctz(mask) : len;
+	}
+#endif
+
+	bool Supported(zch::Escaper::Kernel kernel) {
+		switch (kernel) {
+#ifdef __SSE2__
+			case zch::Escaper::Kernel::SSE2: return true;
+#endif
+#ifdef ZCH_HAVE_AVX2
+			case zch::Escaper::Kernel::AVX2: return __builtin_cpu_supports("avx2");
+#endif
+			case zch::Escaper::Kernel::SCALAR: return true;
+			default: return false;
+		}
+	}
+
+	ScanFn ScanOf(zch::Escaper::Kernel kernel) {
+		switch (kernel) {
+#ifdef __SSE2__
+			case zch::Escaper::Kernel::SSE2: return ScanSse2;
+#endif
+#ifdef ZCH_HAVE_AVX2
+			case zch::Escaper::Kernel::AVX2: return ScanAvx2;
+#endif
+			default: return ScanScalar;
+		}
+	}
+
+	struct Dispatch {
+		zch::Escaper::Kernel _kernel;
+		ScanFn _scan;
+	};
+
+	Dispatch& Current() {
+		static Dispatch dispatch = [] {
+			zch::Escaper::Kernel kernel = zch::Escaper::Kernel::SCALAR;
+			if (Supported(zch::Escaper::Kernel::AVX2)) {
+				kernel = zch::Escaper::Kernel::AVX2;
+			} else if (Supported(zch::Escaper::Kernel::SSE2)) {
+				kernel = zch::Escaper::Kernel::SSE2;
+			}
+			return Dispatch{ kernel, ScanOf(kernel) };
+		}();
+		return dispatch;
+	}
+
+	// p 处以非 ASCII 字节开始的合法 UTF-8 字符的长度，不合法(包括过长编码、代理区、超出 U+10FFFF)时返回 0
+	size_t Utf8Length(const unsigned char* p, size_t len) {
+		unsigned char c = p[0];
+		unsigned char lo = 0x80, hi = 0xbf;
+		size_t n = 0;
+		if (c >= 0xc2 && c <= 0xdf) {
+			n = 2;
+		} else if (c >= 0xe0 && c <= 0xef) {
+			n = 3;
+			if (c == 0xe0) {
+				lo = 0xa0;
+			} else if (c == 0xed) {
+				hi = 0x9f;
+			}
+		} else if (c >= 0xf0 && c <= 0xf4) {
+			n = 4;
+			if (c == 0xf0) {
+				lo = 0x90;
+			} else if (c == 0xf4) {
+				hi = 0x8f;
+			}
+		} else {
+			return 0;
+		}
+		if (len < n || p[1] < lo || p[1] > hi) {
+			return 0;
+		}
+		for (size_t i = 2; i < n; ++i) {
+			if ((p[i] & 0xc0) != 0x80) {
+				return 0;
+			}
+		}
+		return n;
+	}
+
+	// 转义后的输出缓冲：直接写入 out 预留的空间，避免每个转义字符都调用一次 append
+	class Writer {
+	public:
+		Writer(std::string& out, size_t hint) : _out(out), _base(out.size()), _pos(0), _cap(hint) {
+			_out.resize(_base + _cap);
+			_dst = &_out[_base];
+		}
+
+		~Writer() {
+			_out.resize(_base + _pos);
+		}
+
+		void Append(const char* data, size_t len) {
+			Reserve(len);
+			memcpy(_dst + _pos, data, len);
+			_pos += len;
+		}
+
+		void Escape(unsigned char c) {
+			static const char kHex[] = "0123456789abcdef";
+			Reserve(6);
+			char* p = _dst + _pos;
+			p[0] = '\\';
+			switch (c) {
+				case '"': p[1] = '"'; break;
+				case '\\': p[1] = '\\'; break;
+				case '\n': p[1] = 'n'; break;
+				case '\r': p[1] = 'r'; break;
+				case '\t': p[1] = 't'; break;
+				default:
+					p[1] = 'u';
+					p[2] = '0';
+					p[3] = '0';
+					p[4] = kHex[c >> 4];
+					p[5] = kHex[c & 0xf];
+					_pos += 6;
+					return;
+			}
+			_pos += 2;
+		}
+
+	private:
+		void Reserve(size_t n) {
+			if (_pos + n > _cap) {
+				_cap = _cap * 2 + n;
+				_out.resize(_base + _cap);
+				_dst = &_out[_base];
+			}
+		}
+
+	private:
+		std::string& _out;
+		size_t _base;
+		size_t _pos;
+		size_t _cap;
+		char* _dst;
+	};
+}
+
+void zch::Escaper::Append(std::string& out, const char* data, size_t len) {
+	ScanFn scan = Current()._scan;
+	size_t i = scan(data, len);
+	// 快速路径：不含需要处理的字节时整段复制
+	if (i == len) {
+		out.append(data, len);
+		return;
+	}
+	// 大多数载荷只有少量字符需要转义，预留的空间通常不需要再扩大
+	Writer writer(out, len + len / 8 + 16);
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	size_t start = 0;
+	while (i < len) {
+		if (p[i] >= 0x80) {
+			size_t n = Utf8Length(p + i, len - i);
+			if (n > 0) {
+				// 合法的多字节字符留在待复制的区间中
+				i += n;
+			} else {
+				writer.Append(data + start, i - start);
+				writer.Append(kReplacement, 3);
+				start = ++i;
+			}
+			// 连续的非 ASCII 字符(如中文)逐个校验，不必每个字符都回到向量扫描
+			if (i < len && p[i] >= 0x80) {
+				continue;
+			}
+		} else {
+			writer.Append(data + start, i - start);
+			writer.Escape(p[i]);
+			start = ++i;
+		}
+		i += scan(data + i, len - i);
+	}
+	writer.Append(data + start, len - start);
+}
+
+size_t zch::Escaper::Scan(const char* data, size_t len) {
+	return Current()._scan(data, len);
+}
+
+zch::Escaper::Kernel zch::Escaper::Active() {
+	return Current()._kernel;
+}
+
+bool zch::Escaper::Select(Kernel kernel) {
+	if (!Supported(kernel)) {
+		return false;
+	}
+	Current() = Dispatch{ kernel, ScanOf(kernel) };
+	return true;
+}
+
+const char* zch::Escaper::ToCString(Kernel kernel) {
+	switch (kernel) {
+		case Kernel::SSE2: return "SSE2";
+		case Kernel::AVX2: return "AVX2";
+		default: return "SCALAR";
+	}
+}
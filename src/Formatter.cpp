@@ -1,11 +1,96 @@
+#include <cmath>
+#include <cstring>
+
 #include "../include/Formatter.h"
 
-void zch::Formatter::Format(std::ostream& oss, const LogMsg& msg) {
+zch::TimeFormatItem::TimeFormatItem(const std::string& fmt, bool cache_utc_offset)
+									: _time_fmt(fmt)
+									, _cache_utc_offset(cache_utc_offset)
+									, _id(NextId()) {
+	// 将 %L、%f、%N 从格式串中拆分出来，其余部分交给 strftime
+	std::string chunk;
+	for (size_t pos = 0; pos < _time_fmt.size(); ++pos) {
+		if (_time_fmt[pos] == '%' && pos + 1 < _time_fmt.size()) {
+			char c = _time_fmt[pos + 1];
+			if (c == 'L' || c == 'f' || c == 'N') {
+				_chunks.push_back(chunk);
+				_subsec.push_back(c);
+				chunk.clear();
+				++pos;
+				continue;
+			}
+			// 其余转换字符(包括 %%)原样保留
+			chunk.push_back('%');
+			chunk.push_back(c);
+			++pos;
+			continue;
+		}
+		chunk.push_back(_time_fmt[pos]);
+	}
+	_chunks.push_back(chunk);
+}
+
+zch::TimeFormatItem::TimeCache& zch::TimeFormatItem::LocalCache() {
+	// 每个线程保存少量缓存槽，足以覆盖一个格式化规则中有多个日期子项或者线程使用多个日志器的情况
+	static const size_t kSlots = 4;
+	static thread_local TimeCache slots[kSlots];
+	static thread_local size_t next = 0;
+	for (size_t i = 0; i < kSlots; ++i) {
+		if (slots[i]._owner == _id) {
+			return slots[i];
+		}
+	}
+	TimeCache& cache = slots[next++ % kSlots];
+	cache._owner = _id;
+	cache._valid = false;
+	cache._offset_begin = cache._offset_end = 0;
+	return cache;
+}
+
+void zch::TimeFormatItem::Render(TimeCache& cache, time_t sec) {
+	struct tm t;
+	if (!_cache_utc_offset) {
+		// 使用C库函数对时间戳进行格式化
+		localtime_r(&sec, &t);
+	} else {
+		// 时区偏移只会在整刻钟切换，缓存的偏移在当前刻钟内有效
+		if (sec < cache._offset_begin || sec >= cache._offset_end) {
+			localtime_r(&sec, &t);
+			cache._gmtoff = t.tm_gmtoff;
+			cache._isdst = t.tm_isdst;
+			cache._zone = t.tm_zone;
+			cache._offset_begin = sec - sec % 900;
+			cache._offset_end = cache._offset_begin + 900;
+		}
+		time_t local = sec + cache._gmtoff;
+		gmtime_r(&local, &t);
+		// 保证 %z、%Z 等依赖时区的转换字符输出正确
+		t.tm_gmtoff = cache._gmtoff;
+		t.tm_isdst = cache._isdst;
+		t.tm_zone = cache._zone;
+	}
+
+	char buf[128];
+	cache._text.clear();
+	cache._ends.clear();
+	for (size_t i = 0; i < _chunks.size(); ++i) {
+		// 将结构体 t 中存储的时间按照格式串进行存储到 buf 中。
+		size_t n = strftime(buf, sizeof(buf), _chunks[i].c_str(), &t);
+		cache._text.append(buf, n);
+		if (i < _subsec.size()) {
+			cache._ends.push_back(cache._text.size());
+		}
+	}
+	cache._sec = sec;
+	cache._valid = true;
+}
+
+void zch::Formatter::Format(std::string& out, const LogMsg& msg) {
 	// 不断循环取出每一个对象
 	for (auto& it : _items) {
-		// 对每一个格式化子项调用自己的 Format 接口，格式化指定部分然后输出到流当中
+		// 对每一个格式化子项调用自己的 Format 接口，格式化指定部分然后追加到输出中
 		// 当所有的格式化子项都被调用完毕以后就组成了一条完整的日志了。
-		it->Format(oss, msg);
+		it->Format(out, msg);
 	}
 }
 
@@ -24,7 +109,7 @@ bool zch::Formatter::ParsePattern() {
 
 	// 一、解析格式化字符串
 	// 有效的格式化字符集合
-	std::unordered_set<char> fmt_set = { 'd','p','c','t','f','l','m','T','n' };
+	std::unordered_set<char> fmt_set = { 'd','p','c','t','i','f','F','l','m','T','n' };
 
 	// 存储格式化字符的顺序
 	// 其中 pair 的第一个参数是：格式化字符，第二个参数是：创建格式化子项时对应的参数
@@ -105,7 +190,7 @@ inline zch::FormatItem::ptr zch::Formatter::CreateItem(const std::string& key, c
 	// 构造日期格式化子项
 	if (key == "d") {
         // 构造「时间格式化子项」时，我们要传递 %H:%M:%S 这样的参数
-        return std::make_shared<TimeFormatItem>(val);
+        return std::make_shared<TimeFormatItem>(val, _cache_utc_offset);
     }
 	// 构造日志级别格式化子项
 	if (key == "p") {
@@ -118,10 +203,18 @@ inline zch::FormatItem::ptr zch::Formatter::CreateItem(const std::string& key, c
 	// 构造线程id格式化子项
 	if (key == "t") {
         return std::make_shared<ThreadFormatItem>();
+    }
+	// 构造线程名称格式化子项
+	if (key == "i") {
+        return std::make_shared<ThreadNameFormatItem>();
     }
 	// 构造文件名格式化子项
 	if (key == "f") {
         return std::make_shared<FileFormatItem>();
+    }
+	// 构造文件基础名格式化子项
+	if (key == "F") {
+        return std::make_shared<BaseNameFormatItem>();
     }
 	// 构造行号格式化子项
 	if (key == "l") {
@@ -129,7 +222,8 @@ inline zch::FormatItem::ptr zch::Formatter::CreateItem(const std::string& key, c
     }
 	// 构造日志消息格式化子项
 	if (key == "m") {
-        return std::make_shared<MsgFormatItem>();
+        // %m{escape} 对有效载荷进行转义与 UTF-8 校验
+        return std::make_shared<MsgFormatItem>(val == "escape");
     }
 	// 构造缩进格式化子项
 	if (key == "T") {
@@ -142,3 +236,125 @@ inline zch::FormatItem::ptr zch::Formatter::CreateItem(const std::string& key, c
 	// 没有匹配的格式化字符就构造 其他格式化子项
 	return std::make_shared<OtherFormatItem>(val);
 }
+
+namespace {
+
+	// 数值与布尔值的文本形式在 logfmt 与 JSON 中相同 (JSON 中非有限的浮点数除外)
+	inline void AppendScalar(std::string& out, const zch::Field& field) {
+		switch (field._type) {
+			case zch::Field::Type::INT: zch::Number::AppendInt(out, field._int); break;
+			case zch::Field::Type::UINT: zch::Number::AppendUInt(out, field._uint); break;
+			case zch::Field::Type::DOUBLE: zch::Number::AppendDouble(out, field._double); break;
+			case zch::Field::Type::BOOL: out.append(field._bool ? "true" : "false"); break;
+			default: break;
+		}
+	}
+}
+
+void zch::FieldWriter::AppendLogfmt(std::string& out, const Field* fields, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		const Field& field = fields[i];
+		out.push_back(' ');
+		out.append(field._key);
+		out.push_back('=');
+		if (field._type == Field::Type::STRING) {
+			AppendLogfmtValue(out, field._str._data, field._str._len);
+		} else {
+			AppendScalar(out, field);
+		}
+	}
+}
+
+void zch::FieldWriter::AppendLogfmtValue(std::string& out, const char* data, size_t len) {
+	bool quote = (len == 0);
+	for (size_t i = 0; i < len && !quote; ++i) {
+		unsigned char c = static_cast<unsigned char>(data[i]);
+		quote = c <= ' ' || c == '=' || c == '"' || c == '\\';
+	}
+	if (!quote) {
+		out.append(data, len);
+		return;
+	}
+	out.push_back('"');
+	Escaper::Append(out, data, len);
+	out.push_back('"');
+}
+
+void zch::FieldWriter::AppendJson(std::string& out, const Field* fields, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		const Field& field = fields[i];
+		out.push_back(',');
+		AppendJsonString(out, field._key, strlen(field._key));
+		out.push_back(':');
+		if (field._type == Field::Type::STRING) {
+			AppendJsonString(out, field._str._data, field._str._len);
+		} else if (field._type == Field::Type::DOUBLE && !std::isfinite(field._double)) {
+			// JSON 中没有 NaN 与无穷大
+			out.append("null", 4);
+		} else {
+			AppendScalar(out, field);
+		}
+	}
+}
+
+void zch::FieldWriter::AppendJsonString(std::string& out, const char* data, size_t len) {
+	out.push_back('"');
+	Escaper::Append(out, data, len);
+	out.push_back('"');
+}
+
+void zch::LogfmtFormatter::Format(std::string& out, const LogMsg& msg) {
+	out.append("time=", 5);
+	size_t pos = out.size();
+	_time.Format(out, msg);
+	// 时间格式中含有空格时需要加引号
+	if (memchr(out.data() + pos, ' ', out.size() - pos) != nullptr) {
+		out.insert(pos, 1, '"');
+		out.push_back('"');
+	}
+	out.append(" level=", 7);
+	out.append(LogLevel::ToCString(msg.Level()));
+	out.append(" logger=", 8);
+	if (msg._logger != nullptr) {
+		FieldWriter::AppendLogfmtValue(out, msg._logger->data(), msg._logger->size());
+	} else {
+		out.append("\"\"", 2);
+	}
+	out.append(" tid=", 5);
+	ThreadInfo::AppendTid(out, msg._tid);
+	out.append(" thread=", 8);
+	FieldWriter::AppendLogfmtValue(out, msg._tname, strlen(msg._tname));
+	out.append(" caller=", 8);
+	out.append(msg._site->_basename);
+	out.push_back(':');
+	Number::AppendUInt(out, msg._site->_line);
+	out.append(" msg=", 5);
+	FieldWriter::AppendLogfmtValue(out, msg._payload.data(), msg._payload.size());
+	FieldWriter::AppendLogfmt(out, msg._fields, msg._nfields);
+	out.push_back('\n');
+}
+
+void zch::JsonFormatter::Format(std::string& out, const LogMsg& msg) {
+	out.append("{\"time\":\"", 9);
+	_time.Format(out, msg);
+	out.append("\",\"level\":\"", 11);
+	out.append(LogLevel::ToCString(msg.Level()));
+	out.append("\",\"logger\":", 11);
+	if (msg._logger != nullptr) {
+		FieldWriter::AppendJsonString(out, msg._logger->data(), msg._logger->size());
+	} else {
+		out.append("\"\"", 2);
+	}
+	out.append(",\"tid\":", 7);
+	ThreadInfo::AppendTid(out, msg._tid);
+	out.append(",\"thread\":", 10);
+	FieldWriter::AppendJsonString(out, msg._tname, strlen(msg._tname));
+	out.append(",\"file\":", 8);
+	FieldWriter::AppendJsonString(out, msg._site->_basename, strlen(msg._site->_basename));
+	out.append(",\"line\":", 8);
+	Number::AppendUInt(out, msg._site->_line);
+	out.append(",\"msg\":", 7);
+	FieldWriter::AppendJsonString(out, msg._payload.data(), msg._payload.size());
+	FieldWriter::AppendJson(out, msg._fields, msg._nfields);
+	out.append("}\n", 2);
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/IoUring.h"
+
+namespace {
+
+	inline int SysSetup(unsigned entries, struct io_uring_params* params) {
+		return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	inline int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+		return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	// 队列的头尾位置与内核共享，读取对方写入的位置使用 acquire，发布自己的位置使用 release
+	inline unsigned LoadAcquire(const unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+	inline void StoreRelease(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+	template<class T>
+	inline T* At(void* base, unsigned offset) {
+		return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+	}
+}
+
+zch::IoUring::IoUring(unsigned entries)
+			: _ring_fd(-1)
+			, _to_submit(0)
+			, _sq_ptr(MAP_FAILED)
+			, _sq_size(0)
+			, _sq_head(nullptr)
+			, _sq_tail(nullptr)
+			, _sq_mask(nullptr)
+			, _sq_array(nullptr)
+			, _sq_entries(0)
+			, _sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+			, _sqes_size(0)
+			, _cq_ptr(MAP_FAILED)
+			, _cq_size(0)
+			, _cq_head(nullptr)
+			, _cq_tail(nullptr)
+			, _cq_mask(nullptr)
+			, _cqes(nullptr) {
+	// 1. 建立 io_uring 实例 (内核不支持或被禁用时直接返回)
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = SysSetup(entries, &params);
+	if (fd < 0) {
+		return;
+	}
+
+	// 2. 映射提交队列与完成队列
+	_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single) {
+		_sq_size = _cq_size = std::max(_sq_size, _cq_size);
+	}
+	_sq_ptr = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (_sq_ptr == MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	if (single) {
+		_cq_ptr = _sq_ptr;
+	} else {
+		_cq_ptr = mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (_cq_ptr == MAP_FAILED) {
+			munmap(_sq_ptr, _sq_size);
+			_sq_ptr = MAP_FAILED;
+			close(fd);
+			return;
+		}
+	}
+
+	// 3. 映射提交队列项数组
+	_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		if (!single) {
+			munmap(_cq_ptr, _cq_size);
+		}
+		munmap(_sq_ptr, _sq_size);
+		_sq_ptr = _cq_ptr = MAP_FAILED;
+		close(fd);
+		return;
+	}
+	_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+	_sq_head = At<unsigned>(_sq_ptr, params.sq_off.head);
+	_sq_tail = At<unsigned>(_sq_ptr, params.sq_off.tail);
+	_sq_mask = At<unsigned>(_sq_ptr, params.sq_off.ring_mask);
+	_sq_array = At<unsigned>(_sq_ptr, params.sq_off.array);
+	_sq_entries = params.sq_entries;
+	_cq_head = At<unsigned>(_cq_ptr, params.cq_off.head);
+	_cq_tail = At<unsigned>(_cq_ptr, params.cq_off.tail);
+	_cq_mask = At<unsigned>(_cq_ptr, params.cq_off.ring_mask);
+	_cqes = At<struct io_uring_cqe>(_cq_ptr, params.cq_off.cqes);
+	_ring_fd = fd;
+}
+
+zch::IoUring::~IoUring() {
+	if (_ring_fd < 0) {
+		return;
+	}
+	munmap(_sqes, _sqes_size);
+	if (_cq_ptr != _sq_ptr) {
+		munmap(_cq_ptr, _cq_size);
+	}
+	munmap(_sq_ptr, _sq_size);
+	close(_ring_fd);
+}
+
+bool zch::IoUring::PrepWritev(int fd, const struct iovec* iov, unsigned iovcnt, off_t offset, uint64_t user_data) {
+	// 提交队列的尾部只由本线程写入，头部由内核在消费请求后推进
+	unsigned tail = *_sq_tail;
+	if (tail - LoadAcquire(_sq_head) >= _sq_entries) {
+		return false;
+	}
+	unsigned idx = tail & *_sq_mask;
+	struct io_uring_sqe* sqe = &_sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(iov);
+	sqe->len = iovcnt;
+	sqe->off = static_cast<uint64_t>(offset);
+	sqe->user_data = user_data;
+	_sq_array[idx] = idx;
+	StoreRelease(_sq_tail, tail + 1);
+	++_to_submit;
+	return true;
+}
+
+bool zch::IoUring::Submit(unsigned wait_nr) {
+	unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+	while (true) {
+		int ret = SysEnter(_ring_fd, _to_submit, wait_nr, flags);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		_to_submit -= static_cast<unsigned>(ret);
+		return true;
+	}
+}
+
+void zch::IoUring::DropUnsubmitted() {
+	// 内核只在 io_uring_enter 中读取提交队列的尾部，未提交的请求直接回退尾部即可撤回
+	StoreRelease(_sq_tail, *_sq_tail - _to_submit);
+	_to_submit = 0;
+}
+
+bool zch::IoUring::PeekCompletion(uint64_t& user_data, int& res) {
+	// 完成队列的头部只由本线程推进，尾部由内核在请求完成后推进
+	unsigned head = *_cq_head;
+	if (head == LoadAcquire(_cq_tail)) {
+		return false;
+	}
+	struct io_uring_cqe* cqe = &_cqes[head & *_cq_mask];
+	user_data = cqe->user_data;
+	res = cqe->res;
+	StoreRelease(_cq_head, head + 1);
+	return true;
+}
@@ -1,7 +1,7 @@
 #include "../include/Log.h"
 
 
-const zch::Logger::ptr& zch::GetLogger(std::string name) {
+const zch::Logger::ptr& zch::GetLogger(const std::string& name) {
 	return zch::LogManager::GetInstance().GetLogger(name);
 }
 
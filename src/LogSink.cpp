@@ -1,6 +1,127 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <limits>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
 
 #include "../include/LogSink.h"
+#include "../include/Crash.h"
+#include "../include/IoUring.h"
+#include "../include/ThreadInfo.h"
+
+namespace {
+
+	// O_DIRECT 要求缓冲区地址、写入长度和文件偏移量按块对齐
+	const size_t kDirectAlign = 4096;
+	// O_DIRECT 模式下暂存区的最小容量
+	const size_t kDirectStage = 1024 * 1024;
+
+	inline size_t AlignUp(size_t n) { return (n + kDirectAlign - 1) & ~(kDirectAlign - 1); }
+	inline size_t AlignDown(size_t n) { return n & ~(kDirectAlign - 1); }
+
+	// 内存映射文件累计多少脏数据后通知内核回写
+	const size_t kMmapSyncBytes = 4 * 1024 * 1024;
+	// 内存映射文件末尾记录数据长度的页：前 16 字节为标识，随后 8 字节为真实数据的末尾，
+	// 再随后 8 字节为上一个记录页的位置 (末尾为 kPendingEnd 时使用上一个记录页中的末尾)
+	const char kMmapTrailerMagic[16] = "zchlog-mmap-end";
+	const size_t kMmapTrailerEnd = sizeof(kMmapTrailerMagic);
+	const size_t kMmapTrailerPrev = kMmapTrailerEnd + sizeof(uint64_t);
+	const uint64_t kPendingEnd = UINT64_MAX;
+	const uint64_t kNoTrailer = UINT64_MAX;
+	// 辅助线程预先读入映射区时每一步的大小，步与步之间让出 CPU
+	const size_t kPrefaultStep = 1024 * 1024;
+
+	// 滚动文件的名称：基础文件名-年月日_时分秒-序号.log，各字段补 0 对齐
+	std::string RollFileName(const std::string& basename, time_t now, size_t count) {
+		struct tm t;
+		localtime_r(&now, &t);
+		std::string name = basename;
+		name.push_back('-');
+		zch::Number::AppendPadded(name, t.tm_year + 1900, 4);
+		zch::Number::Append2(name, t.tm_mon + 1);
+		zch::Number::Append2(name, t.tm_mday);
+		name.push_back('_');
+		zch::Number::Append2(name, t.tm_hour);
+		zch::Number::Append2(name, t.tm_min);
+		zch::Number::Append2(name, t.tm_sec);
+		name.push_back('-');
+		zch::Number::AppendPadded(name, count, 3);
+		name.append(".log");
+		return name;
+	}
+
+	// 将数据完整写入 fd 的 offset 处，处理被信号中断以及部分写入的情况
+	bool PWriteFully(int fd, const char* data, size_t len, off_t offset) {
+		while (len > 0) {
+			ssize_t n = pwrite(fd, data, len, offset);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			data += n;
+			len -= static_cast<size_t>(n);
+			offset += n;
+		}
+		return true;
+	}
+
+	// UringSink 等待写请求完成的轮询次数与间隔
+	const int kUringWaitRetries = 1000;
+	const long kUringWaitNanos = 1000 * 1000;
+
+	inline bool EndsWith(const std::string& str, const char* suffix) {
+		size_t len = strlen(suffix);
+		return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+	}
+
+	// 从 pos 开始的连续数字个数
+	size_t CountDigits(const std::string& str, size_t pos) {
+		size_t n = 0;
+		while (pos + n < str.size() && isdigit(static_cast<unsigned char>(str[pos + n]))) {
+			++n;
+		}
+		return n;
+	}
+
+	// name 从 pos 开始是否为 RollFileName 生成的后缀：年月日_时分秒-序号.log[.gz]
+	// (同一目录中基础文件名互为前缀的其他日志，例如 app 与 app-rpc，不会被误认)
+	bool IsRollFileSuffix(const std::string& name, size_t pos) {
+		if (CountDigits(name, pos) != 8 || name.compare(pos + 8, 1, "_") != 0) {
+			return false;
+		}
+		pos += 9;
+		if (CountDigits(name, pos) != 6 || name.compare(pos + 6, 1, "-") != 0) {
+			return false;
+		}
+		pos += 7;
+		// 序号至少补齐为 3 位，超过 999 时位数更多
+		size_t n = CountDigits(name, pos);
+		if (n < 3) {
+			return false;
+		}
+		return name.compare(pos + n, std::string::npos, ".log") == 0
+			|| name.compare(pos + n, std::string::npos, ".log.gz") == 0;
+	}
+}
+
+void zch::StdOutSink::EmergencyWrite(const char* data, size_t len) {
+	// 绕过 std::cout 的缓冲区直接写入标准输出
+	CrashHandler::WriteFully(STDOUT_FILENO, data, len);
+}
 
 zch::FileSink::FileSink(const std::string& pathname)
 	                    : _pathname(pathname) {
@@ -17,57 +138,1074 @@ zch::FileSink::FileSink(const std::string& pathname)
 	}
 }
 
+zch::FdSink::FdSink(const std::string& pathname, bool direct, size_t batch_size)
+					: _pathname(pathname)
+					, _fd(-1)
+					, _direct(direct)
+					, _batch_size(batch_size)
+					, _stage(nullptr)
+					, _stage_cap(0)
+					, _staged(0)
+					, _written(0)
+					, _offset(0) {
+	// 1.检查路径是否存在,不存在就创建
+	if (!zch::File::IsExist(zch::File::GetDirPath(_pathname))) {
+		zch::File::CreateDirectory(zch::File::GetDirPath(_pathname));
+	}
+
+	// 2. 创建并打开文件 (O_DIRECT 模式下需要读回文件末尾不满一块的数据，且自行维护写入位置)
+	if (_direct) {
+		_fd = open(_pathname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+		if (_fd < 0 && errno == EINVAL) {
+			std::cerr << "FdSink: 文件系统不支持 O_DIRECT，使用普通模式" << std::endl;
+			_direct = false;
+		}
+	}
+	if (!_direct) {
+		_fd = open(_pathname.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | O_APPEND, 0644);
+	}
+	if (_fd < 0) {
+		std::cerr << "FdSink中文件打开失败" << std::endl;
+		abort();
+	}
+
+	// 3. 分配暂存区
+	if (!_direct) {
+		if (_batch_size > 0) {
+			_stage_cap = _batch_size;
+			_stage = static_cast<char*>(malloc(_stage_cap));
+		}
+		return;
+	}
+	_stage_cap = std::max(AlignUp(_batch_size), kDirectStage);
+	void* stage = nullptr;
+	if (posix_memalign(&stage, kDirectAlign, _stage_cap) != 0) {
+		std::cerr << "FdSink中暂存区分配失败" << std::endl;
+		abort();
+	}
+	_stage = static_cast<char*>(stage);
+
+	// 4. 从文件末尾所在的块开始写入，先读回该块中已有的数据
+	struct stat st;
+	if (fstat(_fd, &st) == 0 && st.st_size > 0) {
+		_offset = AlignDown(st.st_size);
+		size_t tail = st.st_size - _offset;
+		if (tail > 0 && pread(_fd, _stage, kDirectAlign, _offset) != static_cast<ssize_t>(tail)) {
+			perror("FdSink pread fail: ");
+			abort();
+		}
+		_staged = tail;
+		_written = tail;
+	}
+}
+
+zch::FdSink::~FdSink() {
+	Flush();
+	close(_fd);
+	free(_stage);
+}
+
+void zch::FdSink::log(const char* data, size_t len) {
+	if (_direct) {
+		LogDirect(data, len);
+		return;
+	}
+	// 1. 较小的数据先暂存
+	if (_staged + len <= _batch_size) {
+		memcpy(_stage + _staged, data, len);
+		_staged += len;
+		if (_staged == _batch_size) {
+			Flush();
+		}
+		return;
+	}
+	// 2. 暂存的数据与本次的数据通过一次 writev 写入，本次的数据不经过拷贝
+	struct iovec iov[2];
+	iov[0].iov_base = _stage;
+	iov[0].iov_len = _staged;
+	iov[1].iov_base = const_cast<char*>(data);
+	iov[1].iov_len = len;
+	if (_staged > 0) {
+		WriteAll(iov, 2);
+	} else {
+		WriteAll(iov + 1, 1);
+	}
+	_staged = 0;
+}
+
+void zch::FdSink::EmergencyWrite(const char* data, size_t len) {
+	if (_fd < 0) {
+		return;
+	}
+	// 异步线程可能仍在使用暂存区，这里只使用系统调用。
+	// O_DIRECT 的描述符不能写入未对齐的数据，并且没有维护文件偏移量，另外以追加方式打开一次
+	if (!_direct) {
+		CrashHandler::WriteFully(_fd, data, len);
+		return;
+	}
+	int fd = open(_pathname.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+	if (fd >= 0) {
+		CrashHandler::WriteFully(fd, data, len);
+		close(fd);
+	}
+}
+
+void zch::FdSink::Flush() {
+	if (_direct) {
+		FlushDirect();
+		return;
+	}
+	if (_staged > 0) {
+		struct iovec iov;
+		iov.iov_base = _stage;
+		iov.iov_len = _staged;
+		WriteAll(&iov, 1);
+		_staged = 0;
+	}
+}
+
+bool zch::FdSink::WriteAll(struct iovec* iov, int iovcnt) {
+	while (iovcnt > 0) {
+		ssize_t n = writev(_fd, iov, iovcnt);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("FdSink writev fail: ");
+			return false;
+		}
+		// 部分写入：跳过已经写完的部分，继续写入剩余的数据
+		size_t done = static_cast<size_t>(n);
+		while (iovcnt > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			++iov;
+			--iovcnt;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+			iov->iov_len -= done;
+		}
+	}
+	return true;
+}
+
+void zch::FdSink::LogDirect(const char* data, size_t len) {
+	while (len > 0) {
+		size_t n = std::min(len, _stage_cap - _staged);
+		memcpy(_stage + _staged, data, n);
+		_staged += n;
+		data += n;
+		len -= n;
+		// 写入持续失败且暂存区仍然已满时丢弃本条日志的剩余部分，避免一直重试
+		if (_staged == _stage_cap && !FlushDirect() && _staged == _stage_cap) {
+			return;
+		}
+	}
+	if (_staged - _written >= _batch_size) {
+		FlushDirect();
+	}
+}
+
+bool zch::FdSink::FlushDirect() {
+	if (_staged == _written) {
+		return true;
+	}
+	// 1. 末尾不满一块的部分补 0 后连同完整的块一起写入
+	size_t padded = AlignUp(_staged);
+	memset(_stage + _staged, 0, padded - _staged);
+	size_t done = 0;
+	bool ok = true;
+	while (done < padded) {
+		ssize_t n = pwrite(_fd, _stage + done, padded - done, _offset + done);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("FdSink pwrite fail: ");
+			ok = false;
+			break;
+		}
+		done += n;
+	}
+	// 2. 写入了补齐的部分时截断文件，使文件长度与真实数据一致
+	if (done > _staged && ftruncate(_fd, _offset + _staged) != 0) {
+		perror("FdSink ftruncate fail: ");
+	}
+	// 3. 只推进已经完整落地的块；未满的块以及写入失败时尚未落地的数据留在暂存区，
+	//    下次写入时从对齐的位置重新写入
+	size_t durable = std::max(std::min(done, _staged), _written);
+	size_t full = AlignDown(durable);
+	memmove(_stage, _stage + full, _staged - full);
+	_offset += full;
+	_staged -= full;
+	_written = durable - full;
+	return ok;
+}
+
+zch::UringSink::UringSink(const std::string& pathname, size_t depth, size_t buffer_size)
+						: _pathname(pathname)
+						, _fd(-1)
+						, _offset(0)
+						, _slots(depth > 0 ? depth : 1)
+						, _ring(new IoUring(static_cast<unsigned>(_slots.size()))) {
+	// 1. 运行时不支持 io_uring (内核版本过低或被禁用)，退回 write 路径
+	if (!_ring->Available()) {
+		_ring.reset();
+		_fallback.reset(new FdSink(_pathname));
+		return;
+	}
+
+	// 2.检查路径是否存在,不存在就创建
+	if (!zch::File::IsExist(zch::File::GetDirPath(_pathname))) {
+		zch::File::CreateDirectory(zch::File::GetDirPath(_pathname));
+	}
+
+	// 3. 创建并打开文件，多个写请求可能乱序完成，因此不使用 O_APPEND，而是为每个请求指定偏移量
+	_fd = open(_pathname.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		std::cerr << "UringSink中文件打开失败" << std::endl;
+		abort();
+	}
+	struct stat st;
+	if (fstat(_fd, &st) == 0) {
+		_offset = st.st_size;
+	}
+
+	for (auto& slot : _slots) {
+		slot._buf.resize(buffer_size > 0 ? buffer_size : 1);
+		slot._busy = false;
+	}
+}
+
+zch::UringSink::~UringSink() {
+	if (_ring.get() == nullptr) {
+		return;
+	}
+	// 等待超时后放弃仍未完成的请求
+	for (auto& slot : _slots) {
+		while (slot._busy && WaitReap()) {
+		}
+	}
+	close(_fd);
+}
+
+void zch::UringSink::log(const char* data, size_t len) {
+	if (_ring.get() == nullptr) {
+		_fallback->log(data, len);
+		return;
+	}
+	// 超过缓冲区大小的数据拆分为多个写请求
+	while (len > 0) {
+		Slot* slot = AcquireSlot();
+		if (slot == nullptr) {
+			// 写请求长时间没有完成：剩余的数据同步写入
+			if (!PWriteFully(_fd, data, len, _offset)) {
+				perror("UringSink pwrite fail: ");
+			}
+			_offset += len;
+			return;
+		}
+		size_t n = std::min(len, slot->_buf.size());
+		memcpy(slot->_buf.data(), data, n);
+		slot->_iov.iov_base = slot->_buf.data();
+		slot->_iov.iov_len = n;
+		slot->_offset = _offset;
+		slot->_busy = true;
+		_offset += n;
+		// 写缓冲区的数量不超过提交队列的长度，放入请求不会失败
+		_ring->PrepWritev(_fd, &slot->_iov, 1, slot->_offset, slot - _slots.data());
+		if (!_ring->Submit()) {
+			// 提交失败：撤回该请求并同步写入，缓冲区立即可以复用
+			perror("UringSink io_uring_enter fail: ");
+			_ring->DropUnsubmitted();
+			if (!PWriteFully(_fd, slot->_buf.data(), n, slot->_offset)) {
+				perror("UringSink pwrite fail: ");
+			}
+			slot->_busy = false;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+void zch::UringSink::EmergencyWrite(const char* data, size_t len) {
+	if (_ring.get() == nullptr) {
+		_fallback->EmergencyWrite(data, len);
+		return;
+	}
+	// 已经提交的写请求由内核继续完成，这里直接写入其后的位置
+	while (len > 0) {
+		ssize_t n = pwrite(_fd, data, len, _offset);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		_offset += n;
+		data += n;
+		len -= static_cast<size_t>(n);
+	}
+}
+
+zch::UringSink::Slot* zch::UringSink::AcquireSlot() {
+	Reap();
+	while (true) {
+		for (auto& slot : _slots) {
+			if (!slot._busy) {
+				return &slot;
+			}
+		}
+		// 所有缓冲区都在写入中，等待至少一个写请求完成
+		if (!WaitReap()) {
+			return nullptr;
+		}
+	}
+}
+
+bool zch::UringSink::WaitReap() {
+	struct timespec ts = { 0, kUringWaitNanos };
+	for (int i = 0; i < kUringWaitRetries; ++i) {
+		if (Reap() > 0) {
+			return true;
+		}
+		if (!_ring->Submit(1)) {
+			nanosleep(&ts, nullptr);
+		}
+	}
+	return false;
+}
+
+size_t zch::UringSink::Reap() {
+	size_t count = 0;
+	uint64_t user_data;
+	int res;
+	while (_ring->PeekCompletion(user_data, res)) {
+		Slot& slot = _slots[user_data];
+		if (res < 0) {
+			std::cerr << "UringSink写入失败: " << strerror(-res) << std::endl;
+		} else if (static_cast<size_t>(res) < slot._iov.iov_len) {
+			// 部分写入：剩余的数据同步写入
+			const char* rest = static_cast<const char*>(slot._iov.iov_base) + res;
+			if (!PWriteFully(_fd, rest, slot._iov.iov_len - res, slot._offset + res)) {
+				perror("UringSink pwrite fail: ");
+			}
+		}
+		slot._busy = false;
+		++count;
+	}
+	return count;
+}
+
+zch::MmapSink::MmapSink(const std::string& pathname, size_t segment_size)
+					: _pathname(pathname)
+					, _fd(-1)
+					, _segment_size(segment_size)
+					, _page(4096)
+					, _cur(nullptr)
+					, _cur_base(0)
+					, _pos(0)
+					, _synced(0)
+					, _trailer(nullptr)
+					, _trailer_off(0)
+					, _want_next(false)
+					, _failed(false)
+					, _stop(false)
+					, _next(nullptr)
+					, _next_trailer(nullptr)
+					, _retired(nullptr)
+					, _trailer_ready(false) {
+	// 1.检查路径是否存在,不存在就创建
+	if (!zch::File::IsExist(zch::File::GetDirPath(_pathname))) {
+		zch::File::CreateDirectory(zch::File::GetDirPath(_pathname));
+	}
+
+	// 2. 创建并打开文件
+	_fd = open(_pathname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		std::cerr << "MmapSink中文件打开失败" << std::endl;
+		abort();
+	}
+
+	// 3. 映射的起始位置需要按页对齐，段大小也取整为页的整数倍。
+	//    截断上次崩溃留下的预分配部分，保证文件的最后一页始终是本对象的记录页
+	_page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	_segment_size = std::max((_segment_size + _page - 1) / _page * _page, _page);
+	off_t end = DataEnd();
+	if (ftruncate(_fd, end) != 0) {
+		perror("MmapSink ftruncate fail: ");
+	}
+	_cur_base = end / _page * _page;
+	_pos = end - _cur_base;
+	_synced = _pos;
+	_cur = MapSegment(_cur_base, static_cast<uint64_t>(end), kNoTrailer, _trailer);
+	if (_cur == nullptr) {
+		std::cerr << "MmapSink中文件映射失败" << std::endl;
+		abort();
+	}
+	_trailer_off = _cur_base + static_cast<off_t>(_segment_size);
+	Prefault(_cur);
+
+	// 4. 启动辅助线程
+	_td = std::thread(&MmapSink::HelperEntry, this);
+}
+
+zch::MmapSink::~MmapSink() {
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	_td.join();
+	// 截断预分配但未使用的部分(包括记录页)，使文件长度与真实数据一致
+	SyncAsync();
+	munmap(_cur, _segment_size);
+	if (_next != nullptr) {
+		munmap(_next, _segment_size);
+	}
+	if (_retired != nullptr) {
+		munmap(_retired, _segment_size);
+	}
+	if (_next_trailer != nullptr) {
+		munmap(_next_trailer, _page);
+	}
+	munmap(_trailer, _page);
+	if (ftruncate(_fd, _cur_base + _pos) != 0) {
+		perror("MmapSink ftruncate fail: ");
+	}
+	close(_fd);
+}
+
+void zch::MmapSink::log(const char* data, size_t len) {
+	// 辅助线程已经把文件延长到下一段之后，尽快改用新的记录页
+	if (_trailer_ready.load(std::memory_order_acquire)) {
+		std::unique_lock<std::mutex> ulk(_mtx);
+		AdoptTrailer();
+	}
+	while (len > 0) {
+		if (_pos == _segment_size) {
+			NextSegment();
+		}
+		size_t n = std::min(len, _segment_size - _pos);
+		memcpy(_cur + _pos, data, n);
+		_pos += n;
+		data += n;
+		len -= n;
+	}
+	UpdateTrailer();
+
+	// 当前段写过一半时通知辅助线程预先分配并映射下一段，切换时不再等待分配
+	if (!_want_next && _pos >= _segment_size / 2) {
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			_want_next = true;
+		}
+		_cond.notify_all();
+	}
+	// 脏数据累计到一定数量后通知内核开始回写
+	if (_pos - _synced >= kMmapSyncBytes) {
+		SyncAsync();
+	}
+}
+
+void zch::MmapSink::EmergencyWrite(const char* data, size_t len) {
+	if (_cur == nullptr) {
+		return;
+	}
+	size_t n = std::min(len, _segment_size - _pos);
+	memcpy(_cur + _pos, data, n);
+	_pos += n;
+	UpdateTrailer();
+}
+
+void zch::MmapSink::UpdateTrailer() {
+	// 映射区位于页缓存中，一次 8 字节的写入即可在进程崩溃后保留
+	if (_trailer != nullptr) {
+		uint64_t end = static_cast<uint64_t>(_cur_base + _pos);
+		memcpy(_trailer + kMmapTrailerEnd, &end, sizeof(end));
+	}
+}
+
+void zch::MmapSink::AdoptTrailer() {
+	if (_next_trailer == nullptr) {
+		return;
+	}
+	// 新的记录页在写入真实的末尾之前指向旧的记录页，任何时刻崩溃都能找到真实的末尾
+	char* old = _trailer;
+	_trailer = _next_trailer;
+	_next_trailer = nullptr;
+	_trailer_off += static_cast<off_t>(_segment_size);
+	_trailer_ready.store(false, std::memory_order_relaxed);
+	UpdateTrailer();
+	munmap(old, _page);
+}
+
+void zch::MmapSink::SyncAsync() {
+	// MS_ASYNC 只发起回写，不等待完成；msync 的起始地址需要按页对齐
+	size_t begin = _synced / _page * _page;
+	if (_pos > begin) {
+		msync(_cur + begin, _pos - begin, MS_ASYNC);
+	}
+	_synced = _pos;
+}
+
+char* zch::MmapSink::MapSegment(off_t base, uint64_t end, uint64_t prev, char*& trailer) {
+	// 1. 先写入段之后的记录页：文件一次性延长到记录页之后，文件的最后一页始终是有效的记录页
+	off_t tail = base + static_cast<off_t>(_segment_size);
+	std::vector<char> page(_page, '\0');
+	memcpy(&page[0], kMmapTrailerMagic, sizeof(kMmapTrailerMagic));
+	memcpy(&page[kMmapTrailerEnd], &end, sizeof(end));
+	memcpy(&page[kMmapTrailerPrev], &prev, sizeof(prev));
+	if (pwrite(_fd, page.data(), _page, tail) != static_cast<ssize_t>(_page)) {
+		perror("MmapSink pwrite fail: ");
+		return nullptr;
+	}
+	// 2. 预先分配磁盘空间，避免写入映射区时因磁盘空间不足收到 SIGBUS；
+	//    文件系统不支持时文件已经被记录页延长，不需要额外处理
+	int ret = fallocate(_fd, 0, base, _segment_size);
+	if (ret != 0 && errno != EOPNOTSUPP && errno != ENOSYS) {
+		perror("MmapSink fallocate fail: ");
+		return nullptr;
+	}
+	// 3. 映射整段，由 Prefault 分步读入
+	void* p = mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, base);
+	if (p == MAP_FAILED) {
+		perror("MmapSink mmap fail: ");
+		return nullptr;
+	}
+	void* t = mmap(nullptr, _page, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, tail);
+	if (t == MAP_FAILED) {
+		perror("MmapSink mmap fail: ");
+		munmap(p, _segment_size);
+		return nullptr;
+	}
+	trailer = static_cast<char*>(t);
+	return static_cast<char*>(p);
+}
+
+void zch::MmapSink::NextSegment() {
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		// 单条日志超过段大小的一半时可能还没有通知辅助线程
+		if (_next == nullptr && !_failed) {
+			_want_next = true;
+			_cond.notify_all();
+			_cond.wait(ulk, [&]() { return _next != nullptr || _failed; });
+		}
+		if (_next == nullptr) {
+			std::cerr << "MmapSink中文件映射失败" << std::endl;
+			abort();
+		}
+		AdoptTrailer();
+		// 解除映射不会丢失数据，脏页由内核继续回写；旧的段交给辅助线程解除映射
+		SyncAsync();
+		_retired = _cur;
+		_cur = _next;
+		_next = nullptr;
+		_cur_base += _segment_size;
+		_pos = 0;
+		_synced = 0;
+		_want_next = false;
+	}
+	_cond.notify_all();
+}
+
+void zch::MmapSink::HelperEntry() {
+	ThreadInfo::SetName("zchlog-mmap");
+	std::unique_lock<std::mutex> ulk(_mtx);
+	while (true) {
+		_cond.wait(ulk, [&]() { return _stop || _retired != nullptr || (_want_next && _next == nullptr && !_failed); });
+		// 解除旧段的映射
+		if (_retired != nullptr) {
+			char* retired = _retired;
+			_retired = nullptr;
+			ulk.unlock();
+			munmap(retired, _segment_size);
+			ulk.lock();
+			continue;
+		}
+		if (_stop) {
+			break;
+		}
+		// 分配并映射下一段 (期间不持有锁，不阻塞写日志的线程)；
+		// 新的记录页在写日志的线程改用它之前指向当前的记录页
+		off_t base = _cur_base + static_cast<off_t>(_segment_size);
+		uint64_t prev = static_cast<uint64_t>(_trailer_off);
+		ulk.unlock();
+		char* trailer = nullptr;
+		char* next = MapSegment(base, kPendingEnd, prev, trailer);
+		if (next != nullptr) {
+			Prefault(next);
+		}
+		ulk.lock();
+		if (next == nullptr) {
+			_failed = true;
+		} else {
+			_next = next;
+			_next_trailer = trailer;
+			_trailer_ready.store(true, std::memory_order_release);
+		}
+		_cond.notify_all();
+	}
+}
+
+void zch::MmapSink::Prefault(char* seg) {
+	// 以写的方式访问每一页 (写回原值)，写日志的线程写入时不再发生缺页。
+	// 不使用 MAP_POPULATE：整段一次读入是一个很长的系统调用，单核上会长时间占用写日志的线程的 CPU
+	for (size_t step = 0; step < _segment_size; step += kPrefaultStep) {
+		size_t end = std::min(step + kPrefaultStep, _segment_size);
+		for (size_t off = step; off < end; off += _page) {
+			volatile char* p = seg + off;
+			*p = *p;
+		}
+		std::this_thread::yield();
+	}
+}
+
+bool zch::MmapSink::ReadTrailer(off_t offset, uint64_t& end, uint64_t& prev) {
+	char buf[kMmapTrailerPrev + sizeof(uint64_t)];
+	if (offset < 0 || pread(_fd, buf, sizeof(buf), offset) != static_cast<ssize_t>(sizeof(buf))
+		|| memcmp(buf, kMmapTrailerMagic, sizeof(kMmapTrailerMagic)) != 0) {
+		return false;
+	}
+	memcpy(&end, buf + kMmapTrailerEnd, sizeof(end));
+	memcpy(&prev, buf + kMmapTrailerPrev, sizeof(prev));
+	return true;
+}
+
+off_t zch::MmapSink::DataEnd() {
+	struct stat st;
+	if (fstat(_fd, &st) != 0) {
+		return 0;
+	}
+	// 上次没有正常关闭时，文件的最后一页记录了真实数据的末尾 (尚未启用时指向上一个记录页)；
+	// 正常关闭的文件已经截断到真实长度，其他程序写入的文件也没有该记录
+	off_t tail = st.st_size - static_cast<off_t>(_page);
+	uint64_t end = 0;
+	uint64_t prev = 0;
+	if (ReadTrailer(tail, end, prev)) {
+		if (end == kPendingEnd && (prev >= static_cast<uint64_t>(tail) || !ReadTrailer(static_cast<off_t>(prev), end, prev))) {
+			return st.st_size;
+		}
+		if (end <= static_cast<uint64_t>(tail)) {
+			return static_cast<off_t>(end);
+		}
+	}
+	return st.st_size;
+}
+
 zch::RollBySizeSink::RollBySizeSink(const std::string& basename
-                                    , size_t max_size)
+                                    , size_t max_size
+                                    , size_t index_interval)
 	                                :_basename(basename)
                                     , _max_size(max_size)
+                                    , _index_interval(index_interval)
                                     , _cur_size(0)
-                                    , _name_cout(0) {
+                                    , _name_cout(0)
+                                    , _want_next(false)
+                                    , _stop(false)
+                                    , _rolls(0)
+                                    , _stalls(0)
+                                    , _last_ns(0)
+                                    , _max_ns(0)
+                                    , _total_ns(0) {
 	// 1.检查路径是否存在,不存在就创建
 	if (!zch::File::IsExist(zch::File::GetDirPath(_basename))) {
 		zch::File::CreateDirectory(zch::File::GetDirPath(_basename));
 	}
 
-	// 2. 获得文件名
-	std::string filename = GetFileName();
+	// 2. 创建并打开第一个文件
+	_file = OpenFile();
 
-	// 3. 创建并打开文件
-	_ofs.open(filename, std::ios::binary | std::ios::app);
-	assert(_ofs.is_open());
+	// 3. 启动辅助线程
+	_td = std::thread(&RollBySizeSink::HelperEntry, this);
+}
+
+zch::RollBySizeSink::~RollBySizeSink() {
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	_td.join();
+	// 预先创建但没有使用的文件
+	if (_next) {
+		std::string name = _next->_name;
+		_next.reset();
+		unlink(name.c_str());
+		unlink(TimeIndex::IndexPath(name).c_str());
+	}
 }
 
 void zch::RollBySizeSink::log(const char* data, size_t len) {
 	// 判断文件是否超出大小
 	if (_cur_size >= _max_size) {
+		Roll();
+	} else if (_cur_size >= _max_size / 2 && !_want_next) {
+		// 当前文件写过一半，通知辅助线程准备下一个文件
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			_want_next = true;
+		}
+		_cond.notify_all();
+	}
+	_file->_ofs.write(data, len);
+	_cur_size += len;
+	if (_file->_index) {
+		_file->_index->Written(len);
+	}
+}
+
+void zch::RollBySizeSink::Flush() {
+	if (_file != nullptr) {
+		_file->_ofs.flush();
+	}
+}
+
+zch::RollBySizeSink::RollStats zch::RollBySizeSink::Stats() const {
+	RollStats stats;
+	stats._rolls = _rolls.load(std::memory_order_relaxed);
+	stats._stalls = _stalls.load(std::memory_order_relaxed);
+	stats._last_ns = _last_ns.load(std::memory_order_relaxed);
+	stats._max_ns = _max_ns.load(std::memory_order_relaxed);
+	stats._total_ns = _total_ns.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void zch::RollBySizeSink::Roll() {
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		// 单条日志超过文件大小的一半时可能还没有通知辅助线程
+		if (!_want_next) {
+			_want_next = true;
+			_cond.notify_all();
+		}
+		if (!_next) {
+			_stalls.fetch_add(1, std::memory_order_relaxed);
+			_cond.wait(ulk, [&]() { return _next != nullptr; });
+		}
+		// 旧文件交给辅助线程关闭 (关闭时需要将流缓冲区中的数据写入文件)
+		_retired.push_back(std::move(_file));
+		_file = std::move(_next);
+		_want_next = false;
+	}
+	_cond.notify_all();
+	// 由于是新文件，所以将当前文件已写入的大小置 0
+	_cur_size = 0;
+
+	uint64_t cost = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	_rolls.fetch_add(1, std::memory_order_relaxed);
+	_total_ns.fetch_add(cost, std::memory_order_relaxed);
+	_last_ns.store(cost, std::memory_order_relaxed);
+	if (cost > _max_ns.load(std::memory_order_relaxed)) {
+		_max_ns.store(cost, std::memory_order_relaxed);
+	}
+}
+
+std::unique_ptr<zch::RollBySizeSink::OpenedFile> zch::RollBySizeSink::OpenFile() {
+	std::unique_ptr<OpenedFile> file(new OpenedFile());
+	file->_name = GetFileName();
+	const std::string& filename = file->_name;
+	// 预先为文件分配磁盘空间(不改变文件大小)，写入时不再需要分配块
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if (fd >= 0) {
+		fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, _max_size);
+		close(fd);
+	}
+	file->_ofs.open(filename, std::ios::binary | std::ios::app);
+	if (!file->_ofs.is_open()) {
+		std::cerr << "RollBySizeSink中文件打开失败" << std::endl;
+		abort();
+	}
+	if (_index_interval > 0) {
+		file->_index.reset(new TimeIndex(filename, _index_interval));
+	}
+	return file;
+}
+
+std::string zch::RollBySizeSink::GetFileName() {
+	return RollFileName(_basename, Date::Now(), _name_cout++);
+}
+
+void zch::RollBySizeSink::HelperEntry() {
+	ThreadInfo::SetName("zchlog-roll");
+	std::unique_lock<std::mutex> ulk(_mtx);
+	while (true) {
+		_cond.wait(ulk, [&]() { return _stop || !_retired.empty() || (_want_next && !_next); });
 		// 关闭旧文件
-		_ofs.close();
+		if (!_retired.empty()) {
+			std::vector<std::unique_ptr<OpenedFile>> retired;
+			retired.swap(_retired);
+			ulk.unlock();
+			retired.clear();
+			ulk.lock();
+			continue;
+		}
+		if (_stop) {
+			break;
+		}
+		// 创建下一个文件 (创建期间不持有锁，不阻塞写日志的线程)
+		ulk.unlock();
+		std::unique_ptr<OpenedFile> next = OpenFile();
+		ulk.lock();
+		_next = std::move(next);
+		_cond.notify_all();
+	}
+}
+
+zch::RollingFileSink::RollingFileSink(const std::string& basename
+									, size_t max_size
+									, RollPeriod period
+									, size_t max_files
+									, size_t max_bytes
+									, bool compress
+									, size_t index_interval)
+									: _basename(basename)
+									, _max_size(max_size)
+									, _period(period)
+									, _max_files(max_files)
+									, _max_bytes(max_bytes)
+									, _compress(compress)
+									, _index_interval(index_interval)
+									, _cur_size(0)
+									, _next_roll(0)
+									, _last_name_time(0)
+									, _name_count(0)
+									, _stop(false) {
+	// 1.检查路径是否存在,不存在就创建
+	if (!zch::File::IsExist(zch::File::GetDirPath(_basename))) {
+		zch::File::CreateDirectory(zch::File::GetDirPath(_basename));
+	}
+
+	// 2. 打开第一个文件
+	Roll(Date::Now());
+	_first_path = _cur_path;
+
+	// 3. 启动辅助线程 (同时会处理上次运行遗留的未压缩文件以及超出保留限制的文件)
+	_td = std::thread(&RollingFileSink::HelperEntry, this);
+}
+
+zch::RollingFileSink::~RollingFileSink() {
+	_file.reset();
+	_index.reset();
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	_td.join();
+}
 
-		std::string filename = GetFileName();
-		_ofs.open(filename, std::ios::binary | std::ios::app);
-		assert(_ofs.is_open());
-		// 由于是新文件，所以将当前文件已写入的大小置 0
-		_cur_size = 0;
+void zch::RollingFileSink::log(const char* data, size_t len) {
+	// 判断是否到达时间边界或者文件超出大小
+	time_t now = Date::Now();
+	if (now >= _next_roll || (_max_size > 0 && _cur_size >= _max_size)) {
+		Roll(now);
 	}
-	_ofs.write(data, len);
+	_file->log(data, len);
 	_cur_size += len;
+	if (_index) {
+		_index->Written(len);
+	}
 }
 
-std::string zch::RollBySizeSink::GetFileName() {
-	std::stringstream ssm;
-	struct tm t = Date::GetTimeSet();
-	ssm << _basename;
-	ssm << '-';
-	ssm << t.tm_year + 1900;
-	ssm << t.tm_mon + 1;
-	ssm << t.tm_mday;
-	ssm << '_';
-	ssm << t.tm_hour;
-	ssm << t.tm_min;
-	ssm << t.tm_sec;
-	ssm << '-';
-	ssm << std::to_string(_name_cout++);
-	ssm << ".log";
-	return ssm.str();
+void zch::RollingFileSink::EmergencyWrite(const char* data, size_t len) {
+	if (_file) {
+		_file->EmergencyWrite(data, len);
+	}
+}
+
+void zch::RollingFileSink::Roll(time_t now) {
+	std::string filename = GetFileName(now);
+	std::string closed;
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		closed.swap(_cur_path);
+		_cur_path = filename;
+	}
+	// 关闭旧文件并打开新文件
+	_file.reset(new FdSink(filename));
+	_index.reset(_index_interval > 0 ? new TimeIndex(filename, _index_interval) : nullptr);
+	_cur_size = 0;
+	_next_roll = NextBoundary(now);
+
+	// 旧文件交给辅助线程处理
+	if (!closed.empty()) {
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			_closed.push_back(closed);
+		}
+		_cond.notify_one();
+	}
+}
+
+std::string zch::RollingFileSink::GetFileName(time_t now) {
+	// 同一秒内创建多个文件时使用递增的序号区分
+	_name_count = (now == _last_name_time) ? _name_count + 1 : 0;
+	_last_name_time = now;
+	return RollFileName(_basename, now, _name_count);
+}
+
+time_t zch::RollingFileSink::NextBoundary(time_t now) {
+	if (_period == RollPeriod::NONE) {
+		return std::numeric_limits<time_t>::max();
+	}
+	// 按照本地时间计算下一个整点或者零点 (由 mktime 处理夏令时)
+	struct tm t;
+	localtime_r(&now, &t);
+	t.tm_min = 0;
+	t.tm_sec = 0;
+	if (_period == RollPeriod::HOURLY) {
+		t.tm_hour += 1;
+	} else {
+		t.tm_hour = 0;
+		t.tm_mday += 1;
+	}
+	t.tm_isdst = -1;
+	return mktime(&t);
+}
+
+void zch::RollingFileSink::HelperEntry() {
+	// 压缩与删除不能与业务线程争抢资源：降低 CPU 与 IO 优先级
+	// (Linux 中 setpriority 作用于单个线程；IO 优先级设置为 idle 类)
+	ThreadInfo::SetName("zchlog-roll");
+	setpriority(PRIO_PROCESS, ThreadInfo::Tid(), 19);
+	syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, 3 << 13 /* IOPRIO_CLASS_IDLE */);
+
+	// 上次运行遗留的未压缩文件：只处理名称排在本对象第一个文件之前的文件 (文件名按时间排序)。
+	// 列出目录时写日志的线程可能已经滚动到新的文件，它与之后关闭的文件都由下面的循环处理
+	if (_compress) {
+		for (auto& file : ListFiles()) {
+			if (EndsWith(file.first, ".log") && file.first < _first_path) {
+				Compress(file.first);
+			}
+		}
+	}
+	EnforceRetention();
+
+	while (true) {
+		std::string path;
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			_cond.wait(ulk, [&]() { return _stop || !_closed.empty(); });
+			if (_closed.empty()) {
+				break;
+			}
+			path = _closed.front();
+			_closed.pop_front();
+		}
+		if (_compress) {
+			Compress(path);
+		}
+		EnforceRetention();
+	}
+}
+
+void zch::RollingFileSink::Compress(const std::string& path) {
+	std::string gz = path + ".gz";
+	std::string tmp = gz + ".tmp";
+	int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in < 0) {
+		return;
+	}
+	gzFile out = gzopen(tmp.c_str(), "wb6");
+	if (out == nullptr) {
+		close(in);
+		return;
+	}
+	bool ok = true;
+	char buf[64 * 1024];
+	while (true) {
+		ssize_t n = read(in, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			ok = (n == 0);
+			break;
+		}
+		if (gzwrite(out, buf, static_cast<unsigned>(n)) != n) {
+			ok = false;
+			break;
+		}
+	}
+	close(in);
+	ok = (gzclose(out) == Z_OK) && ok;
+	// 压缩完成后再替换，中途失败时保留原文件
+	if (ok && rename(tmp.c_str(), gz.c_str()) == 0) {
+		unlink(path.c_str());
+	} else {
+		std::cerr << "RollingFileSink压缩失败: " << path << std::endl;
+		unlink(tmp.c_str());
+	}
+}
+
+void zch::RollingFileSink::EnforceRetention() {
+	if (_max_files == 0 && _max_bytes == 0) {
+		return;
+	}
+	std::vector<std::pair<std::string, off_t>> files = ListFiles();
+	std::string active;
+	{
+		std::unique_lock<std::mutex> ulk(_mtx);
+		active = _cur_path;
+	}
+	size_t count = files.size();
+	size_t bytes = 0;
+	for (auto& file : files) {
+		bytes += file.second;
+	}
+	// 从最早的文件开始删除，正在写入以及等待压缩的文件除外
+	for (auto& file : files) {
+		bool over_count = _max_files > 0 && count > _max_files;
+		bool over_bytes = _max_bytes > 0 && bytes > _max_bytes;
+		if (!over_count && !over_bytes) {
+			break;
+		}
+		if (file.first == active) {
+			continue;
+		}
+		{
+			std::unique_lock<std::mutex> ulk(_mtx);
+			if (std::find(_closed.begin(), _closed.end(), file.first) != _closed.end()) {
+				continue;
+			}
+		}
+		if (unlink(file.first.c_str()) == 0) {
+			// 时间索引随日志文件一起删除 (不存在时忽略)
+			unlink(TimeIndex::IndexPath(file.first).c_str());
+			--count;
+			bytes -= file.second;
+		}
+	}
+}
+
+std::vector<std::pair<std::string, off_t>> zch::RollingFileSink::ListFiles() {
+	std::vector<std::pair<std::string, off_t>> files;
+	std::string dir = zch::File::GetDirPath(_basename);
+	size_t pos = _basename.find_last_of("/\\");
+	std::string prefix = (pos == std::string::npos ? _basename : _basename.substr(pos + 1)) + "-";
+	DIR* dp = opendir(dir.c_str());
+	if (dp == nullptr) {
+		return files;
+	}
+	while (struct dirent* entry = readdir(dp)) {
+		std::string name = entry->d_name;
+		if (name.compare(0, prefix.size(), prefix) != 0 || !IsRollFileSuffix(name, prefix.size())) {
+			continue;
+		}
+		// 与 _basename 的拼接方式一致，便于和 _cur_path 比较
+		std::string path = (pos == std::string::npos ? "" : _basename.substr(0, pos + 1)) + name;
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+			files.push_back(std::make_pair(path, st.st_size));
+		}
+	}
+	closedir(dp);
+	// 文件名中的时间与序号补 0 对齐，按名称排序即按时间排序
+	std::sort(files.begin(), files.end());
+	return files;
 }
 
 // zch::MySQLSink::MySQLSink() {
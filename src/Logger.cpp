@@ -1,157 +1,686 @@
+#include <algorithm>
+#include <cstring>
+
 #include "../include/Logger.h"
 
-void zch::Logger::Debug(const std::string& file, size_t line, const char* fmt, ...) {
-	// 1. 判断当前日志能否输出
-	if (LogLevel::Level::DEBUG < _limit_level) {
+namespace {
+
+	// 延迟格式化模式下放入异步缓冲区的记录头
+	struct RecordHeader {
+		uint32_t _len;					// 记录总长度(包括记录头)
+		uint32_t _kind;					// 记录类型
+		zch::LogLevel::Level _level;	// 日志等级 (按落地方向的等级分发时使用)
+		const zch::CallSite* _site;		// 调用点(调用点是静态对象，其地址在进程内就是唯一标识)
+		time_t _ctime;					// 时间戳(秒)
+		long _nsec;						// 时间戳(秒内的纳秒数)
+		uint32_t _tid;					// 内核线程id
+		const char* _tname;				// 线程名称
+	};
+
+	// 已经在调用线程中格式化完毕的日志消息字符串
+	const uint32_t kTextRecord = 0;
+	// 调用点 + 参数原始字节，由异步线程进行格式化
+	const uint32_t kDeferredRecord = 1;
+
+	// 分发记录的头部，其后依次为每个格式化器的渲染结果 (4 字节长度 + 内容，
+	// 记录等级不需要的格式化器长度为 0)
+	struct RoutedHeader {
+		uint32_t _len;					// 记录总长度(包括头部)
+		zch::LogLevel::Level _level;	// 日志等级
+	};
+
+	// 以下为调用线程的暂存区，均复用其容量，稳态下每条日志不产生堆分配
+	// 形成有效载荷时 vsnprintf 的输出缓冲区
+	thread_local char t_payload[4096];
+	// 日志消息结构体
+	thread_local zch::LogMsg t_msg;
+	// 格式化后的日志消息字符串
+	thread_local std::string t_line;
+	// 延迟格式化模式下拼装记录的缓冲区
+	thread_local std::string t_record;
+	// 追加采样率后的结构化字段
+	thread_local std::vector<zch::Field> t_fields;
+
+	// 暂存区最多长期保留的容量，超长消息使用后释放
+	const size_t kMaxRetained = 64 * 1024;
+}
+
+void zch::Logger::Debug(const CallSite* site, const char* fmt, ...) {
+	// 判断当前日志能否输出
+	double rate = 0;
+	if (!Enabled(LogLevel::Level::DEBUG) || Suppressed(site) || !Sample(LogLevel::Level::DEBUG, site, rate)) {
 		return;
 	}
+	// 被采样的日志附带采样率
+	const Field field("sample_rate", rate);
 
-	// 2. 形成有效载荷字符串
 	va_list ap;
 	va_start(ap, fmt);
-	char* payload = NULL;
-    // 第一个参数：存储格式化后的字符串
-    // 第二个参数：是格式化字符串，包含要打印的文本和格式说明符
-    // 第三个参数：vs_list 类型的可变参数列表
-    // vasprintf 会根据 fmt 字符串和可变参数列表 ap 的内容动
-    // 态分配足够的内存来存储格式化后的字符串，并将地址存储在 payload 
-    // 指向的指针中。如果成功，它会返回格式化后的字符串的长度；如果失败，
-    // 它会返回 -1。
-	if (vasprintf(&payload, fmt, ap) == -1) {
-		perror("vasprintf fail: ");
-		return;
-	}
+	LogV(LogLevel::Level::DEBUG, site, &field, rate > 0 ? 1 : 0, fmt, ap);
 	va_end(ap);
-
-	// 3. 形成 LogMsg 结构体
-	LogMsg msg(LogLevel::Level::DEBUG, _logger, file, line, std::string(payload));
-	// 4. 形成日志消息字符串
-	std::string log_message = _formatter->Format(msg);
-	// 5. 将日志消息字符串进行落地
-	log(log_message.c_str(), log_message.size());
-	free(payload);
 }
 
-void zch::Logger::Info(const std::string& file, size_t line, const char* fmt, ...) {
-	// 1. 判断当前日志能否输出
-	if (LogLevel::Level::INFO < _limit_level) {
+void zch::Logger::Info(const CallSite* site, const char* fmt, ...) {
+	// 判断当前日志能否输出
+	double rate = 0;
+	if (!Enabled(LogLevel::Level::INFO) || Suppressed(site) || !Sample(LogLevel::Level::INFO, site, rate)) {
 		return;
 	}
+	// 被采样的日志附带采样率
+	const Field field("sample_rate", rate);
 
-	// 2. 形成有效载荷字符串
 	va_list ap;
 	va_start(ap, fmt);
-	char* payload = NULL;
-	if (vasprintf(&payload, fmt, ap) == -1) {
-		perror("vasprintf fail: ");
+	LogV(LogLevel::Level::INFO, site, &field, rate > 0 ? 1 : 0, fmt, ap);
+	va_end(ap);
+}
+
+void zch::Logger::Warn(const CallSite* site, const char* fmt, ...) {
+	// 判断当前日志能否输出
+	double rate = 0;
+	if (!Enabled(LogLevel::Level::WARN) || Suppressed(site) || !Sample(LogLevel::Level::WARN, site, rate)) {
 		return;
 	}
-	va_end(ap);
+	// 被采样的日志附带采样率
+	const Field field("sample_rate", rate);
 
-	// 3. 形成LogMsg结构体
-	LogMsg msg(LogLevel::Level::INFO, _logger, file, line, std::string(payload));
-	// 4. 形成日志消息字符串
-	std::string log_message = _formatter->Format(msg);
-	// 5. 将日志消息字符串进行落地
-	log(log_message.c_str(), log_message.size());
-	free(payload);
+	va_list ap;
+	va_start(ap, fmt);
+	LogV(LogLevel::Level::WARN, site, &field, rate > 0 ? 1 : 0, fmt, ap);
+	va_end(ap);
 }
 
-void zch::Logger::Warn(const std::string& file, size_t line, const char* fmt, ...) {
-	// 1. 判断当前日志能否输出
-	if (LogLevel::Level::WARN < _limit_level) {
+void zch::Logger::Error(const CallSite* site, const char* fmt, ...) {
+	// 判断当前日志能否输出
+	double rate = 0;
+	if (!Enabled(LogLevel::Level::ERROR) || Suppressed(site) || !Sample(LogLevel::Level::ERROR, site, rate)) {
 		return;
 	}
+	// 被采样的日志附带采样率
+	const Field field("sample_rate", rate);
 
-	// 2. 形成有效载荷字符串
 	va_list ap;
 	va_start(ap, fmt);
-	char* payload = NULL;
-	if (vasprintf(&payload, fmt, ap) == -1) {
-		perror("vasprintf fail: ");
+	LogV(LogLevel::Level::ERROR, site, &field, rate > 0 ? 1 : 0, fmt, ap);
+	va_end(ap);
+}
+
+void zch::Logger::Fatal(const CallSite* site, const char* fmt, ...) {
+	// 判断当前日志能否输出
+	double rate = 0;
+	if (!Enabled(LogLevel::Level::FATAL) || Suppressed(site) || !Sample(LogLevel::Level::FATAL, site, rate)) {
 		return;
 	}
-	va_end(ap);
+	// 被采样的日志附带采样率
+	const Field field("sample_rate", rate);
 
-	// 3. 形成LogMsg结构体
-	LogMsg msg(LogLevel::Level::WARN, _logger, file, line, std::string(payload));
-	// 4. 形成日志消息字符串
-	std::string log_message = _formatter->Format(msg);
-	// 5. 将日志消息字符串进行落地
-	log(log_message.c_str(), log_message.size());
-	free(payload);
+	va_list ap;
+	va_start(ap, fmt);
+	LogV(LogLevel::Level::FATAL, site, &field, rate > 0 ? 1 : 0, fmt, ap);
+	va_end(ap);
 }
 
-void zch::Logger::Error(const std::string& file, size_t line, const char* fmt, ...) {
-	// 1. 判断当前日志能否输出
-	if (LogLevel::Level::ERROR < _limit_level) {
+void zch::Logger::Sampled(LogLevel::Level level, const CallSite* site, double rate, const char* fmt, ...) {
+	if (!Enabled(level)) {
 		return;
 	}
+	const Field field("sample_rate", rate);
 
-	// 2. 形成有效载荷字符串
 	va_list ap;
 	va_start(ap, fmt);
-	char* payload = NULL;
-	if (vasprintf(&payload, fmt, ap) == -1) {
-		perror("vasprintf fail: ");
+	LogV(level, site, &field, 1, fmt, ap);
+	va_end(ap);
+}
+
+void zch::Logger::LogSampledFields(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n, double rate) {
+	if (rate <= 0) {
+		LogFieldsV(level, site, msg, fields, n);
 		return;
 	}
-	va_end(ap);
+	// 字段数组由调用者提供，拷贝到线程局部的数组中再追加采样率
+	std::vector<Field>& all = t_fields;
+	all.assign(fields, fields + n);
+	all.push_back(Field("sample_rate", rate));
+	LogFieldsV(level, site, msg, all.data(), all.size());
+}
+
+bool zch::Logger::Deduplicate(const CallSite* site) {
+	uint64_t repeated = 0, elapsed_ms = 0;
+	if (_dedup->Suppress(site, repeated, elapsed_ms)) {
+		return true;
+	}
+	if (repeated > 0) {
+		ReportRepeated(site, repeated, elapsed_ms);
+	}
+	return false;
+}
 
-	// 3. 形成LogMsg结构体
-	LogMsg msg(LogLevel::Level::ERROR, _logger, file, line, std::string(payload));
-	// 4. 形成日志消息字符串
-	std::string log_message = _formatter->Format(msg);
-	// 5. 将日志消息字符串进行落地
-	log(log_message.c_str(), log_message.size());
-	free(payload);
+void zch::Logger::ReportRepeated(const CallSite* site, uint64_t repeated, uint64_t elapsed_ms) {
+	// 以调用点自身的等级与位置输出，便于与被合并的日志对应
+	char buf[96];
+	snprintf(buf, sizeof(buf), "message repeated %llu times in %llu ms"
+			, static_cast<unsigned long long>(repeated), static_cast<unsigned long long>(elapsed_ms));
+	LogFieldsV(site->_level, site, buf, nullptr, 0);
 }
 
-void zch::Logger::Fatal(const std::string& file, size_t line, const char* fmt, ...) {
-	// 1. 判断当前日志能否输出
-	if (LogLevel::Level::FATAL < _limit_level) {
+void zch::Logger::FlushRepeated() {
+	if (_dedup == nullptr) {
 		return;
 	}
+	_dedup->Drain([this](const CallSite* site, uint64_t repeated, uint64_t elapsed_ms) {
+		ReportRepeated(site, repeated, elapsed_ms);
+	});
+}
 
-	// 2. 形成有效载荷字符串
-	va_list ap;
-	va_start(ap, fmt);
-	char* payload = NULL;
-	if (vasprintf(&payload, fmt, ap) == -1) {
-		perror("vasprintf fail: ");
+void zch::Logger::LogV(LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap) {
+	// 线程局部的日志消息字符串，clear 保留容量，稳态下不产生堆分配
+	std::string& log_message = t_line;
+	log_message.clear();
+	if (!FormatV(log_message, level, site, fields, nfields, fmt, ap)) {
 		return;
 	}
-	va_end(ap);
+	// 将日志消息字符串进行落地
+	log(level, log_message.data(), log_message.size());
+}
 
-	// 3. 形成LogMsg结构体
-	LogMsg msg(LogLevel::Level::FATAL, _logger, file, line, std::string(payload));
-	// 4. 形成日志消息字符串
-	std::string log_message = _formatter->Format(msg);
+bool zch::Logger::FormatV(std::string& out, LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap) {
+	// 1. 形成有效载荷字符串：vsnprintf 直接写入线程局部的暂存区，
+	//    只有超出暂存区的超长消息才需要额外分配内存
+	va_list cp;
+	va_copy(cp, ap);
+	int n = vsnprintf(t_payload, sizeof(t_payload), fmt, ap);
+	if (n < 0) {
+		va_end(cp);
+		perror("vsnprintf fail: ");
+		return false;
+	}
 
-	// 5. 将日志消息字符串进行落地
-	log(log_message.c_str(), log_message.size());
-	free(payload);
+	// 2. 形成 LogMsg 结构体 (文件名、行号等元数据由调用点提供，只需保存指针；
+	//    有效载荷复用线程局部对象中字符串的容量)
+	LogMsg& msg = t_msg;
+	Clock::Now(_clock, msg._ctime, msg._nsec);
+	msg._site = site;
+	msg._logger = &_logger;
+	msg._tid = ThreadInfo::Tid();
+	msg._tname = ThreadInfo::Name();
+	msg._fields = fields;
+	msg._nfields = nfields;
+	if (static_cast<size_t>(n) < sizeof(t_payload)) {
+		msg._payload.assign(t_payload, n);
+	} else {
+		msg._payload.resize(n + 1);
+		vsnprintf(&msg._payload[0], n + 1, fmt, cp);
+		msg._payload.resize(n);
+	}
+	va_end(cp);
+
+	// 3. 形成日志消息字符串 (字段只在本次调用期间有效)
+	Render(out, level, msg);
+	msg._fields = nullptr;
+	msg._nfields = 0;
+
+	// 超长消息用完后释放其内存，避免线程局部对象长期占用
+	if (msg._payload.capacity() > kMaxRetained) {
+		std::string().swap(msg._payload);
+	}
+	return true;
 }
 
-void zch::SyncLogger::log(const char* data, size_t len) {
-	std::unique_lock<std::mutex> ulk(_mtx);
+void zch::Logger::LogFieldsV(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n) {
+	std::string& log_message = t_line;
+	log_message.clear();
+	FormatFields(log_message, level, site, msg, fields, n);
+	log(level, log_message.data(), log_message.size());
+}
+
+void zch::Logger::FormatFields(std::string& out, LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n) {
+	// 消息原样作为有效载荷，字段由格式化器直接序列化到输出中
+	LogMsg& lm = t_msg;
+	Clock::Now(_clock, lm._ctime, lm._nsec);
+	lm._site = site;
+	lm._logger = &_logger;
+	lm._tid = ThreadInfo::Tid();
+	lm._tname = ThreadInfo::Name();
+	lm._payload.assign(msg != nullptr ? msg : "");
+	lm._fields = fields;
+	lm._nfields = n;
+	Render(out, level, lm);
+	// 字段只在本次调用期间有效
+	lm._fields = nullptr;
+	lm._nfields = 0;
+	if (lm._payload.capacity() > kMaxRetained) {
+		std::string().swap(lm._payload);
+	}
+}
+
+void zch::Logger::Render(std::string& out, LogLevel::Level level, const LogMsg& msg) {
+	if (!_routed) {
+		_formatter->Format(out, msg);
+		return;
+	}
+	RoutedHeader hdr;
+	hdr._level = level;
+	size_t start = out.size();
+	out.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+	for (auto& route : _routes) {
+		uint32_t seg_len = 0;
+		size_t seg = out.size();
+		out.append(reinterpret_cast<const char*>(&seg_len), sizeof(seg_len));
+		if (level < route._level) {
+			continue;
+		}
+		route._formatter->Format(out, msg);
+		seg_len = static_cast<uint32_t>(out.size() - seg - sizeof(seg_len));
+		memcpy(&out[seg], &seg_len, sizeof(seg_len));
+	}
+	hdr._len = static_cast<uint32_t>(out.size() - start);
+	memcpy(&out[start], &hdr, sizeof(hdr));
+}
+
+void zch::Logger::Deliver(const char* data, size_t len, std::vector<std::string>& outputs) {
+	if (!_routed) {
+		for (auto& sink : _sinks) {
+			if (sink.get() != nullptr) {
+				sink->log(data, len);
+			}
+		}
+		return;
+	}
+	// 把每条分发记录中的渲染结果追加到需要它的通道中，保持每个落地方向中日志的顺序
+	outputs.resize(_channels.size());
+	for (auto& output : outputs) {
+		output.clear();
+	}
+	RoutedHeader hdr;
+	while (len >= sizeof(hdr)) {
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr._len < sizeof(hdr) || hdr._len > len) {
+			break;
+		}
+		const char* seg = data + sizeof(hdr);
+		const char* end = data + hdr._len;
+		for (auto& route : _routes) {
+			uint32_t seg_len = 0;
+			if (static_cast<size_t>(end - seg) < sizeof(seg_len)) {
+				break;
+			}
+			memcpy(&seg_len, seg, sizeof(seg_len));
+			seg += sizeof(seg_len);
+			if (seg_len > static_cast<size_t>(end - seg)) {
+				break;
+			}
+			for (size_t idx : route._channels) {
+				if (hdr._level >= _channels[idx]._level) {
+					outputs[idx].append(seg, seg_len);
+				}
+			}
+			seg += seg_len;
+		}
+		data += hdr._len;
+		len -= hdr._len;
+	}
+	for (size_t i = 0; i < _channels.size(); ++i) {
+		if (outputs[i].empty()) {
+			continue;
+		}
+		for (auto& sink : _channels[i]._sinks) {
+			sink->log(outputs[i].data(), outputs[i].size());
+		}
+		if (outputs[i].capacity() > kMaxRetained) {
+			std::string().swap(outputs[i]);
+		}
+	}
+}
+
+void zch::Logger::InitRoutes(const std::vector<SinkConfig>& configs) {
+	// 使用日志器的格式化器并且接收所有等级的落地方向与 sinks 相同
+	std::vector<const SinkConfig*> routed;
+	for (auto& config : configs) {
+		if (config._sink.get() == nullptr) {
+			continue;
+		}
+		if ((config._formatter.get() == nullptr || config._formatter == _formatter) && config._level <= LogLevel::Level::DEBUG) {
+			_sinks.push_back(config._sink);
+		} else {
+			routed.push_back(&config);
+		}
+	}
+	if (routed.empty()) {
+		return;
+	}
+
+	// 通道只记录落地方向自身的等级，日志器的限制等级在调用时统一判断，运行期修改后同样对所有落地方向生效
+	auto add = [this](const Formatter::ptr& formatter, LogLevel::Level level, const LogSink::ptr& sink) {
+		size_t r = 0;
+		while (r < _routes.size() && _routes[r]._formatter != formatter) {
+			++r;
+		}
+		if (r == _routes.size()) {
+			_routes.push_back(Route{ formatter, level, std::vector<size_t>() });
+		}
+		Route& route = _routes[r];
+		route._level = std::min(route._level, level);
+		for (size_t idx : route._channels) {
+			if (_channels[idx]._level == level) {
+				_channels[idx]._sinks.push_back(sink);
+				return;
+			}
+		}
+		route._channels.push_back(_channels.size());
+		_channels.push_back(Channel{ level, std::vector<LogSink::ptr>(1, sink) });
+	};
 	for (auto& sink : _sinks) {
 		if (sink.get() != nullptr) {
-			sink->log(data, len);
+			add(_formatter, LogLevel::Level::UNKONWN, sink);
 		}
 	}
+	for (auto config : routed) {
+		add(config->_formatter.get() != nullptr ? config->_formatter : _formatter, config->_level, config->_sink);
+	}
+	_routed = true;
+
+	// 低于所有落地方向等级的日志在格式化之前就被过滤
+	_sink_floor = LogLevel::Level::OFF;
+	for (auto& route : _routes) {
+		_sink_floor = std::min(_sink_floor, route._level);
+	}
+	SetLevel(_limit_level.load(std::memory_order_relaxed));
+}
+
+void zch::Logger::SetLevel(LogLevel::Level level) {
+	_limit_level.store(std::max(level, _sink_floor), std::memory_order_relaxed);
+}
+
+void zch::SyncLogger::log(LogLevel::Level level, const char* data, size_t len) {
+	std::unique_lock<std::mutex> ulk(_mtx);
+	Deliver(data, len, _outputs);
 }
 
-void zch::AsyncLogger::RealSink(Buffer& buf) {
-	// 异步线程根据落地方向进行数据落地
+zch::AsyncLogger::AsyncLogger(const std::string logger
+							, zch::LogLevel::Level level
+							, zch::Formatter::ptr formatter
+							, std::vector<zch::LogSink::ptr> sinks
+							, ASYNCTYPE type
+							, bool deferred
+							, ClockType clock
+							, size_t shards
+							, const OverflowOptions& overflow
+							, const std::vector<SinkConfig>& configs
+							, std::chrono::milliseconds dedup_window
+							, const Sampler::ptr& sampler
+							, const CrashOptions& crash)
+							: Logger(logger, level, formatter, sinks, clock, configs, dedup_window, sampler)
+							, _deferred(deferred)
+							, _crash(crash) {
+	if (shards == 0) {
+		shards = 1;
+	}
+	// 先构造全部分片再启动异步线程，log 接口不会看到尚未构造完毕的分片集合
+	for (size_t i = 0; i < shards; ++i) {
+		_shards.emplace_back(new Shard());
+	}
+	for (auto& shard : _shards) {
+		shard->_lopper.reset(new AsynLopper(std::bind(&AsyncLogger::RealSink, this, shard.get(), std::placeholders::_1)
+				, type, overflow, std::bind(&AsyncLogger::ReportDropped, this, shard.get(), std::placeholders::_1)
+				, std::bind(&AsyncLogger::FlushSinks, this)));
+	}
+	if (_crash._drain || _crash._ring) {
+		CrashHandler::Install();
+		CrashHandler::Register(this);
+	}
+}
+
+void zch::AsyncLogger::LogV(LogLevel::Level level, const CallSite* site, const Field* fields, size_t nfields, const char* fmt, va_list ap) {
+	if (!_deferred) {
+		std::string& log_message = t_line;
+		log_message.clear();
+		if (!FormatV(log_message, level, site, fields, nfields, fmt, ap)) {
+			return;
+		}
+		Push(level, log_message.data(), log_message.size());
+		return;
+	}
+
+	RecordHeader hdr;
+	hdr._level = level;
+	hdr._site = site;
+	Clock::Now(_clock, hdr._ctime, hdr._nsec);
+	hdr._tid = ThreadInfo::Tid();
+	hdr._tname = ThreadInfo::Name();
+	t_record.assign(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+	// 格式串必须与调用点注册时的格式串相同(字符串常量)，才能由异步线程根据调用点还原；
+	// 字段只在调用期间有效，附带字段的日志(只有被采样保留的少数日志)在调用线程中完成格式化；
+	// 使用崩溃环时同样在调用线程中完成格式化，崩溃环中保存可以直接阅读的文本
+	if (site->_fmt == fmt && site->Deferrable() && nfields == 0 && !_crash._ring) {
+		hdr._kind = kDeferredRecord;
+		site->EncodeArgs(ap, t_record);
+	} else {
+		hdr._kind = kTextRecord;
+		if (!FormatV(t_record, level, site, fields, nfields, fmt, ap)) {
+			return;
+		}
+	}
+	hdr._len = static_cast<uint32_t>(t_record.size());
+	memcpy(&t_record[0], &hdr, sizeof(hdr));
+	Push(level, t_record.data(), t_record.size());
+	if (t_record.capacity() > kMaxRetained) {
+		std::string().swap(t_record);
+	}
+}
+
+void zch::AsyncLogger::LogFieldsV(LogLevel::Level level, const CallSite* site, const char* msg, const Field* fields, size_t n) {
+	if (!_deferred) {
+		std::string& log_message = t_line;
+		log_message.clear();
+		FormatFields(log_message, level, site, msg, fields, n);
+		Push(level, log_message.data(), log_message.size());
+		return;
+	}
+
+	// 延迟格式化模式下放入已经格式化完毕的文本记录
+	RecordHeader hdr;
+	hdr._kind = kTextRecord;
+	hdr._level = level;
+	hdr._site = site;
+	hdr._ctime = 0;
+	hdr._nsec = 0;
+	hdr._tid = 0;
+	hdr._tname = nullptr;
+	t_record.assign(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+	FormatFields(t_record, level, site, msg, fields, n);
+	hdr._len = static_cast<uint32_t>(t_record.size());
+	memcpy(&t_record[0], &hdr, sizeof(hdr));
+	Push(level, t_record.data(), t_record.size());
+	if (t_record.capacity() > kMaxRetained) {
+		std::string().swap(t_record);
+	}
+}
+
+void zch::AsyncLogger::RealSink(Shard* shard, Buffer& buf) {
+	if (_deferred) {
+		RenderRecords(shard, buf);
+		if (shard->_rendered.empty()) {
+			return;
+		}
+	}
+	const char* data = _deferred ? shard->_rendered.data() : buf.Start();
+	size_t len = _deferred ? shard->_rendered.size() : buf.ReadableSize();
+	// 异步线程根据落地方向进行数据落地 (多个分片共享落地方向，需要加锁)
+	std::unique_lock<std::mutex> ulk(_mtx);
+	Deliver(data, len, shard->_outputs);
+}
+
+void zch::AsyncLogger::FlushSinks() {
+	std::unique_lock<std::mutex> ulk(_mtx);
 	for (auto& sink : _sinks) {
-		if (sink.get() != nullptr) {
-			sink->log(buf.Start(), buf.ReadableSize());
+		sink->Flush();
+	}
+}
+
+void zch::AsyncLogger::RenderRecords(Shard* shard, Buffer& buf) {
+	std::string& rendered = shard->_rendered;
+	rendered.clear();
+	RecordHeader hdr;
+	while (buf.ReadableSize() >= sizeof(hdr)) {
+		memcpy(&hdr, buf.Start(), sizeof(hdr));
+		if (hdr._len < sizeof(hdr) || hdr._len > buf.ReadableSize()) {
+			// 记录不完整，丢弃剩余数据
+			break;
+		}
+		const char* body = buf.Start() + sizeof(hdr);
+		size_t body_len = hdr._len - sizeof(hdr);
+		if (hdr._kind == kTextRecord) {
+			rendered.append(body, body_len);
+		} else {
+			// 根据调用点还原有效载荷，然后按照格式化器形成日志消息字符串
+			// (复用分片中字符串的容量)
+			LogMsg& msg = shard->_render_msg;
+			msg._ctime = hdr._ctime;
+			msg._nsec = hdr._nsec;
+			msg._site = hdr._site;
+			msg._logger = &_logger;
+			msg._tid = hdr._tid;
+			msg._tname = hdr._tname;
+			msg._payload.clear();
+			hdr._site->RenderArgs(body, body_len, msg._payload);
+			Render(rendered, hdr._level, msg);
 		}
+		buf.MoveReadIdx(hdr._len);
 	}
 }
 
-zch::Logger::ptr zch::LocalLoggerBuilder::Build() {
+void zch::AsyncLogger::ReportDropped(Shard* shard, uint64_t dropped) {
+	// 以一条普通日志的形式输出，经过格式化器后与其余日志的格式一致
+	static CallSite site(__FILE__, __LINE__, LogLevel::Level::WARN, "%llu log messages dropped");
+	LogMsg& msg = shard->_render_msg;
+	Clock::Now(_clock, msg._ctime, msg._nsec);
+	msg._site = &site;
+	msg._logger = &_logger;
+	msg._tid = ThreadInfo::Tid();
+	msg._tname = ThreadInfo::Name();
+	msg._payload.clear();
+	Number::AppendUInt(msg._payload, dropped);
+	msg._payload.append(" log messages dropped");
+
+	std::string& rendered = shard->_rendered;
+	rendered.clear();
+	Render(rendered, LogLevel::Level::WARN, msg);
+	std::unique_lock<std::mutex> ulk(_mtx);
+	Deliver(rendered.data(), rendered.size(), shard->_outputs);
+}
+
+void zch::AsyncLogger::OnCrash(int sig) {
+	if (_crash._ring) {
+		CrashText note;
+		note.Append("*** fatal signal ").AppendUInt(static_cast<uint64_t>(sig))
+			.Append(" in logger ").Append(_logger.data(), _logger.size()).Append(" ***\n");
+		_crash._ring->Append(note.Data(), note.Size());
+	}
+	if (!_crash._drain) {
+		return;
+	}
+	for (auto& shard : _shards) {
+		shard->_lopper->Salvage(&AsyncLogger::SalvageChunk, this);
+	}
+}
+
+void zch::AsyncLogger::SalvageChunk(void* self, const char* data, size_t len) {
+	static_cast<AsyncLogger*>(self)->Salvage(data, len, false);
+}
+
+void zch::AsyncLogger::Salvage(const char* data, size_t len, bool to_ring) {
+	if (!_deferred) {
+		SalvageText(data, len, to_ring);
+		return;
+	}
+	RecordHeader hdr;
+	while (len >= sizeof(hdr)) {
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr._len < sizeof(hdr) || hdr._len > len) {
+			break;
+		}
+		if (hdr._kind == kTextRecord) {
+			SalvageText(data + sizeof(hdr), hdr._len - sizeof(hdr), to_ring);
+		} else {
+			CrashText text;
+			text.Append("[").Append(LogLevel::ToCString(hdr._level)).Append("][")
+				.Append(hdr._site->_basename).Append(":").AppendUInt(hdr._site->_line).Append("]")
+				.Append(hdr._site->_fmt).Append(" (unformatted)\n");
+			EmergencyText(text.Data(), text.Size(), hdr._level, to_ring);
+		}
+		data += hdr._len;
+		len -= hdr._len;
+	}
+}
+
+void zch::AsyncLogger::SalvageText(const char* data, size_t len, bool to_ring) {
+	if (!_routed) {
+		EmergencyText(data, len, LogLevel::Level::FATAL, to_ring);
+		return;
+	}
+	// 分发记录：崩溃环只保存第一个格式化器的结果，落地方向按通道分别写入
+	RoutedHeader hdr;
+	while (len >= sizeof(hdr)) {
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr._len < sizeof(hdr) || hdr._len > len) {
+			break;
+		}
+		const char* seg = data + sizeof(hdr);
+		const char* end = data + hdr._len;
+		for (auto& route : _routes) {
+			uint32_t seg_len = 0;
+			if (static_cast<size_t>(end - seg) < sizeof(seg_len)) {
+				break;
+			}
+			memcpy(&seg_len, seg, sizeof(seg_len));
+			seg += sizeof(seg_len);
+			if (seg_len > static_cast<size_t>(end - seg)) {
+				break;
+			}
+			if (to_ring) {
+				if (seg_len > 0) {
+					_crash._ring->Append(seg, seg_len);
+					break;
+				}
+			} else {
+				for (size_t idx : route._channels) {
+					if (hdr._level >= _channels[idx]._level) {
+						for (auto& sink : _channels[idx]._sinks) {
+							sink->EmergencyWrite(seg, seg_len);
+						}
+					}
+				}
+			}
+			seg += seg_len;
+		}
+		data += hdr._len;
+		len -= hdr._len;
+	}
+}
+
+void zch::AsyncLogger::EmergencyText(const char* data, size_t len, LogLevel::Level level, bool to_ring) {
+	if (to_ring) {
+		_crash._ring->Append(data, len);
+		return;
+	}
+	if (!_routed) {
+		for (auto& sink : _sinks) {
+			if (sink.get() != nullptr) {
+				sink->EmergencyWrite(data, len);
+			}
+		}
+		return;
+	}
+	for (auto& channel : _channels) {
+		if (level >= channel._level) {
+			for (auto& sink : channel._sinks) {
+				sink->EmergencyWrite(data, len);
+			}
+		}
+	}
+}
+
+zch::Logger::ptr zch::LoggerBuilder::Create() {
 	// 不能没有日志器名称
 	assert(!_logger_name.empty());
 
@@ -161,35 +690,91 @@ zch::Logger::ptr zch::LocalLoggerBuilder::Build() {
 	}
 
 	// 如果用户没有手动设置过落地方向数组，就进行默认设置一个的落地到标准输出的格式化器
-	if (_sinks.empty()) {
+	if (_sinks.empty() && _configs.empty()) {
 		_sinks.push_back(SinkFactory::create<StdOutSink>());
 	}
 
 	// 根据日志器的类型构造相应类型的日志器
 	if (_logger_type == LoggerType::Async_Logger) {
-		return std::make_shared<zch::AsyncLogger>(_logger_name, _limit, _formatter, _sinks, _async_type);
+		return std::make_shared<zch::AsyncLogger>(_logger_name, _limit, _formatter, _sinks, _async_type, _deferred, _clock, _shards, _overflow, _configs, _dedup_window, _sampler
+				, CrashOptions(_crash_safe, _crash_safe && !_crash_ring_path.empty()
+										? std::make_shared<CrashRing>(_crash_ring_path, _crash_ring_size) : nullptr));
 	}
-	return std::make_shared<zch::SyncLogger>(_logger_name, _limit, _formatter, _sinks);
+	return std::make_shared<zch::SyncLogger>(_logger_name, _limit, _formatter, _sinks, _clock, _configs, _dedup_window, _sampler);
+}
+
+zch::Logger::ptr zch::LocalLoggerBuilder::Build() {
+	return Create();
 }
 
 zch::Logger::ptr zch::GlobalLoggerBuilder::Build() {
-	assert(!_logger_name.empty());
-	if (_formatter.get() == nullptr) {
-		_formatter = std::make_shared<zch::Formatter>();
-	}
+	Logger::ptr logger = Create();
+	LogManager::GetInstance().AddLogger(logger);
+	return logger;
+}
 
-	if (_sinks.empty()) {
-		_sinks.push_back(zch::SinkFactory::create<zch::StdOutSink>());
+zch::LogManager::LogManager() : _table(nullptr) {
+	_tables.emplace_back(new Table(16));
+	_table.store(_tables.back().get(), std::memory_order_release);
+	std::unique_ptr<LoggerBuilder> builder(new LocalLoggerBuilder());
+	builder->BuildName("default");
+	_default_logger = builder->Build();
+	AddLogger(_default_logger);
+}
+
+zch::LogManager::~LogManager() {
+	_table.store(nullptr, std::memory_order_release);
+}
+
+void zch::LogManager::AddLogger(const Logger::ptr& logger) {
+	std::unique_lock<std::mutex> ulk(_mtx_loggers);
+	if (Find(logger->GetLoggerName()) != nullptr) {
+		return;
 	}
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->_name = logger->GetLoggerName();
+	entry->_hash = std::hash<std::string>()(entry->_name);
+	entry->_logger = logger;
 
-	Logger::ptr logger;
-	if (_logger_type == LoggerType::Async_Logger) {
-		logger = std::make_shared<AsyncLogger>(_logger_name, _limit, _formatter, _sinks, _async_type);
-	} else {
-		logger = std::make_shared<SyncLogger>(_logger_name, _limit, _formatter, _sinks);
+	Table* table = _table.load(std::memory_order_relaxed);
+	if ((table->_size + 1) * 2 > table->_mask + 1) {
+		// 装载率超过一半时建立新表，所有条目放入新表后再发布，读者看到的总是完整的表
+		std::unique_ptr<Table> bigger(new Table((table->_mask + 1) * 2));
+		for (auto& old : _entries) {
+			Insert(bigger.get(), old.get());
+		}
+		table = bigger.get();
+		_tables.push_back(std::move(bigger));
+		_table.store(table, std::memory_order_release);
 	}
+	Insert(table, entry.get());
+	_entries.push_back(std::move(entry));
+}
 
-	LogManager::GetInstance().AddLogger(logger);
+const zch::LogManager::Entry* zch::LogManager::Find(const std::string& logger_name) const {
+	const Table* table = _table.load(std::memory_order_acquire);
+	if (table == nullptr) {
+		return nullptr;
+	}
+	size_t hash = std::hash<std::string>()(logger_name);
+	// 装载率不超过一半，探测总会遇到空槽位
+	for (size_t idx = hash & table->_mask; ; idx = (idx + 1) & table->_mask) {
+		const Entry* entry = table->_slots[idx].load(std::memory_order_acquire);
+		if (entry == nullptr) {
+			return nullptr;
+		}
+		if (entry->_hash == hash && entry->_name == logger_name) {
+			return entry;
+		}
+	}
+}
 
-	return logger;
+void zch::LogManager::Insert(Table* table, const Entry* entry) {
+	size_t idx = entry->_hash & table->_mask;
+	while (table->_slots[idx].load(std::memory_order_relaxed) != nullptr) {
+		idx = (idx + 1) & table->_mask;
+	}
+	// 条目构造完毕后才发布到槽位中
+	table->_slots[idx].store(entry, std::memory_order_release);
+	++table->_size;
 }
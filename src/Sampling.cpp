@@ -0,0 +1,98 @@
+#include <chrono>
+
+#include "../include/Sampling.h"
+#include "../include/ThreadInfo.h"
+
+namespace {
+
+	// 随机数发生器的状态，只包含平凡类型，0 表示尚未播种
+	thread_local uint64_t t_state = 0;
+
+	uint64_t SplitMix64(uint64_t x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	// xorshift64*：周期 2^64 - 1，高位的统计质量足以用于采样
+	uint64_t NextRandom() {
+		uint64_t x = t_state;
+		if (x == 0) {
+			// 按线程 id 与当前时间播种，不同线程得到不相关的序列
+			uint64_t seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			x = SplitMix64(seed ^ (static_cast<uint64_t>(zch::ThreadInfo::Tid()) << 32));
+			if (x == 0) {
+				x = 0x9e3779b97f4a7c15ull;
+			}
+		}
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+		t_state = x;
+		return x * 0x2545f4914f6cdd1dull;
+	}
+}
+
+zch::Sampler::Sampler(uint64_t n, double p, LogLevel::Level up_to, size_t slots)
+					: _every_n(n)
+					, _probability(p)
+					, _rate(n > 0 ? static_cast<double>(n) : 1.0 / p)
+					, _up_to(up_to)
+					, _mask(0) {
+	if (n == 0) {
+		return;
+	}
+	size_t capacity = 1;
+	while (capacity < slots) {
+		capacity <<= 1;
+	}
+	_mask = capacity - 1;
+	_slots.reset(new Slot[capacity]);
+	for (size_t i = 0; i < capacity; ++i) {
+		_slots[i]._site.store(nullptr, std::memory_order_relaxed);
+		_slots[i]._count.store(0, std::memory_order_relaxed);
+	}
+}
+
+zch::Sampler::ptr zch::Sampler::EveryN(uint64_t n, LogLevel::Level up_to, size_t slots) {
+	return ptr(new Sampler(n > 0 ? n : 1, 0.0, up_to, slots));
+}
+
+zch::Sampler::ptr zch::Sampler::Probability(double p, LogLevel::Level up_to) {
+	// 概率不在 (0, 1] 内时视为 1，即不进行采样
+	return ptr(new Sampler(0, p > 0.0 && p <= 1.0 ? p : 1.0, up_to, 0));
+}
+
+bool zch::Sampler::Keep(LogLevel::Level level, const CallSite* site, double& rate) {
+	rate = 0;
+	if (level > _up_to) {
+		return true;
+	}
+	rate = _rate;
+	if (_every_n == 0) {
+		return Bernoulli(_probability);
+	}
+
+	Slot& slot = _slots[site->_id & _mask];
+	const CallSite* owner = slot._site.load(std::memory_order_relaxed);
+	if (owner == nullptr && slot._site.compare_exchange_strong(owner, site, std::memory_order_relaxed)) {
+		owner = site;
+	}
+	if (owner != site) {
+		// 多个调用点共享计数器时，交替出现的调用点可能总是落在被丢弃的位置上，因此改为按概率采样
+		return Bernoulli(1.0 / static_cast<double>(_every_n));
+	}
+	return slot._count.fetch_add(1, std::memory_order_relaxed) % _every_n == 0;
+}
+
+bool zch::Sampler::Bernoulli(double p) {
+	if (p >= 1.0) {
+		return true;
+	}
+	if (p <= 0.0) {
+		return false;
+	}
+	// 取高 53 位转换为 [0, 1) 内的均匀分布
+	return static_cast<double>(NextRandom() >> 11) * (1.0 / 9007199254740992.0) < p;
+}
@@ -0,0 +1,45 @@
+#include <mutex>
+#include <unordered_set>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/ThreadInfo.h"
+
+void zch::ThreadInfo::Load(Cache& cache) {
+	// 每个进程只需注册一次 fork 处理函数
+	static int registered = pthread_atfork(nullptr, nullptr, &ThreadInfo::ResetAfterFork);
+	(void)registered;
+
+	cache._tid = static_cast<uint32_t>(syscall(SYS_gettid));
+	std::string text;
+	Number::AppendUInt(text, cache._tid);
+	cache._len = static_cast<uint32_t>(text.size());
+	text.copy(cache._text, text.size());
+}
+
+void zch::ThreadInfo::LoadName(Cache& cache) {
+	char buf[16] = { 0 };
+	if (pthread_getname_np(pthread_self(), buf, sizeof(buf)) != 0) {
+		buf[0] = '\0';
+	}
+	cache._name = Intern(buf);
+}
+
+void zch::ThreadInfo::ResetAfterFork() {
+	Local()._tid = 0;
+}
+
+void zch::ThreadInfo::SetName(const std::string& name) {
+	Local()._name = Intern(name);
+	pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+}
+
+const char* zch::ThreadInfo::Intern(const std::string& name) {
+	// 日志消息中只保存名称的指针，线程退出后异步线程仍可能使用它，所以名称永不释放
+	static std::mutex mtx;
+	static std::unordered_set<std::string>* names = new std::unordered_set<std::string>();
+	std::unique_lock<std::mutex> ulk(mtx);
+	return names->insert(name).first->c_str();
+}
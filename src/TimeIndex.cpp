@@ -0,0 +1,94 @@
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/TimeIndex.h"
+
+zch::TimeIndex::TimeIndex(const std::string& log_path, size_t interval, uint64_t offset)
+						: _fd(-1)
+						, _interval(interval > 0 ? interval : 1)
+						, _offset(offset)
+						, _next(offset) {
+	_fd = open(IndexPath(log_path).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		perror("TimeIndex open fail: ");
+		_next = UINT64_MAX;
+		return;
+	}
+	// 第一个条目记录文件的起始位置，同时为只记录了时分秒的日志提供日期
+	Mark();
+}
+
+zch::TimeIndex::~TimeIndex() {
+	if (_fd < 0) {
+		return;
+	}
+	Mark();
+	close(_fd);
+}
+
+std::string zch::TimeIndex::IndexPath(const std::string& log_path) {
+	std::string path = log_path;
+	if (path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0) {
+		path.resize(path.size() - 3);
+	}
+	return path + ".idx";
+}
+
+std::vector<zch::TimeIndex::Entry> zch::TimeIndex::Load(const std::string& log_path) {
+	std::vector<Entry> entries;
+	int fd = open(IndexPath(log_path).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return entries;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		// 进程崩溃时最后一个条目可能不完整，忽略即可
+		entries.resize(st.st_size / sizeof(Entry));
+		size_t want = entries.size() * sizeof(Entry);
+		size_t got = 0;
+		while (got < want) {
+			ssize_t n = read(fd, reinterpret_cast<char*>(entries.data()) + got, want - got);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				break;
+			}
+			got += n;
+		}
+		entries.resize(got / sizeof(Entry));
+	}
+	close(fd);
+	return entries;
+}
+
+uint64_t zch::TimeIndex::Seek(const std::vector<Entry>& entries, int64_t ns) {
+	// 条目按写入顺序记录，写入时间与偏移量都是递增的，找到最后一个写入时间早于 ns 的条目
+	size_t lo = 0, hi = entries.size();
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (entries[mid]._ns < ns) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo == 0 ? 0 : entries[lo - 1]._offset;
+}
+
+void zch::TimeIndex::Mark() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	Entry entry;
+	entry._ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	entry._offset = _offset;
+	// 单个条目的写入不会被拆分，失败时放弃这个条目(索引是稀疏的，缺少条目只影响定位的精度)
+	if (write(_fd, &entry, sizeof(entry)) != static_cast<ssize_t>(sizeof(entry))) {
+		return;
+	}
+	_next = _offset + _interval;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file zchlog_crash.cpp
+ * @brief 按写入顺序输出崩溃环文件中保存的日志 (最早的日志在前，崩溃标记在末尾)
+ *        用法：zchlog-crash 文件...
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <cstdio>
+#include <string>
+
+#include "../include/Crash.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s file...\n", argv[0]);
+		return 2;
+	}
+	int ret = 0;
+	std::string out;
+	for (int i = 1; i < argc; ++i) {
+		out.clear();
+		if (!zch::CrashRing::Read(argv[i], out)) {
+			fprintf(stderr, "%s: not a crash ring file\n", argv[i]);
+			ret = 1;
+			continue;
+		}
+		fwrite(out.data(), 1, out.size(), stdout);
+	}
+	return ret;
+}
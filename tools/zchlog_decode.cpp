@@ -0,0 +1,68 @@
+/**
+ * @file zchlog_decode.cpp
+ * @brief 将 BinaryFileSink 写入的二进制日志文件按照格式化规则还原为文本，输出到标准输出
+ *        用法：zchlog-decode [-p 格式化规则] 文件...
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../include/BinaryLog.h"
+
+namespace {
+
+	const char* kDefaultPattern = "[%d{%Y-%m-%d %H:%M:%S.%N}][%c][%t:%i][%p][%f:%l]%m%n";
+
+	void Usage(const char* prog) {
+		fprintf(stderr, "usage: %s [-p pattern] file...\n", prog);
+		fprintf(stderr, "  -p pattern  Formatter pattern, default \"%s\"\n", kDefaultPattern);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	std::string pattern = kDefaultPattern;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			pattern = argv[++i];
+		} else {
+			Usage(argv[0]);
+			return 2;
+		}
+	}
+	if (i == argc) {
+		Usage(argv[0]);
+		return 2;
+	}
+
+	zch::Formatter formatter(pattern);
+	zch::LogMsg msg;
+	std::string out;
+	int ret = 0;
+	for (; i < argc; ++i) {
+		zch::BinaryReader reader(argv[i]);
+		if (!reader.IsOpen()) {
+			fprintf(stderr, "%s: not a binary log file\n", argv[i]);
+			ret = 1;
+			continue;
+		}
+		while (reader.Next(msg)) {
+			formatter.Format(out, msg);
+			// 积累一定数据后再输出，减少写系统调用
+			if (out.size() >= 64 * 1024) {
+				fwrite(out.data(), 1, out.size(), stdout);
+				out.clear();
+			}
+		}
+		fwrite(out.data(), 1, out.size(), stdout);
+		out.clear();
+		if (reader.Corrupted()) {
+			fprintf(stderr, "%s: skipped a corrupted or incomplete segment tail\n", argv[i]);
+			ret = 1;
+		}
+	}
+	return ret;
+}
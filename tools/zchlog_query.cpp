@@ -0,0 +1,262 @@
+/**
+ * @file zchlog_query.cpp
+ * @brief 按时间范围查询文本日志文件：利用滚动文件旁边的 .idx 时间索引直接定位到起始时间附近，
+ *        只输出时间戳位于范围内的行；指定 -m 时将多个文件按时间顺序归并输出。支持 .gz 文件
+ *        用法：zchlog-query -f 起始时间 -t 结束时间 [-p 行首时间格式] [-s 秒] [-m] 文件...
+ * @author zch
+ * @date 2026-10-16
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "../include/TimeIndex.h"
+
+namespace {
+
+	// 查询参数
+	struct Options {
+		time_t _from = 0;
+		time_t _to = 0;
+		// 行首时间戳的 strptime 格式 (与默认的格式化规则 [%d{%H:%M:%S}] 对应)
+		std::string _pattern = "[%H:%M:%S";
+		// 行首时间戳中是否含有日期，不含日期时使用索引中的写入时间补全
+		bool _has_date = false;
+		// 异步日志器中日志的写入顺序与时间戳顺序可能略有差异，时间戳超过结束时间这么多秒之后才停止读取
+		time_t _slack = 5;
+		bool _merge = false;
+	};
+
+	bool ParseTime(const char* str, time_t& t) {
+		struct tm tm;
+		memset(&tm, 0, sizeof(tm));
+		const char* end = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+		if (end == nullptr || *end != '\0') {
+			return false;
+		}
+		tm.tm_isdst = -1;
+		t = mktime(&tm);
+		return true;
+	}
+
+	// 格式中是否含有日期相关的转换说明符
+	bool HasDate(const std::string& pattern) {
+		for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+			if (pattern[i] == '%') {
+				if (strchr("YymdFDejbBhcs", pattern[i + 1]) != nullptr) {
+					return true;
+				}
+				++i;
+			}
+		}
+		return false;
+	}
+
+	// 一个日志文件：从索引定位的位置开始按行读取，只返回时间范围内的行
+	class Source {
+	public:
+		Source(const std::string& path, const Options& opts) : _path(path), _opts(opts), _file(nullptr)
+			, _entry(0), _offset(0), _end(UINT64_MAX), _have_time(false), _time(0), _done(false) {
+			_file = gzopen(path.c_str(), "rb");
+			if (_file == nullptr) {
+				fprintf(stderr, "%s: open failed\n", path.c_str());
+				_done = true;
+				return;
+			}
+			gzbuffer(_file, 256 * 1024);
+			_entries = zch::TimeIndex::Load(path);
+			// 没有索引时以文件的修改时间为行首时间戳补全日期
+			struct stat st;
+			_mtime = stat(path.c_str(), &st) == 0 ? st.st_mtime : time(nullptr);
+			_offset = zch::TimeIndex::Seek(_entries, static_cast<int64_t>(opts._from) * 1000000000);
+			// 写入时间晚于 结束时间 + slack 的条目之后的数据不可能在时间范围内
+			_end = UINT64_MAX;
+			for (auto& entry : _entries) {
+				if (entry._ns > static_cast<int64_t>(opts._to + opts._slack + 1) * 1000000000) {
+					_end = entry._offset;
+					break;
+				}
+			}
+			if (_offset > 0 && gzseek(_file, static_cast<z_off_t>(_offset), SEEK_SET) < 0) {
+				_offset = 0;
+				gzrewind(_file);
+			}
+		}
+
+		~Source() {
+			if (_file != nullptr) {
+				gzclose(_file);
+			}
+		}
+
+		// 取得下一条时间范围内的行(包括行尾的换行符)，没有时返回 false
+		bool Next(std::string& line, time_t& t) {
+			while (!_done && _offset < _end && ReadLine(line)) {
+				ParseLine(line);
+				if (!_have_time || _time < _opts._from) {
+					continue;
+				}
+				if (_time > _opts._to) {
+					if (_time > _opts._to + _opts._slack) {
+						_done = true;
+					}
+					continue;
+				}
+				t = _time;
+				return true;
+			}
+			_done = true;
+			return false;
+		}
+
+		const std::string& Path() const { return _path; }
+
+	private:
+		bool ReadLine(std::string& line) {
+			line.clear();
+			char buf[64 * 1024];
+			while (gzgets(_file, buf, sizeof(buf)) != nullptr) {
+				line.append(buf);
+				if (!line.empty() && line.back() == '\n') {
+					break;
+				}
+			}
+			_offset += line.size();
+			return !line.empty();
+		}
+
+		// 补全日期时使用的参考时间：最后一个偏移量不超过当前位置的索引条目的写入时间
+		time_t Reference() {
+			if (_entries.empty()) {
+				return _mtime;
+			}
+			while (_entry + 1 < _entries.size() && _entries[_entry + 1]._offset <= _offset) {
+				++_entry;
+			}
+			return static_cast<time_t>(_entries[_entry]._ns / 1000000000);
+		}
+
+		// 解析行首的时间戳，解析失败的行(如多行日志的后续行)沿用上一行的时间
+		void ParseLine(const std::string& line) {
+			time_t ref = Reference();
+			struct tm tm;
+			localtime_r(&ref, &tm);
+			if (strptime(line.c_str(), _opts._pattern.c_str(), &tm) == nullptr) {
+				return;
+			}
+			tm.tm_isdst = -1;
+			time_t t = mktime(&tm);
+			// 只有时分秒时，日期取自参考时间，跨过零点的行需要调整一天
+			if (!_opts._has_date) {
+				if (t - ref > 12 * 3600) {
+					t -= 24 * 3600;
+				} else if (ref - t > 12 * 3600) {
+					t += 24 * 3600;
+				}
+			}
+			_time = t;
+			_have_time = true;
+		}
+
+	private:
+		std::string _path;
+		const Options& _opts;
+		gzFile _file;
+		std::vector<zch::TimeIndex::Entry> _entries;
+		size_t _entry;
+		time_t _mtime;
+		// 下一行在文件中(解压后)的偏移量，以及根据索引确定的读取终点
+		uint64_t _offset;
+		uint64_t _end;
+		bool _have_time;
+		time_t _time;
+		bool _done;
+	};
+
+	// 归并时每个文件的当前行
+	struct Head {
+		time_t _time;
+		size_t _src;
+		std::string _line;
+		bool operator>(const Head& other) const {
+			return _time != other._time ? _time > other._time : _src > other._src;
+		}
+	};
+
+	void Usage(const char* prog) {
+		fprintf(stderr, "usage: %s -f \"YYYY-MM-DD HH:MM:SS\" -t \"YYYY-MM-DD HH:MM:SS\" [-p pattern] [-s seconds] [-m] file...\n", prog);
+		fprintf(stderr, "  -p pattern  strptime format of the timestamp at the start of each line, default \"[%%H:%%M:%%S\"\n");
+		fprintf(stderr, "  -s seconds  keep reading this long past the end time (async delay, coarse clocks), default 5\n");
+		fprintf(stderr, "  -m          merge all files into one chronological stream\n");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	Options opts;
+	bool from = false, to = false;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		std::string arg = argv[i];
+		if (arg == "-m") {
+			opts._merge = true;
+		} else if (i + 1 < argc && arg == "-f") {
+			from = ParseTime(argv[++i], opts._from);
+		} else if (i + 1 < argc && arg == "-t") {
+			to = ParseTime(argv[++i], opts._to);
+		} else if (i + 1 < argc && arg == "-p") {
+			opts._pattern = argv[++i];
+		} else if (i + 1 < argc && arg == "-s") {
+			opts._slack = atol(argv[++i]);
+		} else {
+			Usage(argv[0]);
+			return 2;
+		}
+	}
+	if (!from || !to || i == argc) {
+		Usage(argv[0]);
+		return 2;
+	}
+	opts._has_date = HasDate(opts._pattern);
+
+	std::vector<std::unique_ptr<Source>> sources;
+	for (; i < argc; ++i) {
+		sources.emplace_back(new Source(argv[i], opts));
+	}
+
+	std::string line;
+	time_t t = 0;
+	if (!opts._merge) {
+		for (auto& src : sources) {
+			while (src->Next(line, t)) {
+				fwrite(line.data(), 1, line.size(), stdout);
+			}
+		}
+		return 0;
+	}
+
+	// 多路归并：每个文件取出一行放入小根堆，输出最早的一行后再从同一个文件补充一行
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+	for (size_t k = 0; k < sources.size(); ++k) {
+		Head head;
+		head._src = k;
+		if (sources[k]->Next(head._line, head._time)) {
+			heads.push(std::move(head));
+		}
+	}
+	while (!heads.empty()) {
+		Head head = std::move(const_cast<Head&>(heads.top()));
+		heads.pop();
+		fwrite(head._line.data(), 1, head._line.size(), stdout);
+		if (sources[head._src]->Next(head._line, head._time)) {
+			heads.push(std::move(head));
+		}
+	}
+	return 0;
+}